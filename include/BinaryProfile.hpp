@@ -0,0 +1,224 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <iosfwd>
+
+#include "Timeline.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 二进制剖析文件格式
+     *
+     * 文件由定长的头部及若干按8字节对齐的段组成，所有整数均为小端序：
+     *   - 字符串偏移表 uint64[StringCount + 1] 与字符串数据（每个字符串以'\0'结尾）
+     *   - 栈帧表 Frame[FrameCount]
+     *   - 堆栈表 uint32 父节点[StackCount]、uint32 栈帧[StackCount]（父节点的下标总是小于子节点）
+     *   - 采样次数 uint64[StackCount]
+     *   - 内存映射 Mapping[MappingCount]
+     *   - 标签 uint32[LabelCount * 2]（键、值的字符串ID，版本2起）
+     *   - 时间线线程表 uint64[ThreadCount] 与时间线数据（见 Timeline）
+     *
+     * 字符串、栈帧与堆栈均为驻留后的字典，每个堆栈只占用8字节的表项，相比折叠文本通常小一到两个数量级。
+     * 读取时直接映射文件，各表可原地访问而无需解析。
+     * 由于各表按主机字节序原样写出并原地访问，只支持在小端序的平台上编译，从而保证文件总是小端序。
+     */
+    namespace BinaryProfileFormat
+    {
+        static const char MAGIC[4] = { 'L', 'P', 'R', 'F' };
+        static const uint32_t VERSION = 2;
+
+        static const uint32_t FLAG_LINE_MODE = 1;
+
+        struct Header
+        {
+            char Magic[4];
+            uint32_t Version;
+            uint32_t Flags;
+            uint32_t LabelCount;  // 版本1中为保留字段，总是0
+            uint64_t Period;
+            uint64_t StartTime;
+            uint64_t Duration;
+            uint64_t TotalSampleCount;
+            uint64_t StringCount;
+            uint64_t StringDataSize;
+            uint64_t FrameCount;
+            uint64_t StackCount;
+            uint64_t MappingCount;
+            uint64_t ThreadCount;
+            uint64_t TimelineSize;
+        };
+
+        struct Frame
+        {
+            uint32_t Type;
+            uint32_t Name;
+            uint32_t Source;
+            uint32_t LineDefined;
+            uint32_t Line;
+            uint32_t Reserved;
+            uint64_t Address;
+        };
+
+        struct Mapping
+        {
+            uint64_t Start;
+            uint64_t Limit;
+            uint64_t Offset;
+            uint32_t File;
+            uint32_t Reserved;
+        };
+
+        static_assert(sizeof(Header) == 104, "Unexpected header size");
+        static_assert(sizeof(Frame) == 32, "Unexpected frame size");
+        static_assert(sizeof(Mapping) == 32, "Unexpected mapping size");
+
+        /**
+         * @brief 各段在文件中的偏移
+         */
+        struct Layout
+        {
+            uint64_t StringOffsets;
+            uint64_t StringData;
+            uint64_t Frames;
+            uint64_t StackParents;
+            uint64_t StackFrames;
+            uint64_t SampleCounts;
+            uint64_t Mappings;
+            uint64_t Labels;
+            uint64_t Threads;
+            uint64_t Timeline;
+            uint64_t End;
+        };
+
+        /**
+         * @brief 根据头部计算各段偏移
+         */
+        Layout ComputeLayout(const Header& header)noexcept;
+    }
+
+    /**
+     * @brief 以二进制格式输出剖析数据
+     * @param profile 剖析数据
+     * @param timeline 时间线，可为nullptr
+     * @param out 输出流
+     */
+    void WriteBinaryProfile(const Profile& profile, const Timeline* timeline, std::ostream& out);
+
+    /**
+     * @brief 判断文件是否为二进制剖析文件
+     * @param path 路径
+     */
+    bool IsBinaryProfile(const std::string& path);
+
+    /**
+     * @brief 映射到内存的二进制剖析文件
+     */
+    class BinaryProfile
+    {
+    public:
+        /**
+         * @brief 打开并映射文件
+         * @param path 路径
+         *
+         * 打开时校验头部、各段的边界、栈帧类型以及各ID（包括时间线中的线程序号与堆栈ID）的引用范围，
+         * 失败时抛出异常。
+         * GZIP压缩的文件解压到内存中读取。
+         */
+        BinaryProfile(const std::string& path);
+        ~BinaryProfile();
+
+        BinaryProfile(const BinaryProfile&) = delete;
+        BinaryProfile& operator=(const BinaryProfile&) = delete;
+
+    public:
+        const BinaryProfileFormat::Header& GetHeader()const noexcept { return *m_pHeader; }
+
+        bool IsLineMode()const noexcept { return (m_pHeader->Flags & BinaryProfileFormat::FLAG_LINE_MODE) != 0; }
+
+        size_t GetStringCount()const noexcept { return m_pHeader->StringCount; }
+        size_t GetFrameCount()const noexcept { return m_pHeader->FrameCount; }
+        size_t GetStackCount()const noexcept { return m_pHeader->StackCount; }
+        size_t GetMappingCount()const noexcept { return m_pHeader->MappingCount; }
+        size_t GetLabelCount()const noexcept { return m_pHeader->LabelCount; }
+
+        /**
+         * @brief 获取字符串（以'\0'结尾）
+         */
+        const char* GetString(ProfileId id)const noexcept { return m_pStringData + m_pStringOffsets[id]; }
+
+        /**
+         * @brief 获取字符串长度
+         */
+        size_t GetStringLength(ProfileId id)const noexcept
+        {
+            return m_pStringOffsets[id + 1] - m_pStringOffsets[id] - 1;
+        }
+
+        const BinaryProfileFormat::Frame& GetFrame(ProfileId id)const noexcept { return m_pFrames[id]; }
+        const BinaryProfileFormat::Mapping& GetMapping(size_t index)const noexcept { return m_pMappings[index]; }
+
+        /**
+         * @brief 获取标签的键、值字符串ID
+         */
+        ProfileId GetLabelKey(size_t index)const noexcept { return m_pLabels[index * 2]; }
+        ProfileId GetLabelValue(size_t index)const noexcept { return m_pLabels[index * 2 + 1]; }
+
+        /**
+         * @brief 获取堆栈表
+         */
+        const uint32_t* GetStackParents()const noexcept { return m_pStackParents; }
+        const uint32_t* GetStackFrames()const noexcept { return m_pStackFrames; }
+        const uint64_t* GetSampleCounts()const noexcept { return m_pSampleCounts; }
+
+        /**
+         * @brief 获取时间线
+         */
+        const uint64_t* GetThreads()const noexcept { return m_pThreads; }
+        Timeline::Reader GetTimelineReader()const noexcept
+        {
+            return Timeline::Reader(m_pTimeline, m_pHeader->TimelineSize);
+        }
+
+        /**
+         * @brief 加载为 Profile
+         * @param[out] profile 剖析数据（应为空）
+         * @param[out] timeline 若非nullptr，则同时加载时间线
+         */
+        void Load(Profile& profile, Timeline* timeline=nullptr)const;
+
+        /**
+         * @brief 将堆栈与采样次数合并到 Profile
+         * @param[out] profile 剖析数据
+         * @param root 若非 INVALID_PROFILE_ID，则合并的堆栈挂在该节点之下
+         * @return 本文件堆栈ID到 profile 中堆栈ID的映射
+         *
+         * 直接读取映射的表，只驻留被引用的字符串，不产生中间的 Profile。
+         */
+        std::vector<ProfileId> Merge(Profile& profile, ProfileId root=INVALID_PROFILE_ID)const;
+
+    private:
+        void Parse(const std::string& path);
+
+    private:
+        int m_iFd = -1;
+        std::string m_stBuffer;  // 压缩文件解压后的数据
+        const uint8_t* m_pData = nullptr;
+        size_t m_uSize = 0;
+
+        const BinaryProfileFormat::Header* m_pHeader = nullptr;
+        const uint64_t* m_pStringOffsets = nullptr;
+        const char* m_pStringData = nullptr;
+        const BinaryProfileFormat::Frame* m_pFrames = nullptr;
+        const uint32_t* m_pStackParents = nullptr;
+        const uint32_t* m_pStackFrames = nullptr;
+        const uint64_t* m_pSampleCounts = nullptr;
+        const BinaryProfileFormat::Mapping* m_pMappings = nullptr;
+        const uint32_t* m_pLabels = nullptr;
+        const uint64_t* m_pThreads = nullptr;
+        const uint8_t* m_pTimeline = nullptr;
+    };
+}
@@ -0,0 +1,23 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <iosfwd>
+
+#include "Profile.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 以 callgrind 格式输出剖析数据
+     * @param profile 剖析数据，行模式下可得到逐行的开销
+     * @param out 输出流
+     *
+     * 对堆栈树做一次遍历，按函数汇总逐行的自身开销以及调用方到被调用方的边（调用行、观察到的调用路径数、总开销），
+     * 可使用 KCachegrind/QCachegrind 浏览。
+     * @see http://valgrind.org/docs/manual/cl-format.html
+     */
+    void WriteCallgrind(const Profile& profile, std::ostream& out);
+}
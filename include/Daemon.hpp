@@ -0,0 +1,95 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <chrono>
+#include <memory>
+#include <functional>
+
+#include "Profile.hpp"
+
+namespace lperf
+{
+    class Debugger;
+    class LuaSampler;
+
+    /**
+     * @brief 常驻服务的选项
+     */
+    struct DaemonOptions
+    {
+        std::string SocketPath;  // 控制用的 Unix 域套接字路径
+        uint16_t HttpPort = 0;  // 本地HTTP端口（只监听127.0.0.1），0表示不启用
+        uint32_t DefaultInterval = 10;  // 默认采样间隔（毫秒）
+    };
+
+    /**
+     * @brief 常驻的剖析服务（lperfd）
+     *
+     * 附加到目标后一直保持附加状态，调试符号、函数名缓存和 Proto 缓存在多次采样之间保持有效，
+     * 因此按需发起的采样无需再付出附加和解析 DWARF 的开销。
+     *
+     * 所有 ptrace 调用都必须来自附加的线程，因此服务为单线程，套接字 I/O 与定时采样在同一个 poll 循环中完成。
+     * 未在采样的目标同样保持附加，循环中定期为其投递收到的信号并回收已退出的进程。
+     *
+     * 控制协议为按行的文本命令，应答以 "OK" 或 "ERR" 开头：
+     *   - attach PID [间隔毫秒] [自定义入口]：附加到进程
+     *   - detach PID：解除附加
+     *   - start PID / stop PID：开始（清空之前的结果）/ 停止采样
+     *   - rate PID 间隔毫秒：设置采样间隔
+     *   - fetch PID [pprof|folded|binary]：获取结果，应答为 "OK 字节数" 后跟数据
+     *   - list：列出目标
+     *
+     * HTTP 接口：
+     *   - GET /debug/pprof/profile?pid=PID&seconds=N：采样N秒（默认30）后返回 pprof
+     *   - GET /debug/pprof/snapshot?pid=PID&format=F：返回当前已累计的结果
+     */
+    class Daemon
+    {
+        struct Target;
+        struct Connection;
+
+    public:
+        Daemon(const DaemonOptions& options);
+        ~Daemon();
+
+        Daemon(const Daemon&) = delete;
+        Daemon& operator=(const Daemon&) = delete;
+
+    public:
+        /**
+         * @brief 运行服务直到请求停止
+         * @param stopRequested 返回true时退出
+         */
+        void Run(const std::function<bool()>& stopRequested);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void Accept(int listener, bool http);
+        void Receive(Connection& conn);
+        void Send(Connection& conn);
+        void PollTargets();
+        void Sample(Clock::time_point now);
+        void CompleteWindows(Clock::time_point now);
+
+        std::string HandleCommand(const std::string& line);
+        void HandleHttpRequest(Connection& conn, const std::string& request);
+        void WriteHttpResponse(Connection& conn, int status, const std::string& contentType, const std::string& body);
+
+        Target& FindTarget(uint64_t pid);
+        void InitProfile(const Target& target, Profile& profile)const;
+        std::string RenderProfile(Profile& profile, const std::string& format)const;
+        int GetPollTimeout(Clock::time_point now)const;
+
+    private:
+        DaemonOptions m_stOptions;
+        int m_iUnixListener = -1;
+        int m_iHttpListener = -1;
+
+        std::vector<std::unique_ptr<Target>> m_stTargets;
+        std::vector<std::unique_ptr<Connection>> m_stConnections;
+    };
+}
@@ -5,6 +5,10 @@
  */
 #pragma once
 #include <climits>
+#include <sys/uio.h>
+#include <mutex>
+#include <memory>
+#include <vector>
 #include <unordered_map>
 
 #include <elf++.hh>
@@ -85,8 +89,74 @@ namespace lperf
         Paused,
     };
 
+    /**
+     * @brief 内存映射
+     */
+    struct MemoryMapping
+    {
+        uintptr_t Start = 0;
+        uintptr_t End = 0;
+        uintptr_t Offset = 0;  // 在文件中的偏移
+        std::string Path;
+    };
+
+    /**
+     * @brief 可执行文件的调试符号
+     *
+     * 同一可执行文件（按设备号与 inode 区分）的多个进程共享一份，避免重复加载 ELF 与解析 DWARF。
+     * 查询方法可以在多个线程中同时调用。
+     */
+    class DebugSymbols
+    {
+    public:
+        /**
+         * @brief 加载进程的可执行文件的调试符号
+         * @param pid 进程ID
+         * @return 已加载过同一文件时返回共享的对象
+         */
+        static std::shared_ptr<DebugSymbols> Load(ProcessId pid);
+
+    public:
+        DebugSymbols(int fd);
+
+        DebugSymbols(const DebugSymbols&) = delete;
+        DebugSymbols& operator=(const DebugSymbols&) = delete;
+
+    public:
+        /**
+         * @brief 获取ELF
+         */
+        const elf::elf& GetElf()const noexcept { return m_stElfParser; }
+
+        /**
+         * @brief 根据地址获取函数名称
+         * @param address 相对映像的地址
+         * @return 函数名称，找不到时为空串
+         */
+        const std::string& GetFunctionName(uintptr_t address);
+
+        /**
+         * @brief 查找函数的地址
+         * @param func 函数名
+         * @param skipPrologue 跳过编译器生成的栈平衡代码
+         * @return 相对映像的地址
+         */
+        uintptr_t FindFunction(const char* func, bool skipPrologue);
+
+    private:
+        dwarf::line_table::iterator GetLineEntryFromPC(uint64_t pc);
+
+    private:
+        std::mutex m_stLock;
+        elf::elf m_stElfParser;
+        dwarf::dwarf m_stDwarfParser;
+        std::unordered_map<uintptr_t, std::string> m_stSymbolCacheMap;
+    };
+
     /**
      * @brief 调试器
+     *
+     * 所有 ptrace 调用都必须来自挂接的线程，因此一个调试器只能在构造它的线程中使用。
      */
     class Debugger
     {
@@ -113,6 +183,11 @@ namespace lperf
          */
         ProcessStatus GetStatus()const noexcept { return m_uStatus; }
 
+        /**
+         * @brief 获取进程ID
+         */
+        ProcessId GetPid()const noexcept { return m_uPid; }
+
         /**
          * @brief 获取退出代码
          */
@@ -129,6 +204,16 @@ namespace lperf
          */
         bool Wait();
 
+        /**
+         * @brief 处理进程运行期间产生的事件（不阻塞）
+         * @return 当进程终止返回false，否则返回true。
+         *
+         * 被挂接的进程收到信号时停在 signal-delivery-stop，直到调试器让其继续；退出后也需要调试器回收。
+         * 长时间挂接而不打断进程时（如常驻服务的空闲目标）需要定期调用：信号被原样投递，
+         * group-stop 以 PTRACE_LISTEN 保持停止。
+         */
+        bool Poll();
+
         /**
          * @brief 打断进程执行
          */
@@ -195,8 +280,10 @@ namespace lperf
          * @param address 地址
          * @param maxlen 最长长度
          * @return 读取的字符串
+         *
+         * 通过 ReadMemory 按页读取，同样可以在任意线程中调用。
          */
-        std::string ReadString(uintptr_t address, size_t maxlen=1024);
+        std::string ReadString(uintptr_t address, size_t maxlen=1024)const;
 
         /**
          * @brief 从指定地址读取若干字节数据
@@ -207,6 +294,28 @@ namespace lperf
          */
         size_t ReadBytes(uintptr_t address, uint8_t buffer[], size_t count);
 
+        /**
+         * @brief 通过 process_vm_readv 读取若干字节数据
+         * @param address 地址
+         * @param buffer 缓冲区
+         * @param count 读取的数量
+         * @return 实际读取的数量，遇到不可读的页面时提前结束
+         *
+         * 与其他方法不同，可以在任意线程中调用，也不要求目标进程暂停（读取的数据可能正被修改）。
+         */
+        size_t ReadMemory(uintptr_t address, uint8_t buffer[], size_t count)const;
+
+        /**
+         * @brief 通过 process_vm_readv 分散读取多段数据
+         * @param local 本地缓冲区
+         * @param remote 远端地址范围，与 local 的总长度相同
+         * @param count 远端地址范围的个数
+         * @return 实际读取的总字节数，按顺序遇到不可读的页面时提前结束
+         *
+         * 超过 IOV_MAX 的范围被分成多次系统调用。同样可以在任意线程中调用。
+         */
+        size_t ReadMemory(const struct iovec* local, const struct iovec* remote, size_t count)const;
+
         /**
          * @brief 将数据写入指定地址
          * @param address 地址
@@ -272,11 +381,28 @@ namespace lperf
          */
         const std::string& GetFunctionName(uintptr_t address);
 
+        /**
+         * @brief 获取进程中可执行的内存映射
+         * @return 映射列表
+         */
+        std::vector<MemoryMapping> GetExecutableMappings();
+
+        /**
+         * @brief 获取可执行文件的 GNU build-id
+         * @return 十六进制字符串，没有 .note.gnu.build-id 段时返回空串
+         */
+        std::string GetBuildId();
+
+        /**
+         * @brief 获取进程的命令行
+         * @return 以空格分隔的参数
+         */
+        std::string GetCommandLine();
+
     private:
         void GetProcessBaseAddress();
         void InternalStepOver();
         bool StepOverBreakpoint();
-        dwarf::line_table::iterator GetLineEntryFromPC(uint64_t pc);
 
     private:
         ProcessStatus m_uStatus = ProcessStatus::Terminated;
@@ -286,9 +412,14 @@ namespace lperf
 
         std::unordered_map<uintptr_t, std::unique_ptr<Breakpoint>> m_stBreakpoints;
 
-        elf::elf m_stElfParser;
-        dwarf::dwarf m_stDwarfParser;
+        std::shared_ptr<DebugSymbols> m_pSymbols;
         uintptr_t m_uAddressOffset = 0;
-        std::unordered_map<uintptr_t, std::string> m_stSymbolCacheMap;
     };
+
+    /**
+     * @brief 按名称查找进程
+     * @param name 进程名（/proc/PID/comm）或可执行文件的文件名
+     * @return 进程ID（升序，不含自身）
+     */
+    std::vector<ProcessId> FindProcesses(const std::string& name);
 }
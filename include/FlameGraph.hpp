@@ -0,0 +1,39 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <iosfwd>
+#include <functional>
+
+#include "Profile.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 火焰图选项
+     */
+    struct FlameGraphOptions
+    {
+        std::string Title = "Flame Graph";
+        unsigned Width = 1200;  // 图像宽度（像素）
+        unsigned FrameHeight = 16;  // 每层栈帧的高度（像素）
+        double MinWidth = 0.1;  // 小于该宽度（像素）的栈帧及其子帧将被忽略
+        bool Html = false;  // 是否输出为HTML页面，否则为SVG
+        std::function<std::string(ProfileId)> Color;  // 若设置，则按堆栈ID决定颜色
+        std::function<std::string(ProfileId)> Detail;  // 若设置，则附加到堆栈的提示信息中
+    };
+
+    /**
+     * @brief 输出火焰图
+     * @param profile 剖析数据
+     * @param out 输出流
+     * @param options 选项
+     *
+     * 直接基于 Profile 的堆栈树计算各节点的总计数并布局，在同一次遍历中剪除不足 MinWidth 的子树，
+     * 开销只与堆栈节点数相关而与采样数无关。
+     * LUA、本地和VM内部帧使用不同的色系，输出的图形支持点击缩放。
+     */
+    void WriteFlameGraph(const Profile& profile, std::ostream& out, const FlameGraphOptions& options);
+}
@@ -0,0 +1,72 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstdint>
+
+#include <zlib.h>
+
+namespace lperf
+{
+    /**
+     * @brief GZIP压缩输出
+     *
+     * 将写入的数据压缩后逐块写入到输出流中。
+     */
+    class GzipOutputStream
+    {
+    public:
+        /**
+         * @brief 构造压缩输出
+         * @param out 输出流
+         * @param level 压缩级别
+         */
+        GzipOutputStream(std::ostream& out, int level=Z_DEFAULT_COMPRESSION);
+        ~GzipOutputStream();
+
+        GzipOutputStream(const GzipOutputStream&) = delete;
+        GzipOutputStream& operator=(const GzipOutputStream&) = delete;
+
+    public:
+        /**
+         * @brief 写入数据
+         * @param data 数据
+         * @param size 大小
+         */
+        void Write(const void* data, size_t size);
+
+        void Write(const std::string& data) { Write(data.data(), data.size()); }
+
+        /**
+         * @brief 结束压缩并写出剩余数据
+         */
+        void Finish();
+
+    private:
+        void Deflate(int flush);
+
+    private:
+        std::ostream& m_stOutput;
+        ::z_stream m_stStream;
+        std::vector<uint8_t> m_stBuffer;
+        bool m_bFinished = false;
+    };
+
+    /**
+     * @brief 判断文件是否为GZIP压缩
+     * @param path 路径
+     */
+    bool IsGzipFile(const std::string& path);
+
+    /**
+     * @brief 读取并解压GZIP文件
+     * @param path 路径
+     * @param[out] out 解压后的数据
+     */
+    void ReadGzipFile(const std::string& path, std::string& out);
+}
@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <set>
+
+#include "Profile.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 限定内存的堆栈聚合
+     *
+     * 长时间采样时不同堆栈的数量没有上界，此处以 Space-Saving 算法只跟踪最重的若干堆栈：
+     * 堆栈表的内存超过上限时淘汰计数最小的堆栈，新堆栈继承被淘汰的计数作为误差。
+     * 对任意被跟踪的堆栈，真实次数位于 [Count - Error, Count] 之间，Error 不超过当前的淘汰下限；
+     * 未被跟踪的堆栈的真实次数也不超过该下限，而下限不超过 总次数 / 跟踪的堆栈数。
+     *
+     * 另外对每个栈顶帧精确计数，输出时以被跟踪堆栈的下界作为其次数，
+     * 余下的次数归入按栈顶帧划分的 "(tail)" 分组，使总次数与每个函数的自身次数保持精确。
+     */
+    class HeavyHitterProfile
+    {
+        using StackKey = std::vector<ProfileId>;
+
+        struct StackKeyHasher
+        {
+            size_t operator()(const StackKey& key)const noexcept;
+        };
+
+        struct Entry
+        {
+            uint64_t Count = 0;
+            uint64_t Error = 0;
+        };
+
+    public:
+        /**
+         * @brief 构造聚合器
+         * @param lineMode 是否按当前执行的行区分LUA帧
+         * @param memoryCap 堆栈表的内存上限（字节）
+         */
+        HeavyHitterProfile(bool lineMode, size_t memoryCap);
+
+    public:
+        /**
+         * @brief 累计一次采样
+         * @param stack 堆栈（栈顶在前），空栈计为 (idle)
+         */
+        void AddSample(const std::vector<LuaStackFrame>& stack);
+
+        /**
+         * @brief 获取总采样次数
+         */
+        uint64_t GetTotalSampleCount()const noexcept { return m_uTotalSampleCount; }
+
+        /**
+         * @brief 获取跟踪的堆栈数
+         */
+        size_t GetTrackedCount()const noexcept { return m_stEntries.size(); }
+
+        /**
+         * @brief 获取被淘汰的次数
+         */
+        uint64_t GetEvictionCount()const noexcept { return m_uEvictionCount; }
+
+        /**
+         * @brief 获取误差上限，即任意堆栈的次数最多被低估的值
+         */
+        uint64_t GetErrorBound()const noexcept { return m_uFloor; }
+
+        /**
+         * @brief 获取堆栈表占用的内存（估算）
+         */
+        size_t GetMemoryUsage()const noexcept { return m_uMemoryUsage; }
+
+        /**
+         * @brief 输出为剖析数据
+         * @param[out] out 剖析数据（应为空）
+         * @return 归入 "(tail)" 分组的次数
+         */
+        uint64_t BuildProfile(Profile& out)const;
+
+    private:
+        size_t GetEntryCost(const StackKey& key)const noexcept;
+        void EvictMin();
+
+    private:
+        size_t m_uMemoryCap = 0;
+        Profile m_stDictionary;  // 只用于驻留字符串与栈帧
+
+        std::unordered_map<StackKey, Entry, StackKeyHasher> m_stEntries;
+        std::set<std::pair<uint64_t, const StackKey*>> m_stOrder;  // 按次数排序，用于找到最小的堆栈
+        std::vector<uint64_t> m_stLeafCounts;  // 每个栈顶帧的精确次数
+
+        uint64_t m_uTotalSampleCount = 0;
+        uint64_t m_uFloor = 0;
+        uint64_t m_uEvictionCount = 0;
+        size_t m_uMemoryUsage = 0;
+
+        StackKey m_stKeyBuffer;
+    };
+}
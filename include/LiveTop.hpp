@@ -0,0 +1,74 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <iosfwd>
+
+#include "Profile.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 实时热点函数视图
+     *
+     * 采样累计到 Profile 中，每次刷新只处理自上次刷新以来发生变化的堆栈（增量），
+     * 将本窗口的次数折算为每秒采样数，并按半衰期做指数衰减，使视图既能快速反映当前热点又不至于剧烈抖动。
+     */
+    class LiveTop
+    {
+    public:
+        /**
+         * @brief 构造视图
+         * @param halfLife 衰减的半衰期（秒）
+         * @param lineMode 是否按当前执行的行区分LUA帧
+         */
+        LiveTop(double halfLife, bool lineMode=false);
+
+    public:
+        /**
+         * @brief 累计一次采样
+         * @param stack 堆栈（栈顶在前），空栈表示目标不在执行LUA代码，计为 (idle)
+         */
+        void OnSample(const std::vector<LuaStackFrame>& stack);
+
+        /**
+         * @brief 结束一个窗口，更新衰减后的速率
+         * @param elapsed 窗口时长（秒）
+         */
+        void Update(double elapsed);
+
+        /**
+         * @brief 输出热点函数表
+         * @param out 输出流
+         * @param topCount 条目数
+         */
+        void Write(std::ostream& out, unsigned topCount)const;
+
+        /**
+         * @brief 获取衰减后的每秒采样数
+         */
+        double GetSampleRate()const noexcept { return m_dSampleRate; }
+
+        /**
+         * @brief 获取总采样次数
+         */
+        uint64_t GetTotalSampleCount()const noexcept { return m_stProfile.GetTotalSampleCount(); }
+
+    private:
+        double m_dHalfLife = 0;
+        Profile m_stProfile;
+
+        bool m_bInitialized = false;
+        double m_dSampleRate = 0;
+        std::vector<double> m_stSelfRates;  // 按栈帧，衰减后的每秒自身采样数
+        std::vector<double> m_stTotalRates;  // 按栈帧，衰减后的每秒总采样数
+        std::vector<uint64_t> m_stTotalCounts;  // 按栈帧，累计的总采样次数
+
+        std::vector<uint64_t> m_stWindowSelf;
+        std::vector<uint64_t> m_stWindowTotal;
+        std::vector<uint32_t> m_stFrameMarks;  // 同一堆栈中的递归帧只计一次
+        uint32_t m_uMark = 0;
+    };
+}
@@ -5,6 +5,7 @@
  */
 #pragma once
 #include "Debugger.hpp"
+#include "RemoteLuaWrapper.hpp"
 
 namespace lperf
 {
@@ -13,6 +14,7 @@ namespace lperf
         Unknown,
         Native,
         Lua,
+        VirtualMachine,  // VM内部的合成帧，如操作码
     };
 
     struct LuaStackFrame
@@ -22,6 +24,22 @@ namespace lperf
         std::string Source;
         std::string Name;
         unsigned Line = 0;
+        unsigned CurrentLine = 0;
+        uintptr_t ProtoAddress = 0;
+        int Pc = -1;
+    };
+
+    /**
+     * @brief 复制的LUA堆栈
+     *
+     * 由 LuaSampler::CaptureStack 在目标进程暂停期间填充，之后可在其他线程中解析为 LuaStackFrame。
+     * 对象可以反复使用，以避免重新分配内存。
+     */
+    struct LuaRawStack
+    {
+        uintptr_t Address = 0;  // lua_State的远端地址
+        RemotePtr<LuaObjects::global_State> Global { nullptr };  // lua_State::l_G
+        std::vector<LuaObjects::RawCallFrame> Frames;  // 栈顶在前，不含base_ci
     };
 
     /**
@@ -47,10 +65,55 @@ namespace lperf
         /**
          * @brief 导出LUA堆栈
          * @param address 指示lua_State对象的地址
+         *
+         * 相当于 CaptureStack 后接 Symbolize。
          */
         std::vector<LuaStackFrame> DumpStack(uintptr_t address);
 
+        /**
+         * @brief 复制LUA堆栈
+         * @param address 指示lua_State对象的地址
+         * @param[out] out 输出
+         *
+         * 暂停目标进程，只复制调用链中会随执行变化的数据后立即恢复执行。
+         * 必须在挂接的线程中调用。
+         *
+         * 栈底（主循环、分发器等）在相邻的采样之间很少变化：上次的调用链与 lua_State 在同一次读取中被重新读取，
+         * 从栈底起内容未变的帧构成可复用的部分，遍历到其中的任一帧时直接拼接，不再逐层读取。
+         */
+        void CaptureStack(uintptr_t address, LuaRawStack& out);
+
+        /**
+         * @brief 解析复制的LUA堆栈
+         * @param stack 复制的堆栈
+         * @param[out] out 输出（栈顶在前）
+         *
+         * 通过 process_vm_readv 读取不变的数据（Proto、字符串等），目标进程无需暂停，可在任意线程中调用，
+         * 但同一时刻只能有一个线程调用。
+         * 与上次解析的堆栈相比栈底未变的帧（连同其调用者）直接复用上次的结果。
+         */
+        void Symbolize(const LuaRawStack& stack, std::vector<LuaStackFrame>& out);
+
+        /**
+         * @brief 获取Proto缓存
+         */
+        const ProtoCache& GetProtoCache()const noexcept { return m_stProtoCache; }
+
+        /**
+         * @brief 获取解析时使用的字符串缓存
+         */
+        StringCache& GetStringCache()noexcept { return m_stProtoCache.GetStringCache(); }
+
     private:
         Debugger& m_pDebugger;
+        ProtoCache m_stProtoCache;
+
+        // 仅由 CaptureStack 使用：上次复制的堆栈与校验用的缓冲区
+        LuaRawStack m_stLastCapture;
+        std::vector<LuaObjects::RawCallFrame> m_stVerifyFrames;
+
+        // 仅由 Symbolize 使用：上次解析的堆栈与结果
+        LuaRawStack m_stLastSymbolized;
+        std::vector<LuaStackFrame> m_stLastSymbolizedFrames;
     };
 }
@@ -0,0 +1,112 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <chrono>
+#include <memory>
+#include <functional>
+
+#include "LuaSampler.hpp"
+#include "Report.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 多进程采样的选项
+     */
+    struct MultiSamplerOptions
+    {
+        uint32_t SampleInterval = 10;  // 每个进程的采样间隔（毫秒）
+        uint32_t SampleCount = 0;  // 每个进程的采样次数，0表示不限
+        std::vector<uintptr_t> CustomEntryPoints;  // 自定义的获取 lua_State 的入口
+        unsigned Threads = 0;  // 采样线程数，0表示与CPU核数相同
+        size_t StringCacheCapacity = StringCache::DEFAULT_CAPACITY;  // 每个进程的短字符串缓存容量（字节）
+    };
+
+    /**
+     * @brief 多进程采样
+     *
+     * 由一个调度器为所有进程排定采样时刻：每个进程按相同的间隔采样，相位依次错开 间隔/进程数，
+     * 使各进程的暂停均匀分布而不是同时发生。
+     *
+     * 所有 ptrace 调用都必须来自挂接的线程，因此进程被分配给固定的采样线程（线程数不超过CPU核数），
+     * 由该线程负责挂接、采样与解除挂接；每个进程持有各自的 Debugger 与 LuaSampler，
+     * 同一可执行文件的调试符号在进程之间共享。
+     */
+    class MultiSampler
+    {
+        struct Target;
+
+    public:
+        /**
+         * @brief 进程挂接完成后的回调，在采样线程中串行调用
+         * @param index 进程序号
+         * @param debugger 调试器
+         * @param sampler 采样器
+         */
+        using AttachCallback = std::function<void(size_t index, Debugger& debugger, LuaSampler& sampler)>;
+
+        /**
+         * @brief 采样回调，在采样线程中调用，同一进程的回调总在同一个线程中
+         * @param index 进程序号
+         * @param stack 堆栈（栈顶在前）
+         * @param info 采样信息
+         */
+        using SampleCallback = std::function<void(size_t index, const std::vector<LuaStackFrame>& stack,
+            const SampleInfo& info)>;
+
+    public:
+        MultiSampler(const std::vector<ProcessId>& pids, const MultiSamplerOptions& options);
+        ~MultiSampler();
+
+        MultiSampler(const MultiSampler&) = delete;
+        MultiSampler& operator=(const MultiSampler&) = delete;
+
+    public:
+        /**
+         * @brief 采样直到所有进程完成或请求停止
+         * @param onAttach 挂接回调
+         * @param onSample 采样回调
+         * @param stopRequested 返回true时停止
+         *
+         * 挂接失败的进程被忽略，返回前所有进程均已解除挂接。
+         */
+        void Run(const AttachCallback& onAttach, const SampleCallback& onSample,
+            const std::function<bool()>& stopRequested);
+
+        /**
+         * @brief 获取进程数
+         */
+        size_t GetTargetCount()const noexcept { return m_stTargets.size(); }
+
+        /**
+         * @brief 获取进程ID
+         */
+        ProcessId GetPid(size_t index)const noexcept;
+
+        /**
+         * @brief 获取进程是否成功挂接
+         */
+        bool IsAttached(size_t index)const noexcept;
+
+        /**
+         * @brief 获取进程的 Proto 缓存
+         * @return 进程未能挂接时返回nullptr
+         *
+         * 缓存在解除挂接后仍然有效，直到对象析构。
+         */
+        const ProtoCache* GetProtoCache(size_t index)const noexcept;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void RunWorker(size_t worker, size_t workerCount, Clock::time_point start, const AttachCallback& onAttach,
+            const SampleCallback& onSample, const std::function<bool()>& stopRequested);
+
+    private:
+        MultiSamplerOptions m_stOptions;
+        std::vector<std::unique_ptr<Target>> m_stTargets;
+    };
+}
@@ -0,0 +1,24 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <iosfwd>
+
+#include "Profile.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 以 pprof 格式输出剖析数据
+     * @param profile 剖析数据
+     * @param out 输出流
+     *
+     * 输出经GZIP压缩的 profile.proto，每个样本包含采样次数及按采样周期估算的时间两个值。
+     * 采样周期未知时（如由折叠堆栈、合并或比较得到的数据）只输出采样次数，避免 pprof 默认显示全为0的时间。
+     * 字符串表直接复用 Profile 中驻留的字符串，栈帧一一对应到 Location，编码过程为流式的线性时间。
+     * @see https://github.com/google/pprof/blob/master/proto/profile.proto
+     */
+    void WritePProf(const Profile& profile, std::ostream& out);
+}
@@ -0,0 +1,311 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <unordered_map>
+
+#include "LuaSampler.hpp"
+
+namespace lperf
+{
+    using ProfileId = uint32_t;
+
+    static const ProfileId INVALID_PROFILE_ID = static_cast<ProfileId>(-1);
+
+    /**
+     * @brief 空栈（采样时目标不在执行LUA代码）所记入的根帧的名称
+     */
+    static const char* const IDLE_FRAME_NAME = "(idle)";
+
+    /**
+     * @brief 驻留的栈帧
+     */
+    struct ProfileFrame
+    {
+        LuaFunctionType Type = LuaFunctionType::Unknown;
+        ProfileId Name = 0;
+        ProfileId Source = 0;
+        unsigned LineDefined = 0;
+        unsigned Line = 0;  // 行模式下为当前执行的行，否则为0
+        uintptr_t Address = 0;
+
+        bool operator==(const ProfileFrame& rhs)const noexcept
+        {
+            return Type == rhs.Type && Name == rhs.Name && Source == rhs.Source && LineDefined == rhs.LineDefined &&
+                Line == rhs.Line && Address == rhs.Address;
+        }
+    };
+
+    /**
+     * @brief 驻留的堆栈节点
+     *
+     * 堆栈以父指针树的形式保存，每个节点代表从栈底到该帧的一条调用路径。
+     */
+    struct ProfileStack
+    {
+        ProfileId Parent = INVALID_PROFILE_ID;
+        ProfileId Frame = 0;
+    };
+
+    /**
+     * @brief 本地代码的内存映射
+     */
+    struct ProfileMapping
+    {
+        uint64_t Start = 0;
+        uint64_t Limit = 0;
+        uint64_t Offset = 0;
+        ProfileId File = 0;
+    };
+
+    /**
+     * @brief 描述采样来源的标签（如主机名、命令行）
+     */
+    struct ProfileLabel
+    {
+        ProfileId Key = 0;
+        ProfileId Value = 0;
+    };
+
+    /**
+     * @brief 性能剖析数据
+     *
+     * 对字符串、栈帧和堆栈进行驻留，并按堆栈节点累计采样次数。
+     * 同时记录自上次 ResetDelta 以来发生变化的节点，使增量输出的开销只与变化的条目数相关。
+     */
+    class Profile
+    {
+        struct FrameHasher
+        {
+            size_t operator()(const ProfileFrame& frame)const noexcept;
+        };
+
+    public:
+        /**
+         * @brief 构造剖析数据
+         * @param lineMode 是否将LUA帧按当前执行的行区分
+         */
+        Profile(bool lineMode=false);
+
+    public:
+        /**
+         * @brief 是否按当前执行的行区分LUA帧
+         */
+        bool IsLineMode()const noexcept { return m_bLineMode; }
+        void SetLineMode(bool lineMode)noexcept { m_bLineMode = lineMode; }
+
+        /**
+         * @brief 获取/设置采样周期（纳秒）
+         */
+        uint64_t GetPeriod()const noexcept { return m_uPeriod; }
+        void SetPeriod(uint64_t ns)noexcept { m_uPeriod = ns; }
+
+        /**
+         * @brief 获取/设置开始采样的时间（UNIX时间，纳秒）
+         */
+        uint64_t GetStartTime()const noexcept { return m_uStartTime; }
+        void SetStartTime(uint64_t ns)noexcept { m_uStartTime = ns; }
+
+        /**
+         * @brief 获取/设置采样持续的时间（纳秒）
+         */
+        uint64_t GetDuration()const noexcept { return m_uDuration; }
+        void SetDuration(uint64_t ns)noexcept { m_uDuration = ns; }
+
+        /**
+         * @brief 添加本地代码的内存映射
+         * @param start 起始地址
+         * @param limit 结束地址
+         * @param offset 文件偏移
+         * @param file 文件路径
+         */
+        void AddMapping(uint64_t start, uint64_t limit, uint64_t offset, const std::string& file);
+
+        /**
+         * @brief 获取内存映射
+         */
+        const std::vector<ProfileMapping>& GetMappings()const noexcept { return m_stMappings; }
+
+        /**
+         * @brief 查找包含地址的内存映射
+         * @param address 地址
+         * @return 映射下标，未找到返回 INVALID_PROFILE_ID
+         */
+        ProfileId FindMapping(uint64_t address)const noexcept;
+
+        /**
+         * @brief 设置标签，已存在时覆盖
+         * @param key 键
+         * @param value 值
+         */
+        void SetLabel(const std::string& key, const std::string& value);
+
+        /**
+         * @brief 获取标签
+         */
+        const std::vector<ProfileLabel>& GetLabels()const noexcept { return m_stLabels; }
+
+        /**
+         * @brief 查找标签的值
+         * @param key 键
+         * @return 值，不存在时返回nullptr
+         */
+        const std::string* FindLabel(const std::string& key)const noexcept;
+
+        /**
+         * @brief 驻留字符串
+         * @param str 字符串
+         * @return 字符串ID
+         */
+        ProfileId InternString(const std::string& str);
+
+        /**
+         * @brief 驻留栈帧
+         * @param frame 栈帧
+         * @return 栈帧ID
+         */
+        ProfileId InternFrame(const ProfileFrame& frame);
+
+        /**
+         * @brief 驻留采样得到的栈帧
+         * @param frame 栈帧
+         * @return 栈帧ID
+         */
+        ProfileId InternFrame(const LuaStackFrame& frame);
+
+        /**
+         * @brief 驻留堆栈节点
+         * @param parent 父节点，栈底为 INVALID_PROFILE_ID
+         * @param frame 栈帧ID
+         * @return 堆栈ID
+         */
+        ProfileId InternStack(ProfileId parent, ProfileId frame);
+
+        /**
+         * @brief 驻留采样得到的堆栈
+         * @param stack 堆栈（栈顶在前）
+         * @return 栈顶对应的堆栈ID，空栈返回 InternIdleStack 的结果
+         */
+        ProfileId InternStack(const std::vector<LuaStackFrame>& stack);
+
+        /**
+         * @brief 驻留代表空栈的堆栈
+         * @return 堆栈ID
+         *
+         * 空栈记在名为 IDLE_FRAME_NAME 的根帧下，使这些采样同样计入总数。
+         */
+        ProfileId InternIdleStack();
+
+        /**
+         * @brief 检查栈帧是否为代表空栈的根帧
+         * @param frame 栈帧ID
+         */
+        bool IsIdleFrame(ProfileId frame)const noexcept;
+
+        /**
+         * @brief 导入另一份剖析数据中的堆栈
+         * @param other 剖析数据
+         * @param root 若非 INVALID_PROFILE_ID，则导入的堆栈挂在该节点之下
+         * @return 对方堆栈ID到本方堆栈ID的映射
+         *
+         * 对字符串、栈帧和堆栈重新驻留，不累计采样次数。
+         */
+        std::vector<ProfileId> Import(const Profile& other, ProfileId root=INVALID_PROFILE_ID);
+
+        /**
+         * @brief 合并另一份剖析数据
+         * @param other 剖析数据
+         * @param root 若非 INVALID_PROFILE_ID，则合并的堆栈挂在该节点之下
+         * @return 对方堆栈ID到本方堆栈ID的映射
+         */
+        std::vector<ProfileId> Merge(const Profile& other, ProfileId root=INVALID_PROFILE_ID);
+
+        /**
+         * @brief 累计采样
+         * @param stack 堆栈ID
+         * @param count 次数
+         */
+        void AddSample(ProfileId stack, uint64_t count=1);
+
+        /**
+         * @brief 获取字符串
+         */
+        const std::string& GetString(ProfileId id)const noexcept { return m_stStrings[id]; }
+
+        /**
+         * @brief 获取栈帧
+         */
+        const ProfileFrame& GetFrame(ProfileId id)const noexcept { return m_stFrames[id]; }
+
+        /**
+         * @brief 获取堆栈节点
+         */
+        const ProfileStack& GetStack(ProfileId id)const noexcept { return m_stStacks[id]; }
+
+        /**
+         * @brief 获取堆栈节点自身的采样次数
+         */
+        uint64_t GetSampleCount(ProfileId stack)const noexcept { return m_stSampleCounts[stack]; }
+
+        size_t GetStringCount()const noexcept { return m_stStrings.size(); }
+        size_t GetFrameCount()const noexcept { return m_stFrames.size(); }
+        size_t GetStackCount()const noexcept { return m_stStacks.size(); }
+
+        /**
+         * @brief 获取总采样次数
+         */
+        uint64_t GetTotalSampleCount()const noexcept { return m_uTotalSampleCount; }
+
+        /**
+         * @brief 获取从栈底到指定节点的栈帧
+         * @param stack 堆栈ID
+         * @param[out] out 栈帧ID（栈底在前）
+         */
+        void GetStackFrames(ProfileId stack, std::vector<ProfileId>& out)const;
+
+        /**
+         * @brief 获取自上次 ResetDelta 以来采样次数发生变化的堆栈节点
+         */
+        const std::vector<ProfileId>& GetDirtyStacks()const noexcept { return m_stDirtyStacks; }
+
+        /**
+         * @brief 获取堆栈节点自上次 ResetDelta 以来增加的采样次数
+         */
+        uint64_t GetDeltaCount(ProfileId stack)const noexcept { return m_stDeltaCounts[stack]; }
+
+        /**
+         * @brief 导出增量
+         * @param[out] out 剖析数据
+         *
+         * 将自上次 ResetDelta 以来发生变化的堆栈及其增加的次数合并到 out 中，开销只与变化的条目数相关。
+         */
+        void ExportDelta(Profile& out)const;
+
+        /**
+         * @brief 清除增量记录
+         */
+        void ResetDelta()noexcept;
+
+    private:
+        bool m_bLineMode = false;
+        uint64_t m_uPeriod = 0;
+        uint64_t m_uStartTime = 0;
+        uint64_t m_uDuration = 0;
+        std::vector<ProfileMapping> m_stMappings;
+        std::vector<ProfileLabel> m_stLabels;
+
+        std::vector<std::string> m_stStrings;
+        std::unordered_map<std::string, ProfileId> m_stStringIndex;
+        std::vector<ProfileFrame> m_stFrames;
+        std::unordered_map<ProfileFrame, ProfileId, FrameHasher> m_stFrameIndex;
+        std::vector<ProfileStack> m_stStacks;
+        std::unordered_map<uint64_t, ProfileId> m_stStackIndex;
+
+        uint64_t m_uTotalSampleCount = 0;
+        std::vector<uint64_t> m_stSampleCounts;
+        std::vector<uint64_t> m_stDeltaCounts;
+        std::vector<ProfileId> m_stDirtyStacks;
+    };
+}
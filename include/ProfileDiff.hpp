@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <iosfwd>
+
+#include "Profile.hpp"
+#include "FlameGraph.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 差异条目
+     *
+     * 比例为采样次数除以各自的总采样数，误差为比例之差在95%置信度下的区间半宽（正态近似）。
+     * 一次比较会同时检验成百上千个条目，是否显著由同一组条目的P值经 Benjamini-Hochberg 校正后决定，
+     * 将误报的比例控制在5%以内，而不是逐个与误差比较。
+     */
+    struct DiffEntry
+    {
+        ProfileId Id = INVALID_PROFILE_ID;
+        uint64_t BaseCount = 0;
+        uint64_t CompareCount = 0;
+        double BaseRatio = 0.;
+        double CompareRatio = 0.;
+        double Delta = 0.;  // CompareRatio - BaseRatio
+        double Error = 0.;
+        double PValue = 1.;  // 双侧检验，未校正
+        bool Significant = false;
+
+        /**
+         * @brief 差异是否超出采样噪声（经多重比较校正）
+         */
+        bool IsSignificant()const noexcept { return Significant; }
+    };
+
+    /**
+     * @brief 剖析数据比较
+     *
+     * 将两份剖析数据按驻留的栈帧对齐到同一棵调用树上，计算各函数和各调用路径的归一化差异。
+     */
+    class ProfileDiff
+    {
+    public:
+        /**
+         * @brief 比较两份剖析数据
+         * @param base 基准
+         * @param compare 比较对象
+         */
+        ProfileDiff(const Profile& base, const Profile& compare);
+
+    public:
+        /**
+         * @brief 获取对齐后的剖析数据
+         *
+         * 采样次数取比较对象，基准的采样次数见 GetBaseSelfCount。
+         */
+        const Profile& GetProfile()const noexcept { return m_stProfile; }
+
+        uint64_t GetBaseTotal()const noexcept { return m_uBaseTotal; }
+        uint64_t GetCompareTotal()const noexcept { return m_uCompareTotal; }
+
+        /**
+         * @brief 获取函数（栈帧）的差异
+         * @param self 为true时比较自身计数，否则比较总计数（同一堆栈中重复出现只计一次）
+         * @return 以栈帧ID为下标的差异
+         */
+        std::vector<DiffEntry> GetFunctionDiff(bool self)const;
+
+        /**
+         * @brief 获取调用路径的差异
+         * @return 以堆栈ID为下标的差异（包含子路径的总计数）
+         */
+        std::vector<DiffEntry> GetPathDiff()const;
+
+        /**
+         * @brief 输出文本报告
+         * @param out 输出流
+         * @param topCount 每一类列出的条目数
+         *
+         * 只列出超出采样噪声的条目，按差异的绝对值排序。
+         */
+        void WriteText(std::ostream& out, unsigned topCount)const;
+
+        /**
+         * @brief 输出差异火焰图
+         * @param out 输出流
+         * @param options 火焰图选项
+         *
+         * 宽度取比较对象，增加的路径为红色、减少的为蓝色，颜色深浅与差异大小相关，噪声范围内的路径为灰色。
+         */
+        void WriteFlameGraph(std::ostream& out, FlameGraphOptions options)const;
+
+    private:
+        DiffEntry MakeEntry(ProfileId id, uint64_t base, uint64_t compare)const noexcept;
+        static void MarkSignificant(std::vector<DiffEntry>& entries);
+
+    private:
+        Profile m_stProfile;
+        uint64_t m_uBaseTotal = 0;
+        uint64_t m_uCompareTotal = 0;
+        std::vector<uint64_t> m_stBaseSelfCounts;
+    };
+}
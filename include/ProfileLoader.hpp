@@ -0,0 +1,40 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <iosfwd>
+
+#include "Profile.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 解析折叠堆栈中的帧名称
+     * @param profile 剖析数据，用于驻留字符串
+     * @param text 帧名称（FormatProfileFrame 的输出）
+     * @return 栈帧
+     *
+     * 对 lperf 输出的帧名称还原出帧类型、函数名、源文件和行号；无法识别的文本作为未知帧保留其名称。
+     */
+    ProfileFrame ParseFoldedFrame(Profile& profile, const std::string& text);
+
+    /**
+     * @brief 读取折叠堆栈
+     * @param in 输入流
+     * @param[out] profile 剖析数据
+     *
+     * 每行为 "帧;帧;...;帧 次数"，以#开头的行被忽略（标签行除外），相同的堆栈累加，因此也可以读取流式输出的增量文件。
+     */
+    void LoadFoldedProfile(std::istream& in, Profile& profile);
+
+    /**
+     * @brief 从文件读取剖析数据
+     * @param path 路径
+     * @param[out] profile 剖析数据
+     *
+     * 根据文件头自动识别二进制格式或折叠堆栈格式。
+     */
+    void LoadProfile(const std::string& path, Profile& profile);
+}
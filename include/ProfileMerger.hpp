@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <iosfwd>
+
+#include "Profile.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 合并多个剖析文件
+     *
+     * 输入以有限的窗口并行读取（折叠文件解析、二进制文件映射），再按输入顺序逐个合并到同一份驻留字典中，
+     * 合并完成即释放，因此内存只与合并结果的大小及窗口大小相关，而与输入的数量无关。
+     * 二进制文件直接从映射的表合并，不产生中间的 Profile。
+     *
+     * 指定分组键时，每个输入的堆栈被挂在形如 "host=xxx" 的标签帧之下，在火焰图等视图中按来源分组；
+     * 所有输入上取值相同的标签保留为结果的标签。
+     */
+    class ProfileMerger
+    {
+    public:
+        /**
+         * @brief 输入文件
+         */
+        struct Input
+        {
+            std::string Path;
+            std::vector<std::pair<std::string, std::string>> Labels;  // 覆盖文件中记录的同名标签
+        };
+
+    public:
+        /**
+         * @brief 构造合并器
+         * @param groupKeys 分组使用的标签键（按从外到内的顺序）
+         * @param jobs 同时读取的文件数
+         */
+        ProfileMerger(const std::vector<std::string>& groupKeys, unsigned jobs=4);
+
+    public:
+        /**
+         * @brief 合并输入文件
+         * @param inputs 输入文件
+         */
+        void Merge(const std::vector<Input>& inputs);
+
+        /**
+         * @brief 获取合并结果
+         */
+        Profile& GetResult()noexcept { return m_stResult; }
+
+        /**
+         * @brief 获取已合并的文件数
+         */
+        size_t GetInputCount()const noexcept { return m_uInputCount; }
+
+    private:
+        struct LoadedInput;
+
+        void MergeInput(const Input& input, LoadedInput& loaded);
+        void UpdateCommonLabels(const std::vector<std::pair<std::string, std::string>>& labels);
+
+    private:
+        std::vector<std::string> m_stGroupKeys;
+        unsigned m_uJobs = 4;
+
+        Profile m_stResult;
+        size_t m_uInputCount = 0;
+        bool m_bHasLineMode = false;
+        uint64_t m_uEndTime = 0;
+        std::vector<std::pair<std::string, std::string>> m_stCommonLabels;
+    };
+
+    /**
+     * @brief 读取合并清单
+     * @param in 输入流
+     * @return 输入文件
+     *
+     * 每行为 "路径 [键=值 ...]"，以#开头的行被忽略。
+     */
+    std::vector<ProfileMerger::Input> ReadMergeManifest(std::istream& in);
+}
@@ -0,0 +1,103 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <regex>
+#include <iosfwd>
+
+#include "BinaryProfile.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 剖析数据查询
+     *
+     * 直接在扁平的堆栈表（父节点数组、栈帧数组、采样次数数组）上计算，二进制文件无需加载即可查询。
+     * 过滤与汇总均为对堆栈表的线性遍历，总计数使用一次深度优先遍历计算，递归调用只计一次。
+     */
+    class ProfileQuery
+    {
+    public:
+        /**
+         * @brief 查询映射的二进制文件
+         * @param profile 二进制剖析文件，需在查询期间保持有效
+         */
+        ProfileQuery(const BinaryProfile& profile);
+
+        /**
+         * @brief 查询内存中的剖析数据
+         * @param profile 剖析数据
+         */
+        ProfileQuery(const Profile& profile);
+
+    public:
+        /**
+         * @brief 只保留包含匹配帧的采样
+         * @param pattern 正则表达式，为空时不过滤
+         */
+        void SetFocus(const std::string& pattern);
+
+        /**
+         * @brief 丢弃包含匹配帧的采样
+         * @param pattern 正则表达式，为空时不过滤
+         */
+        void SetIgnore(const std::string& pattern);
+
+        /**
+         * @brief 输出按函数汇总的排行
+         * @param out 输出流
+         * @param topCount 条目数
+         * @param sortByTotal 按总计数排序，否则按自身计数排序
+         */
+        void WriteTop(std::ostream& out, unsigned topCount, bool sortByTotal);
+
+        /**
+         * @brief 输出按源文件汇总的排行
+         * @param out 输出流
+         * @param topCount 条目数
+         * @param sortByTotal 按总计数排序，否则按自身计数排序
+         */
+        void WriteSources(std::ostream& out, unsigned topCount, bool sortByTotal);
+
+        /**
+         * @brief 输出指定函数的调用方与被调用方
+         * @param out 输出流
+         * @param pattern 匹配函数的正则表达式
+         * @param topCount 条目数
+         */
+        void WritePeers(std::ostream& out, const std::string& pattern, unsigned topCount);
+
+    private:
+        void Initialize();
+        void ApplyFilter();
+        std::vector<bool> MatchFrames(const std::string& pattern)const;
+        void Accumulate(const std::vector<uint32_t>& keys, size_t keyCount, std::vector<uint64_t>& self,
+            std::vector<uint64_t>& total)const;
+        void WriteSummary(std::ostream& out, const std::vector<std::string>& names, const std::vector<uint64_t>& self,
+            const std::vector<uint64_t>& total, unsigned topCount, bool sortByTotal)const;
+
+    private:
+        size_t m_uStackCount = 0;
+        const uint32_t* m_pParents = nullptr;
+        const uint32_t* m_pFrames = nullptr;
+        const uint64_t* m_pCounts = nullptr;
+        std::vector<uint32_t> m_stParentStorage;
+        std::vector<uint32_t> m_stFrameStorage;
+        std::vector<uint64_t> m_stCountStorage;
+
+        std::vector<std::string> m_stFrameNames;
+        std::vector<std::string> m_stFrameSources;
+
+        std::vector<size_t> m_stChildOffsets;  // 下标0为根节点
+        std::vector<uint32_t> m_stChildren;
+
+        std::string m_stFocus;
+        std::string m_stIgnore;
+        std::vector<uint64_t> m_stWeights;  // 过滤后各堆栈节点自身的采样次数
+        std::vector<uint64_t> m_stInclusive;  // 过滤后各堆栈节点的总采样次数
+        uint64_t m_uTotal = 0;
+        uint64_t m_uFilteredTotal = 0;
+    };
+}
@@ -4,19 +4,34 @@
  * @date 2018/9/8
  */
 #pragma once
+#include <list>
+#include <mutex>
 #include <memory>
 #include <vector>
+#include <type_traits>
+#include <unordered_map>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <csignal>
 #include <cstddef>
+#include <unistd.h>
 
 #include <Moe.Core/ArrayView.hpp>
 #include <Moe.Core/Exception.hpp>
 
 namespace lperf
 {
+    /**
+     * @brief 一次内存读取请求
+     */
+    struct MemoryReadRequest
+    {
+        uintptr_t Address = 0;
+        void* Output = nullptr;
+        size_t Size = 0;
+    };
+
     /**
      * @brief 内存访问抽象
      */
@@ -34,6 +49,18 @@ namespace lperf
             return n & ~(Align - 1);
         }
 
+    public:
+        /**
+         * @brief 获取内存页的大小
+         *
+         * 一次读取不跨越页的边界时，不会因相邻的页不可读而失败。
+         */
+        static size_t GetPageSize()noexcept
+        {
+            static const size_t s_uPageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+            return s_uPageSize;
+        }
+
     public:
         /**
          * @brief 读取内存
@@ -50,6 +77,37 @@ namespace lperf
          */
         virtual std::string ReadString(uintptr_t address, size_t maxlen=512) = 0;
 
+        /**
+         * @brief 批量读取内存
+         * @param requests 请求（地址与长度不要求对齐）
+         *
+         * 默认逐个读取；支持分散读取的实现应重写，以便一次系统调用完成所有请求。
+         */
+        virtual void ReadBatch(const std::vector<MemoryReadRequest>& requests)
+        {
+            for (const auto& request : requests)
+                ReadBytes(request.Address, request.Output, request.Size);
+        }
+
+        /**
+         * @brief 读取任意地址与长度的内存
+         * @param address 地址
+         * @param output 输出
+         * @param size 长度
+         */
+        void ReadBytes(uintptr_t address, void* output, size_t size)
+        {
+            if (size == 0)
+                return;
+
+            auto lowBound = RoundDown(address);
+            auto highBound = RoundUp(address + size);
+            m_stBuffer.resize(highBound - lowBound);
+
+            Read(lowBound, moe::MutableBytesView(m_stBuffer.data(), m_stBuffer.size()));
+            ::memcpy(output, m_stBuffer.data() + (address - lowBound), size);
+        }
+
         /**
          * @brief 读取结构体
          * @tparam T 类型
@@ -59,16 +117,21 @@ namespace lperf
         template <typename T>
         void Read(T& out, uintptr_t address)
         {
-            auto lowBound = RoundDown(address);
-            assert(lowBound <= address);
-            auto highBound = RoundUp(address + sizeof(out));
-            assert(highBound >= address + sizeof(out));
-            m_stBuffer.resize(highBound - lowBound);
-            assert(m_stBuffer.size() >= sizeof(out));
+            ReadBytes(address, &out, sizeof(out));
+        }
 
-            Read(lowBound, moe::MutableBytesView(m_stBuffer.data(), m_stBuffer.size()));
-            ::memset(&out, 0, sizeof(out));
-            ::memcpy(&out, m_stBuffer.data() + (address - lowBound), sizeof(out));
+        /**
+         * @brief 读取数组
+         * @tparam T 元素类型
+         * @param out 输出
+         * @param address 地址
+         * @param count 元素个数
+         */
+        template <typename T>
+        void ReadArray(std::vector<T>& out, uintptr_t address, size_t count)
+        {
+            out.resize(count);
+            ReadBytes(address, out.data(), sizeof(T) * count);
         }
 
     private:
@@ -77,9 +140,14 @@ namespace lperf
 
     using MemoryAccessorPtr = std::shared_ptr<MemoryAccessorBase<>>;
 
-    MemoryAccessorPtr GetGlobalMemoryAccessor()noexcept;
-    void SetGlobalMemoryAccessor(MemoryAccessorPtr ptr);
+    class ProtoCache;
+    struct LoopInfo;
 
+    /**
+     * @brief 远端指针
+     *
+     * 读取时需显式传入内存访问器，以便多个线程同时解码不同的目标或采样。
+     */
     template <typename T>
     struct RemotePtr
     {
@@ -87,13 +155,6 @@ namespace lperf
 
         operator bool()const { return pointer != nullptr; }
 
-        T operator*()const
-        {
-            T ret;
-            Read(ret);
-            return ret;
-        }
-
         bool operator==(std::nullptr_t)const noexcept { return pointer == nullptr; }
         bool operator!=(std::nullptr_t)const noexcept { return pointer != nullptr; }
         bool operator==(const RemotePtr& rhs)const noexcept { return pointer == rhs.pointer; }
@@ -103,17 +164,99 @@ namespace lperf
         bool operator==(uintptr_t rhs)const noexcept { return reinterpret_cast<uintptr_t>(pointer) == rhs; }
         bool operator!=(uintptr_t rhs)const noexcept { return reinterpret_cast<uintptr_t>(pointer) != rhs; }
 
-        void Read(T& out)const
+        /**
+         * @brief 读取对象
+         * @param accessor 内存访问器
+         * @param[out] out 输出
+         */
+        void Read(MemoryAccessorBase<>& accessor, T& out)const
         {
-            auto accessor = GetGlobalMemoryAccessor();
-            if (!accessor)
-                MOE_THROW(moe::InvalidCallException, "Memory accessor not set");
             if (!pointer)
                 MOE_THROW(moe::InvalidCallException, "Object pointer is null");
 
-            accessor->Read(out, reinterpret_cast<uintptr_t>(pointer));
+            accessor.Read(out, reinterpret_cast<uintptr_t>(pointer));
+        }
+
+        /**
+         * @brief 读取对象
+         * @param accessor 内存访问器
+         * @return 对象
+         */
+        T Read(MemoryAccessorBase<>& accessor)const
+        {
+            T ret;
+            Read(accessor, ret);
+            return ret;
+        }
+
+        /**
+         * @brief 只读取对象的一个成员
+         * @tparam F 成员类型
+         * @tparam U 对象类型（即T）
+         * @param accessor 内存访问器
+         * @param field 成员指针
+         * @return 成员的值
+         *
+         * 只读取成员所在的字节，避免为一个字段复制整个结构体（如 global_State）。
+         */
+        template <typename F, typename U>
+        F ReadField(MemoryAccessorBase<>& accessor, F U::* field)const
+        {
+            F ret;
+            GetField(field).Read(accessor, ret);
+            return ret;
         }
 
+        /**
+         * @brief 只读取数组成员中的一个元素
+         * @tparam E 元素类型
+         * @tparam N 数组长度
+         * @tparam U 对象类型（即T）
+         * @param accessor 内存访问器
+         * @param field 成员指针
+         * @param index 下标
+         * @return 元素的值
+         */
+        template <typename E, size_t N, typename U>
+        E ReadField(MemoryAccessorBase<>& accessor, E (U::* field)[N], size_t index)const
+        {
+            if (index >= N)
+                MOE_THROW(moe::OutOfRangeException, "Index {0} out of range {1}", index, N);
+
+            RemotePtr<E> element { reinterpret_cast<E*>(GetFieldAddress(field)) };
+            element.pointer += index;
+            return element.Read(accessor);
+        }
+
+        /**
+         * @brief 获取成员的远端地址
+         * @tparam F 成员类型
+         * @tparam U 对象类型（即T）
+         * @param field 成员指针
+         */
+        template <typename F, typename U>
+        RemotePtr<F> GetField(F U::* field)const
+        {
+            return RemotePtr<F> { reinterpret_cast<F*>(GetFieldAddress(field)) };
+        }
+
+    private:
+        template <typename F, typename U>
+        uintptr_t GetFieldAddress(F U::* field)const
+        {
+            // 以 U 推导，避免 T 不是类时成员声明本身非法
+            static_assert(std::is_same<T, U>::value, "Field must be a member of T");
+            if (!pointer)
+                MOE_THROW(moe::InvalidCallException, "Object pointer is null");
+
+            // 在本地的未初始化存储上计算偏移，不访问任何对象
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+            auto base = reinterpret_cast<const char*>(&storage);
+            auto offset = reinterpret_cast<const char*>(&(reinterpret_cast<const T*>(base)->*field)) - base;
+            return reinterpret_cast<uintptr_t>(pointer) + static_cast<uintptr_t>(offset);
+        }
+
+    public:
         template <typename P>
         RemotePtr<P> CastTo()const
         {
@@ -126,6 +269,89 @@ namespace lperf
         }
     };
 
+    /**
+     * @brief 读取计划
+     *
+     * 收集彼此独立的读取（一“波”），在 Flush 时通过 MemoryAccessorBase::ReadBatch 一次发出。
+     * 有依赖关系的读取（如沿链表前进）放在下一波中，这样遍历时每一层只需要一次往返。
+     */
+    class ReadPlanner
+    {
+    public:
+        ReadPlanner(MemoryAccessorBase<>& accessor)
+            : m_pAccessor(accessor) {}
+
+    public:
+        /**
+         * @brief 加入一个读取
+         * @param ptr 远端对象
+         * @param[out] out 输出，在 Flush 之前必须保持有效
+         */
+        template <typename T>
+        void Add(RemotePtr<T> ptr, T& out)
+        {
+            if (!ptr)
+                MOE_THROW(moe::InvalidCallException, "Object pointer is null");
+
+            MemoryReadRequest request;
+            request.Address = reinterpret_cast<uintptr_t>(ptr.pointer);
+            request.Output = &out;
+            request.Size = sizeof(T);
+            m_stPending.push_back(request);
+        }
+
+        /**
+         * @brief 加入一个数组的读取
+         * @param[out] out 输出，立即调整为 count 个元素，在 Flush 之前不可再改变大小
+         * @param address 数组地址
+         * @param count 元素个数
+         */
+        template <typename T>
+        void AddArray(std::vector<T>& out, uintptr_t address, size_t count)
+        {
+            out.resize(count);
+            if (count == 0)
+                return;
+
+            MemoryReadRequest request;
+            request.Address = address;
+            request.Output = out.data();
+            request.Size = sizeof(T) * count;
+            m_stPending.push_back(request);
+        }
+
+        /**
+         * @brief 获取未发出的读取数量
+         */
+        size_t GetPendingCount()const noexcept { return m_stPending.size(); }
+
+        /**
+         * @brief 发出所有读取
+         *
+         * 无论成功与否，返回后计划被清空。
+         */
+        void Flush()
+        {
+            if (m_stPending.empty())
+                return;
+
+            try
+            {
+                m_pAccessor.ReadBatch(m_stPending);
+            }
+            catch (...)
+            {
+                m_stPending.clear();
+                throw;
+            }
+            m_stPending.clear();
+        }
+
+    private:
+        MemoryAccessorBase<>& m_pAccessor;
+        std::vector<MemoryReadRequest> m_stPending;
+    };
+
     namespace LuaObjects
     {
         enum TMS
@@ -479,12 +705,111 @@ namespace lperf
             short nresults;  /* expected number of results from this function */
             unsigned short callstatus;
 
-            bool IsLua() { return (callstatus & CIST_LUA) != 0; }
-            bool IsHooked() { return (callstatus & CIST_HOOKED) != 0; }
-            bool IsTailCall() { return (callstatus & CIST_TAIL) != 0; }
-            bool IsFinalizer() { return (callstatus & CIST_FIN) != 0 ; }
+            bool IsLua()const noexcept { return (callstatus & CIST_LUA) != 0; }
+            bool IsHooked()const noexcept { return (callstatus & CIST_HOOKED) != 0; }
+            bool IsTailCall()const noexcept { return (callstatus & CIST_TAIL) != 0; }
+            bool IsFinalizer()const noexcept { return (callstatus & CIST_FIN) != 0 ; }
+        };
+
+        enum OpCode
+        {
+            OP_MOVE,/*	A B	R(A) := R(B)					*/
+            OP_LOADK,/*	A Bx	R(A) := Kst(Bx)					*/
+            OP_LOADKX,/*	A 	R(A) := Kst(extra arg)				*/
+            OP_LOADBOOL,/*	A B C	R(A) := (Bool)B; if (C) pc++			*/
+            OP_LOADNIL,/*	A B	R(A), R(A+1), ..., R(A+B) := nil		*/
+            OP_GETUPVAL,/*	A B	R(A) := UpValue[B]				*/
+
+            OP_GETTABUP,/*	A B C	R(A) := UpValue[B][RK(C)]			*/
+            OP_GETTABLE,/*	A B C	R(A) := R(B)[RK(C)]				*/
+
+            OP_SETTABUP,/*	A B C	UpValue[A][RK(B)] := RK(C)			*/
+            OP_SETUPVAL,/*	A B	UpValue[B] := R(A)				*/
+            OP_SETTABLE,/*	A B C	R(A)[RK(B)] := RK(C)				*/
+
+            OP_NEWTABLE,/*	A B C	R(A) := {} (size = B,C)				*/
+
+            OP_SELF,/*	A B C	R(A+1) := R(B); R(A) := R(B)[RK(C)]		*/
+
+            OP_ADD,/*	A B C	R(A) := RK(B) + RK(C)				*/
+            OP_SUB,/*	A B C	R(A) := RK(B) - RK(C)				*/
+            OP_MUL,/*	A B C	R(A) := RK(B) * RK(C)				*/
+            OP_MOD,/*	A B C	R(A) := RK(B) % RK(C)				*/
+            OP_POW,/*	A B C	R(A) := RK(B) ^ RK(C)				*/
+            OP_DIV,/*	A B C	R(A) := RK(B) / RK(C)				*/
+            OP_IDIV,/*	A B C	R(A) := RK(B) // RK(C)				*/
+            OP_BAND,/*	A B C	R(A) := RK(B) & RK(C)				*/
+            OP_BOR,/*	A B C	R(A) := RK(B) | RK(C)				*/
+            OP_BXOR,/*	A B C	R(A) := RK(B) ~ RK(C)				*/
+            OP_SHL,/*	A B C	R(A) := RK(B) << RK(C)				*/
+            OP_SHR,/*	A B C	R(A) := RK(B) >> RK(C)				*/
+            OP_UNM,/*	A B	R(A) := -R(B)					*/
+            OP_BNOT,/*	A B	R(A) := ~R(B)					*/
+            OP_NOT,/*	A B	R(A) := not R(B)				*/
+            OP_LEN,/*	A B	R(A) := length of R(B)				*/
+
+            OP_CONCAT,/*	A B C	R(A) := R(B).. ... ..R(C)			*/
+
+            OP_JMP,/*	A sBx	pc+=sBx; if (A) close all upvalues >= R(A - 1)	*/
+            OP_EQ,/*	A B C	if ((RK(B) == RK(C)) ~= A) then pc++		*/
+            OP_LT,/*	A B C	if ((RK(B) <  RK(C)) ~= A) then pc++		*/
+            OP_LE,/*	A B C	if ((RK(B) <= RK(C)) ~= A) then pc++		*/
+
+            OP_TEST,/*	A C	if not (R(A) <=> C) then pc++			*/
+            OP_TESTSET,/*	A B C	if (R(B) <=> C) then R(A) := R(B) else pc++	*/
+
+            OP_CALL,/*	A B C	R(A), ... ,R(A+C-2) := R(A)(R(A+1), ... ,R(A+B-1)) */
+            OP_TAILCALL,/*	A B C	return R(A)(R(A+1), ... ,R(A+B-1))		*/
+            OP_RETURN,/*	A B	return R(A), ... ,R(A+B-2)	(see note)	*/
+
+            OP_FORLOOP,/*	A sBx	R(A)+=R(A+2);
+                            if R(A) <?= R(A+1) then { pc+=sBx; R(A+3)=R(A) }*/
+            OP_FORPREP,/*	A sBx	R(A)-=R(A+2); pc+=sBx				*/
+
+            OP_TFORCALL,/*	A C	R(A+3), ... ,R(A+2+C) := R(A)(R(A+1), R(A+2));	*/
+            OP_TFORLOOP,/*	A sBx	if R(A+1) ~= nil then { R(A)=R(A+1); pc += sBx }*/
+
+            OP_SETLIST,/*	A B C	R(A)[(C-1)*FPF+i] := R(A+i), 1 <= i <= B	*/
+
+            OP_CLOSURE,/*	A Bx	R(A) := closure(KPROTO[Bx])			*/
+
+            OP_VARARG,/*	A B	R(A), R(A+1), ..., R(A+B-2) = vararg		*/
+
+            OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
         };
 
+        static const unsigned NUM_OPCODES = static_cast<unsigned>(OP_EXTRAARG) + 1;
+
+        /**
+         * @brief 获取指令的操作码
+         * @param i 指令
+         * @return 操作码
+         */
+        OpCode GetOpCode(Instruction i)noexcept;
+
+        /**
+         * @brief 获取操作码名称
+         * @param op 操作码
+         * @return 名称，如"GETTABLE"
+         */
+        const char* GetOpCodeName(OpCode op)noexcept;
+
+        /**
+         * @brief 反汇编指令
+         * @param i 指令
+         * @param pc 指令的相对位置（用于计算跳转目标）
+         * @return 操作码及操作数，格式同 luac -l
+         */
+        std::string FormatInstruction(Instruction i, int pc);
+
+        /**
+         * @brief 通过向后跳转分析找出函数中的循环
+         * @param code 指令
+         * @param lineInfo 行号表（可为空）
+         * @return 循环，按StartPc升序，起点相同时范围大的在前
+         */
+        std::vector<LoopInfo> FindLoops(const std::vector<Instruction>& code, const std::vector<int>& lineInfo);
+
         static const unsigned LUA_IDSIZE = 60;
 
         struct lua_Debug
@@ -503,10 +828,26 @@ namespace lperf
             bool istailcall;	/* (t) */
             char short_src[LUA_IDSIZE]; /* (S) */
             uintptr_t address;
+            uintptr_t proto;  /* (S) address of Proto for Lua functions */
+            int currentpc;  /* (l) */
             /* private part */
             RemotePtr<CallInfo> i_ci;  /* active function */
         };
 
+        /**
+         * @brief 复制的调用帧
+         *
+         * 只包含调用帧中随执行变化的部分，以便在目标进程暂停期间快速复制；
+         * Proto、常量、字符串等创建后不再改变的数据留到解析时再读取。
+         */
+        struct RawCallFrame
+        {
+            RemotePtr<CallInfo> Address;
+            CallInfo Info;
+            lua_TValue Func;
+            Closure FuncClosure;  // 仅当 Func 为闭包时有效
+        };
+
         struct lua_State
         {
             RemotePtr<GCObject> next;
@@ -538,23 +879,47 @@ namespace lperf
 
             /**
              * @brief 获取栈的调用信息
+             * @param accessor 内存访问器
              * @param address lua_State的远端地址
              * @param level 栈层级
              * @return 调试信息
              *
              * 见 lua_getstack。
              */
-            lua_Debug GetStack(uintptr_t address, int level);
+            lua_Debug GetStack(MemoryAccessorBase<>& accessor, uintptr_t address, int level);
 
             /**
              * @brief 获取活动记录下的信息
+             * @param accessor 内存访问器
              * @param what 需要的信息
              * @param ar 活动记录
              *
+             * @param cache Proto缓存
+             *
              * 见 lua_getinfo。
              * 注意：不支持'f'、'L'操作符，'>'操作符不会改变栈结构。
              */
-            void GetInfo(const char* what, lua_Debug& ar);
+            void GetInfo(MemoryAccessorBase<>& accessor, const char* what, lua_Debug& ar, ProtoCache& cache);
+
+            /**
+             * @brief 获取复制的调用帧的信息
+             * @param accessor 内存访问器，只用于读取不变的数据，目标进程无需暂停
+             * @param what 需要的信息（不支持'>'）
+             * @param frame 调用帧
+             * @param previous 调用者的帧，为nullptr时从远端读取
+             * @param ar 活动记录
+             * @param cache Proto缓存
+             */
+            void GetInfo(MemoryAccessorBase<>& accessor, const char* what, const RawCallFrame& frame,
+                const RawCallFrame* previous, lua_Debug& ar, ProtoCache& cache);
+
+            /**
+             * @brief 复制调用帧
+             * @param accessor 内存访问器
+             * @param ci 调用信息的远端地址
+             * @param[out] out 输出
+             */
+            static void CaptureFrame(MemoryAccessorBase<>& accessor, RemotePtr<CallInfo> ci, RawCallFrame& out);
         };
 
         union GCUnion
@@ -568,4 +933,240 @@ namespace lperf
             lua_State th;  /* thread */
         };
     }
+
+    /**
+     * @brief 循环类型
+     */
+    enum class LuaLoopType
+    {
+        NumericFor,  // for i = ...（OP_FORLOOP）
+        GenericFor,  // for k, v in ...（OP_TFORLOOP）
+        Jump,  // while、repeat 或 goto（向后的OP_JMP）
+    };
+
+    /**
+     * @brief 循环信息
+     */
+    struct LoopInfo
+    {
+        LuaLoopType Type = LuaLoopType::Jump;
+        int StartPc = 0;  // 循环体的第一条指令
+        int EndPc = 0;  // 跳回循环开始的指令（包含）
+        int StartLine = -1;
+        int EndLine = -1;
+
+        bool Contains(int pc)const noexcept { return StartPc <= pc && pc <= EndPc; }
+    };
+
+    /**
+     * @brief Proto的调试信息
+     */
+    struct ProtoInfo
+    {
+        LuaObjects::Proto Header;
+        std::string Source;
+        std::vector<int> LineInfo;
+        std::vector<LuaObjects::Instruction> Code;
+        std::vector<LoopInfo> Loops;  // 按StartPc升序，外层循环在前
+
+        /**
+         * @brief 获取指令对应的行号
+         * @param pc 相对指令位置
+         * @return 行号，无调试信息时返回-1
+         */
+        int GetLine(int pc)const noexcept
+        {
+            if (pc < 0 || static_cast<size_t>(pc) >= LineInfo.size())
+                return -1;
+            return LineInfo[pc];
+        }
+
+        /**
+         * @brief 获取指令
+         * @param pc 相对指令位置
+         * @return 指令，越界时返回0
+         */
+        LuaObjects::Instruction GetInstruction(int pc)const noexcept
+        {
+            if (pc < 0 || static_cast<size_t>(pc) >= Code.size())
+                return 0;
+            return Code[pc];
+        }
+
+        /**
+         * @brief 获取包含指令的最内层循环
+         * @param pc 相对指令位置
+         * @return 循环在Loops中的下标，不在循环中时返回-1
+         */
+        int GetInnermostLoop(int pc)const noexcept
+        {
+            int ret = -1;
+            for (size_t i = 0; i < Loops.size(); ++i)
+            {
+                if (Loops[i].StartPc > pc)
+                    break;
+                if (Loops[i].Contains(pc))
+                    ret = static_cast<int>(i);
+            }
+            return ret;
+        }
+    };
+
+    /**
+     * @brief 短字符串缓存
+     *
+     * 短字符串被驻留且在其生命周期内不可变，同一个 source 与字段名会在采样中被反复读取。
+     * 按 TString 地址缓存解码后的内容，命中时只读取头部，以类型、哈希与长度校验地址未被复用后直接返回。
+     * 长字符串的哈希是惰性计算的，无法廉价地校验，因此不缓存。
+     *
+     * 按最近使用淘汰，占用的内存不超过容量。线程安全。
+     */
+    class StringCache
+    {
+    public:
+        static const size_t DEFAULT_CAPACITY = 4 * 1024 * 1024;
+
+    public:
+        /**
+         * @brief 获取字符串
+         * @param accessor 内存访问器
+         * @param str TString的远端地址
+         * @return 解码后的字符串
+         */
+        std::string Get(MemoryAccessorBase<>& accessor, RemotePtr<LuaObjects::TString> str);
+
+        /**
+         * @brief 获取容量（字节）
+         */
+        size_t GetCapacity()const noexcept
+        {
+            std::lock_guard<std::mutex> guard(m_stLock);
+            return m_uCapacity;
+        }
+
+        /**
+         * @brief 设置容量（字节）
+         * @param capacity 容量，0表示不缓存
+         *
+         * 超出新容量的条目立即被淘汰。
+         */
+        void SetCapacity(size_t capacity)noexcept
+        {
+            std::lock_guard<std::mutex> guard(m_stLock);
+            m_uCapacity = capacity;
+            Shrink();
+        }
+
+        /**
+         * @brief 获取缓存的字符串数量
+         */
+        size_t GetSize()const noexcept
+        {
+            std::lock_guard<std::mutex> guard(m_stLock);
+            return m_stIndex.size();
+        }
+
+        /**
+         * @brief 清空缓存
+         */
+        void Clear()noexcept
+        {
+            std::lock_guard<std::mutex> guard(m_stLock);
+            m_stIndex.clear();
+            m_stEntries.clear();
+            m_uUsage = 0;
+        }
+
+    private:
+        struct Entry
+        {
+            uintptr_t Address = 0;
+            size_t Length = 0;  // shrlen
+            unsigned Hash = 0;
+            std::string Value;
+        };
+
+        static size_t GetEntrySize(const Entry& entry)noexcept
+        {
+            // 粗略计入链表与索引节点的开销
+            return sizeof(Entry) + entry.Value.capacity() + 4 * sizeof(void*);
+        }
+
+        void Shrink()noexcept
+        {
+            while (m_uUsage > m_uCapacity && !m_stEntries.empty())
+            {
+                auto& last = m_stEntries.back();
+                m_uUsage -= GetEntrySize(last);
+                m_stIndex.erase(last.Address);
+                m_stEntries.pop_back();
+            }
+        }
+
+    private:
+        mutable std::mutex m_stLock;
+        size_t m_uCapacity = DEFAULT_CAPACITY;
+        size_t m_uUsage = 0;
+        std::list<Entry> m_stEntries;  // 最近使用的在前
+        std::unordered_map<uintptr_t, std::list<Entry>::iterator> m_stIndex;
+    };
+
+    /**
+     * @brief Proto缓存
+     *
+     * Proto在其生命周期内不可变，因此按地址缓存其调试信息和指令，预热后采样时不再需要读取Proto、行号表及指令。
+     * 注意：假定采样期间Proto的地址不会被回收复用。
+     *
+     * 可被一个线程填充的同时被其他线程查询；条目只增不减，返回的引用在清空前一直有效。
+     */
+    class ProtoCache
+    {
+    public:
+        /**
+         * @brief 获取Proto信息
+         * @param accessor 内存访问器
+         * @param proto Proto的远端地址
+         * @return 缓存的信息，未命中时从远端读取
+         */
+        const ProtoInfo& Get(MemoryAccessorBase<>& accessor, RemotePtr<LuaObjects::Proto> proto);
+
+        /**
+         * @brief 查找已缓存的Proto信息
+         * @param address Proto的远端地址
+         * @return 若未缓存则返回nullptr
+         */
+        const ProtoInfo* Find(uintptr_t address)const noexcept;
+
+        /**
+         * @brief 获取缓存的Proto数量
+         */
+        size_t GetSize()const noexcept
+        {
+            std::lock_guard<std::mutex> guard(m_stLock);
+            return m_stCache.size();
+        }
+
+        /**
+         * @brief 获取解析时使用的字符串缓存
+         */
+        StringCache& GetStringCache()noexcept { return m_stStrings; }
+        const StringCache& GetStringCache()const noexcept { return m_stStrings; }
+
+        /**
+         * @brief 清空缓存
+         */
+        void Clear()noexcept
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_stLock);
+                m_stCache.clear();
+            }
+            m_stStrings.Clear();
+        }
+
+    private:
+        mutable std::mutex m_stLock;
+        std::unordered_map<uintptr_t, ProtoInfo> m_stCache;
+        StringCache m_stStrings;
+    };
 }
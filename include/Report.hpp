@@ -0,0 +1,450 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <map>
+#include <chrono>
+#include <iosfwd>
+
+#include "Timeline.hpp"
+#include "FlameGraph.hpp"
+#include "HeavyHitters.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 采样的附加信息
+     */
+    struct SampleInfo
+    {
+        uint64_t Time = 0;  // 采样时刻（单调时钟，纳秒）
+        uint64_t Thread = 0;  // 被采样的 lua_State 地址
+    };
+
+    /**
+     * @brief 报告基类
+     *
+     * 报告逐次接收采样到的堆栈并进行聚合，在采样结束后输出结果。
+     */
+    class ReportBase
+    {
+    public:
+        virtual ~ReportBase() = default;
+
+    public:
+        /**
+         * @brief 记录一次采样
+         * @param stack 堆栈（栈顶在前）
+         * @param info 采样信息
+         */
+        virtual void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info) = 0;
+
+        /**
+         * @brief 输出报告
+         * @param out 输出流
+         */
+        virtual void Write(std::ostream& out) = 0;
+
+        /**
+         * @brief 是否支持增量输出
+         */
+        virtual bool IsIncremental()const noexcept { return false; }
+
+        /**
+         * @brief 输出自上次调用以来的增量
+         * @param out 输出流
+         *
+         * 仅当 IsIncremental 返回true时可用。
+         */
+        virtual void WriteDelta(std::ostream& out) { (void)out; }
+    };
+
+    using ReportPtr = std::unique_ptr<ReportBase>;
+
+    /**
+     * @brief 报告选项
+     */
+    struct ReportOptions
+    {
+        bool LineMode = false;  // 折叠堆栈是否使用当前执行的行
+        unsigned TopCount = 10;  // 详细报告中列出的函数数量
+        uint32_t SampleInterval = 0;  // 采样间隔（毫秒）
+        std::vector<MemoryMapping> Mappings;  // 目标进程中可执行的内存映射
+        std::vector<std::pair<std::string, std::string>> Labels;  // 采样来源的标签（主机名、命令行等）
+        size_t MemoryCap = 0;  // 限定内存的聚合中堆栈表的内存上限（字节）
+    };
+
+    /**
+     * @brief 折叠堆栈报告
+     *
+     * 输出可直接用于 flamegraph.pl 的折叠堆栈格式。
+     * 基于 Profile 聚合，增量输出只格式化发生变化的堆栈。
+     */
+    class FoldedReport :
+        public ReportBase
+    {
+    public:
+        /**
+         * @brief 构造折叠堆栈报告
+         * @param lineMode 是否将LUA帧归属到当前执行的行（否则为函数定义行）
+         * @param opCodeCache 若非nullptr，则以栈顶LUA帧当前指令的操作码作为叶子帧
+         */
+        FoldedReport(bool lineMode=false, const ProtoCache* opCodeCache=nullptr);
+
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+        bool IsIncremental()const noexcept override { return true; }
+        void WriteDelta(std::ostream& out)override;
+
+    private:
+        const std::string& FormatStack(ProfileId stack);
+
+    private:
+        const ProtoCache* m_pOpCodeCache = nullptr;
+        Profile m_stProfile;
+        std::vector<std::string> m_stFrameTexts;
+        std::vector<ProfileId> m_stFrameBuffer;
+        std::string m_stFormatBuffer;
+    };
+
+    /**
+     * @brief 热点行报告
+     *
+     * 按 (函数, 当前行) 聚合，并以源文件为单位列出热点行。
+     * 自身计数只在栈顶为LUA帧时计入该行，栈顶为本地函数（如在C函数中的耗时）时计入 [native]，
+     * 总计数对同一次采样中重复出现的行只计一次。
+     */
+    class LineReport :
+        public ReportBase
+    {
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+
+    private:
+        struct LineKey
+        {
+            std::string Source;
+            unsigned LineDefined;
+            unsigned CurrentLine;
+
+            bool operator<(const LineKey& rhs)const noexcept
+            {
+                if (Source != rhs.Source)
+                    return Source < rhs.Source;
+                if (CurrentLine != rhs.CurrentLine)
+                    return CurrentLine < rhs.CurrentLine;
+                return LineDefined < rhs.LineDefined;
+            }
+        };
+
+        struct LineCounter
+        {
+            std::string Name;
+            size_t Self = 0;
+            size_t Total = 0;
+            size_t LastSample = 0;
+        };
+
+        size_t m_uSampleCount = 0;
+        size_t m_uNativeSelf = 0;
+        std::map<LineKey, LineCounter> m_stLineCounter;
+    };
+
+    /**
+     * @brief 字节码报告
+     *
+     * 统计栈顶LUA函数中各条指令被采样到的次数，对最热的函数输出带采样比例和源码行号的反汇编。
+     */
+    class BytecodeReport :
+        public ReportBase
+    {
+    public:
+        BytecodeReport(const ProtoCache& cache, unsigned topCount);
+
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+
+    private:
+        struct ProtoCounter
+        {
+            std::string Name;
+            size_t Total = 0;
+            std::vector<size_t> PcCounter;
+        };
+
+        const ProtoCache& m_pProtoCache;
+        unsigned m_uTopCount = 0;
+        size_t m_uSampleCount = 0;
+        size_t m_uInvalidPcCount = 0;
+        std::unordered_map<uintptr_t, ProtoCounter> m_stProtoCounter;
+    };
+
+    /**
+     * @brief 操作码分布报告
+     *
+     * 按栈顶LUA帧当前执行指令的操作码聚合，输出全局及各热点函数的操作码分布。
+     */
+    class OpCodeReport :
+        public ReportBase
+    {
+    public:
+        OpCodeReport(const ProtoCache& cache, unsigned topCount);
+
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+
+    private:
+        struct FunctionCounter
+        {
+            std::string Name;
+            size_t Total = 0;
+            size_t OpCodeCounter[LuaObjects::NUM_OPCODES] = {};
+        };
+
+        const ProtoCache& m_pProtoCache;
+        unsigned m_uTopCount = 0;
+        size_t m_uSampleCount = 0;
+        size_t m_uNativeCount = 0;
+        size_t m_stOpCodeCounter[LuaObjects::NUM_OPCODES] = {};
+        std::unordered_map<uintptr_t, FunctionCounter> m_stFunctionCounter;
+    };
+
+    /**
+     * @brief 循环热点报告
+     *
+     * 将采样归属到函数中的循环：自身计数取栈顶LUA帧所在的最内层循环，
+     * 总计数对堆栈上所有LUA帧所在的循环各计一次。
+     */
+    class LoopReport :
+        public ReportBase
+    {
+    public:
+        LoopReport(const ProtoCache& cache, unsigned topCount);
+
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+
+    private:
+        struct LoopCounter
+        {
+            std::string Name;
+            size_t Self = 0;
+            size_t Total = 0;
+            size_t LastSample = 0;
+        };
+
+        const ProtoCache& m_pProtoCache;
+        unsigned m_uTopCount = 0;
+        size_t m_uSampleCount = 0;
+        std::map<std::pair<uintptr_t, int>, LoopCounter> m_stLoopCounter;
+    };
+
+    /**
+     * @brief pprof 报告
+     *
+     * 以 pprof 的 protobuf 格式输出，可使用 go tool pprof 等工具进行分析。
+     * 输出为二进制数据，通常应配合 -o 写入文件。
+     */
+    class PProfReport :
+        public ReportBase
+    {
+    public:
+        PProfReport(const ReportOptions& options);
+
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+
+    private:
+        Profile m_stProfile;
+        std::chrono::steady_clock::time_point m_stStartTime;
+    };
+
+    /**
+     * @brief 时间线报告
+     *
+     * 保留每次采样的时刻与堆栈，输出为 speedscope 或 Chrome Trace Event 格式，
+     * 用于观察聚合报告中被平均掉的逐次变化（如偶发的长帧）。
+     */
+    class TimelineReport :
+        public ReportBase
+    {
+    public:
+        enum class Format
+        {
+            Speedscope,
+            ChromeTrace,
+        };
+
+    public:
+        TimelineReport(Format format, const ReportOptions& options);
+
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+
+    private:
+        Format m_iFormat;
+        Profile m_stProfile;
+        Timeline m_stTimeline;
+    };
+
+    /**
+     * @brief 火焰图报告
+     *
+     * 直接输出可交互的SVG/HTML火焰图，无需借助 flamegraph.pl。
+     */
+    class FlameGraphReport :
+        public ReportBase
+    {
+    public:
+        FlameGraphReport(const ReportOptions& options, bool html);
+
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+
+    private:
+        FlameGraphOptions m_stOptions;
+        Profile m_stProfile;
+    };
+
+    /**
+     * @brief callgrind 报告
+     *
+     * 总是按当前执行的行驻留LUA帧，以便输出逐行的开销。
+     */
+    class CallgrindReport :
+        public ReportBase
+    {
+    public:
+        CallgrindReport();
+
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+
+    private:
+        Profile m_stProfile;
+    };
+
+    /**
+     * @brief 二进制报告
+     *
+     * 输出包含时间线的二进制剖析文件（见 BinaryProfile），供 diff 等子命令直接映射读取。
+     */
+    class BinaryReport :
+        public ReportBase
+    {
+    public:
+        BinaryReport(const ReportOptions& options);
+
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+
+    private:
+        Profile m_stProfile;
+        Timeline m_stTimeline;
+        std::chrono::steady_clock::time_point m_stStartTime;
+    };
+
+    /**
+     * @brief 限定内存的折叠堆栈报告
+     *
+     * 用于长时间的连续采样，只精确保留最重的堆栈，其余归入按栈顶帧划分的 "(tail)" 分组，
+     * 输出的注释行给出误差上限（见 HeavyHitterProfile）。
+     */
+    class TopKReport :
+        public ReportBase
+    {
+    public:
+        TopKReport(const ReportOptions& options);
+
+    public:
+        void OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)override;
+        void Write(std::ostream& out)override;
+
+    private:
+        HeavyHitterProfile m_stProfile;
+    };
+
+    /**
+     * @brief 获取栈顶LUA帧当前执行的指令
+     * @param frame 栈帧
+     * @param cache Proto缓存
+     * @param[out] out 指令
+     * @return 若无法获取返回false
+     */
+    bool GetCurrentInstruction(const LuaStackFrame& frame, const ProtoCache& cache, LuaObjects::Instruction& out);
+
+    /**
+     * @brief 格式化栈帧
+     * @param frame 栈帧
+     * @param lineMode 是否使用当前执行的行
+     * @return 用于折叠堆栈的帧名称
+     */
+    std::string FormatStackFrame(const LuaStackFrame& frame, bool lineMode=false);
+
+    /**
+     * @brief 格式化驻留的栈帧
+     * @param profile 剖析数据
+     * @param frame 栈帧
+     * @return 用于折叠堆栈的帧名称
+     */
+    std::string FormatProfileFrame(const Profile& profile, const ProfileFrame& frame);
+
+    /**
+     * @brief 折叠堆栈中标签行的前缀，形如 "# label: key=value"
+     */
+    static const char* const FOLDED_LABEL_PREFIX = "# label: ";
+
+    /**
+     * @brief 转义标签的键或值
+     * @param text 文本
+     *
+     * 空白、控制字符、'%' 与 '=' 以 %XX 的形式输出。
+     * 未转义时以空白加数字结尾的值（如命令行中的端口）会被火焰图工具当作一行 "堆栈 计数"。
+     */
+    std::string EscapeFoldedLabel(const std::string& text);
+
+    /**
+     * @brief 还原 EscapeFoldedLabel 转义的文本
+     * @param text 文本
+     */
+    std::string UnescapeFoldedLabel(const std::string& text);
+
+    /**
+     * @brief 以折叠堆栈格式输出剖析数据
+     * @param profile 剖析数据
+     * @param out 输出流
+     *
+     * 标签以转义后的注释行输出在最前面，堆栈按文本排序，格式化后相同的堆栈合并计数。
+     */
+    void WriteFoldedProfile(const Profile& profile, std::ostream& out);
+
+    /**
+     * @brief 读取目标进程的内存映射与标签（主机名、pid、build-id、命令行）
+     * @param debugger 调试器
+     * @param[out] options 选项
+     *
+     * 读取失败时只输出警告。
+     */
+    void CollectProcessInfo(Debugger& debugger, ReportOptions& options);
+
+    /**
+     * @brief 根据名称创建报告
+     * @param name 报告名称（folded、lines、bytecode、opcodes、opcodes-folded、loops）
+     * @param options 选项
+     * @param cache 采样器的Proto缓存
+     * @return 报告对象
+     */
+    ReportPtr CreateReport(const std::string& name, const ReportOptions& options, const ProtoCache& cache);
+}
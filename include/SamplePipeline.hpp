@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <atomic>
+#include <thread>
+#include <functional>
+
+#include "LuaSampler.hpp"
+#include "Report.hpp"
+#include "SpscRing.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 流水线化的采样
+     *
+     * 采样分为三级，由有界的 SpscRing 连接：
+     *  - 捕获：在调用 Capture 的线程（即挂接的线程）中暂停目标进程，只复制调用链后立即恢复；
+     *  - 解析：在解析线程中通过 Proto 缓存与调试符号把复制的调用链解析为堆栈；
+     *  - 聚合：在聚合线程中把堆栈交给回调（报告、输出）。
+     *
+     * 捕获从不等待后两级：解析跟不上时队列被填满，新的采样直接丢弃而不暂停目标进程，
+     * 因此大量缓存未命中或输出缓慢都不会影响采样的时机与暂停时长。
+     */
+    class SamplePipeline
+    {
+    public:
+        static const size_t DEFAULT_QUEUE_SIZE = 256;
+
+        /**
+         * @brief 采样回调，总在聚合线程中调用
+         * @param stack 堆栈（栈顶在前）
+         * @param info 采样信息
+         */
+        using SampleCallback = std::function<void(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)>;
+
+    public:
+        /**
+         * @brief 构造流水线并启动解析、聚合线程
+         * @param sampler 采样器，解析线程独占其 Proto 缓存
+         * @param onSample 采样回调
+         * @param queueSize 每级队列的容量
+         */
+        SamplePipeline(LuaSampler& sampler, const SampleCallback& onSample, size_t queueSize=DEFAULT_QUEUE_SIZE);
+        ~SamplePipeline();
+
+        SamplePipeline(const SamplePipeline&) = delete;
+        SamplePipeline& operator=(const SamplePipeline&) = delete;
+
+    public:
+        /**
+         * @brief 捕获一次堆栈
+         * @param address lua_State的地址
+         * @param info 采样信息
+         * @return 队列已满而丢弃时返回false
+         *
+         * 必须在挂接的线程中调用，捕获失败时抛出异常。
+         */
+        bool Capture(uintptr_t address, const SampleInfo& info);
+
+        /**
+         * @brief 处理完已捕获的采样后停止线程
+         *
+         * 返回后回调不再被调用。可重复调用。
+         */
+        void Stop();
+
+        /**
+         * @brief 获取因队列已满而丢弃的采样数
+         */
+        uint64_t GetDroppedCount()const noexcept { return m_uDroppedCount; }
+
+    private:
+        struct RawSample
+        {
+            LuaRawStack Stack;
+            SampleInfo Info;
+        };
+
+        struct SymbolizedSample
+        {
+            std::vector<LuaStackFrame> Stack;
+            SampleInfo Info;
+        };
+
+        void RunSymbolizer();
+        void RunAggregator();
+
+    private:
+        LuaSampler& m_pSampler;
+        SampleCallback m_stOnSample;
+
+        SpscRing<RawSample> m_stRawQueue;
+        SpscRing<SymbolizedSample> m_stSymbolizedQueue;
+        std::atomic<bool> m_bCaptureFinished { false };
+        std::atomic<bool> m_bSymbolizeFinished { false };
+        uint64_t m_uDroppedCount = 0;
+
+        std::thread m_stSymbolizer;
+        std::thread m_stAggregator;
+    };
+}
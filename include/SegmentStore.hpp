@@ -0,0 +1,82 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include "Profile.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 剖析分段
+     */
+    struct SegmentInfo
+    {
+        uint64_t StartTime = 0;  // 起始时间（UNIX时间，纳秒）
+        uint64_t EndTime = 0;  // 结束时间（UNIX时间，纳秒）
+        uint64_t SampleCount = 0;
+        uint64_t Size = 0;  // 文件大小（字节）
+        std::string File;  // 文件名（相对于目录）
+    };
+
+    /**
+     * @brief 持续采样的分段存储
+     *
+     * 每个分段为一个 GZIP 压缩的二进制剖析文件，可直接被 report、diff、merge 读取。
+     * 目录下的 index 文件按时间顺序逐行记录分段（"起始 结束 采样数 大小 文件名"），用于按时间范围查找分段。
+     * 分段的总大小超过预算时，从最旧的分段开始删除，构成一个环。
+     */
+    class SegmentStore
+    {
+    public:
+        static const char* const INDEX_FILE_NAME;
+
+    public:
+        /**
+         * @brief 打开存储
+         * @param dir 目录，不存在时创建
+         * @param budget 磁盘预算（字节），0表示不限
+         * @param readOnly 只读打开时不创建目录，也不修改索引（可与写入的进程同时使用）
+         *
+         * 索引中记录但已不存在的分段被忽略。
+         */
+        SegmentStore(const std::string& dir, uint64_t budget, bool readOnly=false);
+
+    public:
+        /**
+         * @brief 写入一个分段
+         * @param profile 剖析数据，应已设置起始时间与时长
+         */
+        void Write(const Profile& profile);
+
+        /**
+         * @brief 查找与时间范围重叠的分段
+         * @param from 起始时间（UNIX时间，纳秒）
+         * @param to 结束时间（UNIX时间，纳秒）
+         * @return 分段（按时间顺序）
+         */
+        std::vector<SegmentInfo> Query(uint64_t from, uint64_t to)const;
+
+        /**
+         * @brief 获取分段的完整路径
+         */
+        std::string GetPath(const SegmentInfo& segment)const;
+
+        const std::vector<SegmentInfo>& GetSegments()const noexcept { return m_stSegments; }
+        uint64_t GetTotalSize()const noexcept { return m_uTotalSize; }
+
+    private:
+        void LoadIndex();
+        void SaveIndex()const;
+        void EnforceBudget();
+
+    private:
+        std::string m_stDir;
+        uint64_t m_uBudget = 0;
+        bool m_bReadOnly = false;
+
+        std::vector<SegmentInfo> m_stSegments;
+        uint64_t m_uTotalSize = 0;
+    };
+}
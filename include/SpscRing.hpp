@@ -0,0 +1,98 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace lperf
+{
+    /**
+     * @brief 有界的单生产者单消费者环形队列
+     * @tparam T 元素类型
+     *
+     * 无锁实现。槽位预先构造并被反复使用：生产者直接在槽位中写入，消费者直接在槽位中读取，
+     * 元素内的容器因此可以保留容量，稳定运行时不再分配内存。
+     */
+    template <typename T>
+    class SpscRing
+    {
+    public:
+        /**
+         * @brief 构造队列
+         * @param capacity 容量，向上取整到2的幂
+         */
+        explicit SpscRing(size_t capacity)
+        {
+            size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+            m_stSlots.resize(size);
+            m_uMask = size - 1;
+        }
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+    public:
+        /**
+         * @brief 获取容量
+         */
+        size_t GetCapacity()const noexcept { return m_stSlots.size(); }
+
+        /**
+         * @brief 获取可写入的槽位（生产者调用）
+         * @return 队列已满时返回nullptr
+         *
+         * 写入完成后调用 EndPush 提交；不提交则槽位在下次调用时被再次返回。
+         */
+        T* BeginPush()noexcept
+        {
+            auto tail = m_uTail.load(std::memory_order_relaxed);
+            if (tail - m_uHead.load(std::memory_order_acquire) > m_uMask)
+                return nullptr;
+            return &m_stSlots[tail & m_uMask];
+        }
+
+        /**
+         * @brief 提交 BeginPush 返回的槽位（生产者调用）
+         */
+        void EndPush()noexcept
+        {
+            m_uTail.store(m_uTail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief 获取可读取的槽位（消费者调用）
+         * @return 队列为空时返回nullptr
+         *
+         * 读取完成后调用 EndPop 归还槽位。
+         */
+        T* BeginPop()noexcept
+        {
+            auto head = m_uHead.load(std::memory_order_relaxed);
+            if (head == m_uTail.load(std::memory_order_acquire))
+                return nullptr;
+            return &m_stSlots[head & m_uMask];
+        }
+
+        /**
+         * @brief 归还 BeginPop 返回的槽位（消费者调用）
+         */
+        void EndPop()noexcept
+        {
+            m_uHead.store(m_uHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+    private:
+        std::vector<T> m_stSlots;
+        size_t m_uMask = 0;
+
+        // 读写位置分处不同的缓存行，避免生产者与消费者之间的伪共享
+        alignas(64) std::atomic<size_t> m_uHead { 0 };
+        alignas(64) std::atomic<size_t> m_uTail { 0 };
+    };
+}
@@ -0,0 +1,142 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <iosfwd>
+
+#include "Profile.hpp"
+
+namespace lperf
+{
+    /**
+     * @brief 时间线上的一次采样
+     */
+    struct TimelineSample
+    {
+        uint64_t Time = 0;  // 采样时刻（纳秒）
+        uint32_t Thread = 0;  // 线程序号，见 Timeline::GetThreads
+        ProfileId Stack = INVALID_PROFILE_ID;  // 栈顶对应的堆栈ID，空栈为 INVALID_PROFILE_ID
+    };
+
+    /**
+     * @brief 采样时间线
+     *
+     * 按顺序记录每次采样的时刻、线程及驻留的堆栈ID。
+     * 采样以 (时间增量, 线程序号, 堆栈ID+1) 的变长整数紧凑编码，通常每个采样只占用数个字节。
+     */
+    class Timeline
+    {
+    public:
+        /**
+         * @brief 顺序读取采样
+         */
+        class Reader
+        {
+        public:
+            Reader(const Timeline& timeline)
+                : m_pData(timeline.m_stBuffer.data()), m_uSize(timeline.m_stBuffer.size()) {}
+
+            /**
+             * @brief 从编码后的数据读取
+             * @param data 数据
+             * @param size 字节数
+             */
+            Reader(const uint8_t* data, size_t size)
+                : m_pData(data), m_uSize(size) {}
+
+        public:
+            /**
+             * @brief 读取下一个采样
+             * @param[out] out 采样
+             * @return 没有更多采样时返回false
+             */
+            bool Next(TimelineSample& out)noexcept;
+
+            /**
+             * @brief 是否因数据截断或数值越界而提前结束
+             */
+            bool IsCorrupted()const noexcept { return m_bCorrupted; }
+
+        private:
+            const uint8_t* m_pData = nullptr;
+            size_t m_uSize = 0;
+            size_t m_uOffset = 0;
+            uint64_t m_uTime = 0;
+            bool m_bCorrupted = false;
+        };
+
+    public:
+        /**
+         * @brief 追加一次采样
+         * @param time 采样时刻（纳秒），应当单调递增
+         * @param thread 线程标识
+         * @param stack 堆栈ID
+         */
+        void Append(uint64_t time, uint64_t thread, ProfileId stack);
+
+        /**
+         * @brief 以编码后的数据替换时间线
+         * @param data 数据（见 GetData）
+         * @param size 字节数
+         * @param threads 线程标识（见 GetThreads）
+         */
+        void Assign(const uint8_t* data, size_t size, const std::vector<uint64_t>& threads);
+
+        /**
+         * @brief 获取编码后的数据
+         */
+        const std::vector<uint8_t>& GetData()const noexcept { return m_stBuffer; }
+
+        /**
+         * @brief 获取采样数量
+         */
+        size_t GetSampleCount()const noexcept { return m_uSampleCount; }
+
+        /**
+         * @brief 获取编码后占用的字节数
+         */
+        size_t GetByteSize()const noexcept { return m_stBuffer.size(); }
+
+        /**
+         * @brief 获取第一个和最后一个采样的时刻
+         */
+        uint64_t GetStartTime()const noexcept { return m_uStartTime; }
+        uint64_t GetEndTime()const noexcept { return m_uLastTime; }
+
+        /**
+         * @brief 获取出现过的线程标识，下标即线程序号
+         */
+        const std::vector<uint64_t>& GetThreads()const noexcept { return m_stThreads; }
+
+    private:
+        std::vector<uint8_t> m_stBuffer;
+        size_t m_uSampleCount = 0;
+        uint64_t m_uStartTime = 0;
+        uint64_t m_uLastTime = 0;
+        std::vector<uint64_t> m_stThreads;
+        std::unordered_map<uint64_t, uint32_t> m_stThreadIndex;
+    };
+
+    /**
+     * @brief 以 speedscope 格式输出时间线
+     * @param profile 剖析数据
+     * @param timeline 时间线
+     * @param out 输出流
+     *
+     * 每个线程输出为一个 sampled 类型的 profile，样本的权重为到下一个样本的时间间隔。
+     * @see https://github.com/jlfwong/speedscope/wiki/Importing-from-custom-sources
+     */
+    void WriteSpeedscope(const Profile& profile, const Timeline& timeline, std::ostream& out);
+
+    /**
+     * @brief 以 Chrome Trace Event 格式输出时间线
+     * @param profile 剖析数据
+     * @param timeline 时间线
+     * @param out 输出流
+     *
+     * 比较相邻样本的堆栈，为新进入和退出的帧生成 B/E 事件，可在 chrome://tracing 或 Perfetto 中查看。
+     */
+    void WriteChromeTrace(const Profile& profile, const Timeline& timeline, std::ostream& out);
+}
@@ -0,0 +1,421 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "BinaryProfile.hpp"
+#include "GzipStream.hpp"
+
+#include <ostream>
+#include <fstream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+// 文件格式规定为小端序，写入与映射读取均直接使用主机字节序的结构体
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Binary profile requires a little-endian host");
+
+namespace
+{
+    uint64_t AlignUp(uint64_t value)noexcept
+    {
+        return (value + 7) & ~static_cast<uint64_t>(7);
+    }
+
+    void WritePadding(std::ostream& out, uint64_t size)
+    {
+        static const char PADDING[8] = {};
+        auto padding = AlignUp(size) - size;
+        if (padding > 0)
+            out.write(PADDING, padding);
+    }
+
+    template <typename T>
+    void WriteArray(std::ostream& out, const std::vector<T>& data)
+    {
+        if (!data.empty())
+            out.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(T));
+        WritePadding(out, data.size() * sizeof(T));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////// BinaryProfileFormat
+
+BinaryProfileFormat::Layout BinaryProfileFormat::ComputeLayout(const Header& header)noexcept
+{
+    Layout ret;
+    ret.StringOffsets = sizeof(Header);
+    ret.StringData = ret.StringOffsets + (header.StringCount + 1) * sizeof(uint64_t);
+    ret.Frames = ret.StringData + AlignUp(header.StringDataSize);
+    ret.StackParents = ret.Frames + header.FrameCount * sizeof(Frame);
+    ret.StackFrames = ret.StackParents + AlignUp(header.StackCount * sizeof(uint32_t));
+    ret.SampleCounts = ret.StackFrames + AlignUp(header.StackCount * sizeof(uint32_t));
+    ret.Mappings = ret.SampleCounts + header.StackCount * sizeof(uint64_t);
+    ret.Labels = ret.Mappings + header.MappingCount * sizeof(Mapping);
+    ret.Threads = ret.Labels + header.LabelCount * 2 * sizeof(uint32_t);
+    ret.Timeline = ret.Threads + header.ThreadCount * sizeof(uint64_t);
+    ret.End = ret.Timeline + AlignUp(header.TimelineSize);
+    return ret;
+}
+
+//////////////////////////////////////////////////////////////////////////////// Writer
+
+void lperf::WriteBinaryProfile(const Profile& profile, const Timeline* timeline, std::ostream& out)
+{
+    using namespace BinaryProfileFormat;
+
+    // 字符串表
+    vector<uint64_t> stringOffsets;
+    stringOffsets.reserve(profile.GetStringCount() + 1);
+    uint64_t stringDataSize = 0;
+    for (ProfileId i = 0; i < profile.GetStringCount(); ++i)
+    {
+        stringOffsets.push_back(stringDataSize);
+        stringDataSize += profile.GetString(i).size() + 1;
+    }
+    stringOffsets.push_back(stringDataSize);
+
+    Header header;
+    ::memset(&header, 0, sizeof(header));
+    ::memcpy(header.Magic, MAGIC, sizeof(MAGIC));
+    header.Version = VERSION;
+    header.Flags = profile.IsLineMode() ? FLAG_LINE_MODE : 0;
+    header.LabelCount = static_cast<uint32_t>(profile.GetLabels().size());
+    header.Period = profile.GetPeriod();
+    header.StartTime = profile.GetStartTime();
+    header.Duration = profile.GetDuration();
+    header.TotalSampleCount = profile.GetTotalSampleCount();
+    header.StringCount = profile.GetStringCount();
+    header.StringDataSize = stringDataSize;
+    header.FrameCount = profile.GetFrameCount();
+    header.StackCount = profile.GetStackCount();
+    header.MappingCount = profile.GetMappings().size();
+    header.ThreadCount = timeline ? timeline->GetThreads().size() : 0;
+    header.TimelineSize = timeline ? timeline->GetByteSize() : 0;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    WriteArray(out, stringOffsets);
+    for (ProfileId i = 0; i < profile.GetStringCount(); ++i)
+    {
+        const auto& str = profile.GetString(i);
+        out.write(str.c_str(), str.size() + 1);
+    }
+    WritePadding(out, stringDataSize);
+
+    // 栈帧表
+    vector<Frame> frames(profile.GetFrameCount());
+    for (ProfileId i = 0; i < profile.GetFrameCount(); ++i)
+    {
+        const auto& frame = profile.GetFrame(i);
+        auto& f = frames[i];
+        ::memset(&f, 0, sizeof(f));
+        f.Type = static_cast<uint32_t>(frame.Type);
+        f.Name = frame.Name;
+        f.Source = frame.Source;
+        f.LineDefined = frame.LineDefined;
+        f.Line = frame.Line;
+        f.Address = frame.Address;
+    }
+    WriteArray(out, frames);
+
+    // 堆栈表
+    vector<uint32_t> parents(profile.GetStackCount());
+    vector<uint32_t> stackFrames(profile.GetStackCount());
+    vector<uint64_t> counts(profile.GetStackCount());
+    for (ProfileId i = 0; i < profile.GetStackCount(); ++i)
+    {
+        parents[i] = profile.GetStack(i).Parent;
+        stackFrames[i] = profile.GetStack(i).Frame;
+        counts[i] = profile.GetSampleCount(i);
+    }
+    WriteArray(out, parents);
+    WriteArray(out, stackFrames);
+    WriteArray(out, counts);
+
+    // 内存映射
+    vector<Mapping> mappings(profile.GetMappings().size());
+    for (size_t i = 0; i < mappings.size(); ++i)
+    {
+        const auto& mapping = profile.GetMappings()[i];
+        auto& m = mappings[i];
+        ::memset(&m, 0, sizeof(m));
+        m.Start = mapping.Start;
+        m.Limit = mapping.Limit;
+        m.Offset = mapping.Offset;
+        m.File = mapping.File;
+    }
+    WriteArray(out, mappings);
+
+    // 标签
+    vector<uint32_t> labels;
+    labels.reserve(profile.GetLabels().size() * 2);
+    for (const auto& label : profile.GetLabels())
+    {
+        labels.push_back(label.Key);
+        labels.push_back(label.Value);
+    }
+    WriteArray(out, labels);
+
+    // 时间线
+    if (timeline)
+    {
+        WriteArray(out, timeline->GetThreads());
+        WriteArray(out, timeline->GetData());
+    }
+    out.flush();
+}
+
+bool lperf::IsBinaryProfile(const std::string& path)
+{
+    if (IsGzipFile(path))
+    {
+        // 压缩的剖析文件只需解压开头的几个字节
+        auto file = ::gzopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+        char magic[sizeof(BinaryProfileFormat::MAGIC)] = {};
+        auto count = ::gzread(file, magic, sizeof(magic));
+        ::gzclose(file);
+        return count == static_cast<int>(sizeof(magic)) &&
+            ::memcmp(magic, BinaryProfileFormat::MAGIC, sizeof(magic)) == 0;
+    }
+
+    ifstream in(path, ios::in | ios::binary);
+    char magic[sizeof(BinaryProfileFormat::MAGIC)] = {};
+    if (!in.read(magic, sizeof(magic)))
+        return false;
+    return ::memcmp(magic, BinaryProfileFormat::MAGIC, sizeof(magic)) == 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////// BinaryProfile
+
+BinaryProfile::BinaryProfile(const std::string& path)
+{
+    using namespace BinaryProfileFormat;
+
+    if (IsGzipFile(path))
+    {
+        // 压缩的剖析文件（如持续采样的分段）解压到内存中读取
+        ReadGzipFile(path, m_stBuffer);
+        m_uSize = m_stBuffer.size();
+        if (m_uSize < sizeof(Header))
+            MOE_THROW(BadFormatException, "Profile \"{0}\" is too small", path);
+        m_pData = reinterpret_cast<const uint8_t*>(m_stBuffer.data());
+        Parse(path);
+        return;
+    }
+
+    m_iFd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_iFd < 0)
+        MOE_THROW(ApiException, "Cannot open profile \"{0}\", errno={1}({2})", path, errno, strerror(errno));
+
+    struct stat st;
+    if (::fstat(m_iFd, &st) != 0)
+    {
+        ::close(m_iFd);
+        MOE_THROW(ApiException, "Stat profile \"{0}\" error, errno={1}({2})", path, errno, strerror(errno));
+    }
+    m_uSize = static_cast<size_t>(st.st_size);
+    if (m_uSize < sizeof(Header))
+    {
+        ::close(m_iFd);
+        MOE_THROW(BadFormatException, "Profile \"{0}\" is too small", path);
+    }
+
+    auto data = ::mmap(nullptr, m_uSize, PROT_READ, MAP_PRIVATE, m_iFd, 0);
+    if (data == MAP_FAILED)
+    {
+        ::close(m_iFd);
+        MOE_THROW(ApiException, "Map profile \"{0}\" error, errno={1}({2})", path, errno, strerror(errno));
+    }
+    m_pData = static_cast<const uint8_t*>(data);
+
+    try
+    {
+        Parse(path);
+    }
+    catch (...)
+    {
+        ::munmap(const_cast<uint8_t*>(m_pData), m_uSize);
+        ::close(m_iFd);
+        throw;
+    }
+}
+
+BinaryProfile::~BinaryProfile()
+{
+    if (m_iFd >= 0)
+    {
+        ::munmap(const_cast<uint8_t*>(m_pData), m_uSize);
+        ::close(m_iFd);
+    }
+}
+
+void BinaryProfile::Parse(const std::string& path)
+{
+    using namespace BinaryProfileFormat;
+
+    m_pHeader = reinterpret_cast<const Header*>(m_pData);
+    if (::memcmp(m_pHeader->Magic, MAGIC, sizeof(MAGIC)) != 0)
+        MOE_THROW(BadFormatException, "\"{0}\" is not a binary profile", path);
+    if (m_pHeader->Version == 0 || m_pHeader->Version > VERSION)
+        MOE_THROW(BadFormatException, "Unsupported profile version {0}", m_pHeader->Version);
+
+    // 防止计算偏移时溢出
+    static const uint64_t MAX_COUNT = static_cast<uint64_t>(1) << 40;
+    if (m_pHeader->StringCount == 0 || m_pHeader->StringCount > MAX_COUNT ||
+        m_pHeader->StringDataSize > MAX_COUNT || m_pHeader->FrameCount > MAX_COUNT ||
+        m_pHeader->StackCount > MAX_COUNT || m_pHeader->MappingCount > MAX_COUNT ||
+        m_pHeader->ThreadCount > MAX_COUNT || m_pHeader->TimelineSize > MAX_COUNT)
+    {
+        MOE_THROW(BadFormatException, "Corrupted profile header");
+    }
+
+    auto layout = ComputeLayout(*m_pHeader);
+    if (layout.End > m_uSize)
+        MOE_THROW(BadFormatException, "Profile truncated, expect {0} bytes, got {1}", layout.End, m_uSize);
+
+    m_pStringOffsets = reinterpret_cast<const uint64_t*>(m_pData + layout.StringOffsets);
+    m_pStringData = reinterpret_cast<const char*>(m_pData + layout.StringData);
+    m_pFrames = reinterpret_cast<const Frame*>(m_pData + layout.Frames);
+    m_pStackParents = reinterpret_cast<const uint32_t*>(m_pData + layout.StackParents);
+    m_pStackFrames = reinterpret_cast<const uint32_t*>(m_pData + layout.StackFrames);
+    m_pSampleCounts = reinterpret_cast<const uint64_t*>(m_pData + layout.SampleCounts);
+    m_pMappings = reinterpret_cast<const Mapping*>(m_pData + layout.Mappings);
+    m_pLabels = reinterpret_cast<const uint32_t*>(m_pData + layout.Labels);
+    m_pThreads = reinterpret_cast<const uint64_t*>(m_pData + layout.Threads);
+    m_pTimeline = m_pData + layout.Timeline;
+
+    // 校验引用关系，之后的访问无需再检查边界
+    auto stringCount = m_pHeader->StringCount;
+    if (m_pStringOffsets[0] != 0 || m_pStringOffsets[stringCount] != m_pHeader->StringDataSize)
+        MOE_THROW(BadFormatException, "Corrupted string table");
+    for (size_t i = 0; i < stringCount; ++i)
+    {
+        auto end = m_pStringOffsets[i + 1];
+        if (end <= m_pStringOffsets[i] || m_pStringData[end - 1] != '\0')
+            MOE_THROW(BadFormatException, "Corrupted string {0}", i);
+    }
+    for (size_t i = 0; i < m_pHeader->FrameCount; ++i)
+    {
+        if (m_pFrames[i].Type > static_cast<uint32_t>(LuaFunctionType::VirtualMachine) ||
+            m_pFrames[i].Name >= stringCount || m_pFrames[i].Source >= stringCount)
+            MOE_THROW(BadFormatException, "Corrupted frame {0}", i);
+    }
+    for (size_t i = 0; i < m_pHeader->StackCount; ++i)
+    {
+        if ((m_pStackParents[i] != INVALID_PROFILE_ID && m_pStackParents[i] >= i) ||
+            m_pStackFrames[i] >= m_pHeader->FrameCount)
+        {
+            MOE_THROW(BadFormatException, "Corrupted stack {0}", i);
+        }
+    }
+    for (size_t i = 0; i < m_pHeader->MappingCount; ++i)
+    {
+        if (m_pMappings[i].File >= stringCount)
+            MOE_THROW(BadFormatException, "Corrupted mapping {0}", i);
+    }
+    for (size_t i = 0; i < m_pHeader->LabelCount * 2; ++i)
+    {
+        if (m_pLabels[i] >= stringCount)
+            MOE_THROW(BadFormatException, "Corrupted label {0}", i / 2);
+    }
+
+    // 时间线为变长编码，需逐个采样校验线程序号与堆栈ID
+    auto reader = GetTimelineReader();
+    TimelineSample sample;
+    size_t sampleIndex = 0;
+    while (reader.Next(sample))
+    {
+        if (sample.Thread >= m_pHeader->ThreadCount ||
+            (sample.Stack != INVALID_PROFILE_ID && sample.Stack >= m_pHeader->StackCount))
+        {
+            MOE_THROW(BadFormatException, "Corrupted timeline sample {0}", sampleIndex);
+        }
+        ++sampleIndex;
+    }
+    if (reader.IsCorrupted())
+        MOE_THROW(BadFormatException, "Corrupted timeline sample {0}", sampleIndex);
+}
+
+void BinaryProfile::Load(Profile& profile, Timeline* timeline)const
+{
+    profile.SetLineMode(IsLineMode());
+    profile.SetPeriod(m_pHeader->Period);
+    profile.SetStartTime(m_pHeader->StartTime);
+    profile.SetDuration(m_pHeader->Duration);
+
+    auto stacks = Merge(profile);
+
+    for (size_t i = 0; i < GetMappingCount(); ++i)
+    {
+        const auto& m = m_pMappings[i];
+        profile.AddMapping(m.Start, m.Limit, m.Offset, GetString(m.File));
+    }
+    for (size_t i = 0; i < GetLabelCount(); ++i)
+    {
+        profile.SetLabel(string(GetString(GetLabelKey(i)), GetStringLength(GetLabelKey(i))),
+            string(GetString(GetLabelValue(i)), GetStringLength(GetLabelValue(i))));
+    }
+
+    if (timeline)
+    {
+        // 堆栈ID在同一份剖析数据中保持不变时，时间线可以直接复用
+        vector<uint64_t> threads(m_pThreads, m_pThreads + m_pHeader->ThreadCount);
+        bool identity = true;
+        for (ProfileId i = 0; i < GetStackCount() && identity; ++i)
+            identity = (stacks[i] == i);
+        if (identity)
+            timeline->Assign(m_pTimeline, m_pHeader->TimelineSize, threads);
+        else
+        {
+            auto reader = GetTimelineReader();
+            TimelineSample sample;
+            while (reader.Next(sample))
+            {
+                auto stack = sample.Stack != INVALID_PROFILE_ID ? stacks[sample.Stack] : INVALID_PROFILE_ID;
+                timeline->Append(sample.Time, threads[sample.Thread], stack);
+            }
+        }
+    }
+}
+
+std::vector<ProfileId> BinaryProfile::Merge(Profile& profile, ProfileId root)const
+{
+    vector<ProfileId> strings(GetStringCount(), INVALID_PROFILE_ID);
+    auto importString = [&](ProfileId id) {
+        if (strings[id] == INVALID_PROFILE_ID)
+            strings[id] = profile.InternString(string(GetString(id), GetStringLength(id)));
+        return strings[id];
+    };
+
+    vector<ProfileId> frames(GetFrameCount());
+    for (ProfileId i = 0; i < GetFrameCount(); ++i)
+    {
+        const auto& f = m_pFrames[i];
+        ProfileFrame frame;
+        frame.Type = static_cast<LuaFunctionType>(f.Type);
+        frame.Name = importString(f.Name);
+        frame.Source = importString(f.Source);
+        frame.LineDefined = f.LineDefined;
+        frame.Line = f.Line;
+        frame.Address = static_cast<uintptr_t>(f.Address);
+        frames[i] = profile.InternFrame(frame);
+    }
+
+    vector<ProfileId> stacks(GetStackCount());
+    for (ProfileId i = 0; i < GetStackCount(); ++i)
+    {
+        auto parent = m_pStackParents[i];
+        stacks[i] = profile.InternStack(parent == INVALID_PROFILE_ID ? root : stacks[parent], frames[m_pStackFrames[i]]);
+        profile.AddSample(stacks[i], m_pSampleCounts[i]);
+    }
+    return stacks;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "CallgrindWriter.hpp"
+#include "Report.hpp"
+
+#include <map>
+#include <tuple>
+#include <ostream>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+namespace
+{
+    /**
+     * @brief 调用边的汇总数据
+     *
+     * 采样无法得知真实的调用次数，以观察到该边的不同调用路径（堆栈树节点）的个数代替。
+     */
+    struct CallgrindCall
+    {
+        uint64_t Count = 0;
+        uint64_t Cost = 0;  // 被调用方的总开销
+    };
+
+    /**
+     * @brief 函数的汇总数据
+     */
+    struct CallgrindFunction
+    {
+        ProfileId Frame = 0;  // 代表该函数的任一栈帧
+        std::map<unsigned, uint64_t> SelfCosts;  // 行 -> 自身开销
+        std::map<std::pair<size_t, unsigned>, CallgrindCall> Calls;  // (被调用函数, 调用行) -> 调用边
+    };
+
+    /**
+     * @brief 名称压缩
+     *
+     * 同一名称第一次出现时输出 "(id) name"，之后只输出 "(id)"。
+     */
+    class NameCompressor
+    {
+    public:
+        string Get(const string& name)
+        {
+            auto it = m_stIds.find(name);
+            if (it != m_stIds.end())
+                return StringUtils::Format("({0})", it->second);
+
+            auto id = m_stIds.size() + 1;
+            m_stIds.emplace(name, id);
+            return StringUtils::Format("({0}) {1}", id, name);
+        }
+
+    private:
+        std::unordered_map<std::string, size_t> m_stIds;
+    };
+
+    unsigned GetFrameLine(const ProfileFrame& frame)noexcept
+    {
+        return frame.Line != 0 ? frame.Line : frame.LineDefined;
+    }
+}
+
+void lperf::WriteCallgrind(const Profile& profile, std::ostream& out)
+{
+    auto stackCount = profile.GetStackCount();
+
+    // 父节点的ID总是小于子节点，逆序遍历即可累计总开销
+    vector<uint64_t> totals(stackCount);
+    for (ProfileId i = 0; i < stackCount; ++i)
+        totals[i] = profile.GetSampleCount(i);
+    for (auto i = stackCount; i > 0; --i)
+    {
+        auto parent = profile.GetStack(i - 1).Parent;
+        if (parent != INVALID_PROFILE_ID)
+            totals[parent] += totals[i - 1];
+    }
+
+    // 行模式下同一函数对应多个栈帧，按函数归并
+    using FunctionKey = tuple<int, ProfileId, ProfileId, unsigned, uintptr_t>;
+    map<FunctionKey, size_t> functionIndex;
+    vector<CallgrindFunction> functions;
+    vector<size_t> frameFunctions(profile.GetFrameCount());
+    for (ProfileId i = 0; i < profile.GetFrameCount(); ++i)
+    {
+        const auto& frame = profile.GetFrame(i);
+        FunctionKey key(static_cast<int>(frame.Type), frame.Name, frame.Source, frame.LineDefined,
+            frame.Type == LuaFunctionType::Native ? frame.Address : 0);
+        auto it = functionIndex.find(key);
+        if (it == functionIndex.end())
+        {
+            it = functionIndex.emplace(key, functions.size()).first;
+            functions.emplace_back();
+            functions.back().Frame = i;
+        }
+        frameFunctions[i] = it->second;
+    }
+
+    // 单次遍历堆栈树
+    for (ProfileId i = 0; i < stackCount; ++i)
+    {
+        if (totals[i] == 0)
+            continue;
+
+        const auto& stack = profile.GetStack(i);
+        const auto& frame = profile.GetFrame(stack.Frame);
+        auto self = profile.GetSampleCount(i);
+        if (self > 0)
+            functions[frameFunctions[stack.Frame]].SelfCosts[GetFrameLine(frame)] += self;
+
+        if (stack.Parent != INVALID_PROFILE_ID)
+        {
+            auto callerFrame = profile.GetStack(stack.Parent).Frame;
+            auto& caller = functions[frameFunctions[callerFrame]];
+            auto key = make_pair(frameFunctions[stack.Frame], GetFrameLine(profile.GetFrame(callerFrame)));
+            auto& call = caller.Calls[key];
+            ++call.Count;
+            call.Cost += totals[i];
+        }
+    }
+
+    // 输出
+    vector<string> names(functions.size());
+    for (size_t i = 0; i < functions.size(); ++i)
+    {
+        const auto& frame = profile.GetFrame(functions[i].Frame);
+        if (frame.Type == LuaFunctionType::Lua)
+        {
+            const auto& name = profile.GetString(frame.Name);
+            names[i] = StringUtils::Format("{0}:{1}", name.empty() ? "?" : name, frame.LineDefined);
+        }
+        else
+            names[i] = FormatProfileFrame(profile, frame);
+    }
+    auto getFile = [&](size_t function) {
+        const auto& frame = profile.GetFrame(functions[function].Frame);
+        return frame.Type == LuaFunctionType::Lua ? profile.GetString(frame.Source) : string("[native]");
+    };
+
+    out << "# callgrind format\n";
+    out << "version: 1\n";
+    out << "creator: lperf\n";
+    out << "positions: line\n";
+    out << "events: Samples\n";
+    out << "summary: " << profile.GetTotalSampleCount() << "\n\n";
+
+    NameCompressor files, fns;
+    for (size_t i = 0; i < functions.size(); ++i)
+    {
+        const auto& function = functions[i];
+        if (function.SelfCosts.empty() && function.Calls.empty())
+            continue;
+
+        out << "fl=" << files.Get(getFile(i)) << "\n";
+        out << "fn=" << fns.Get(names[i]) << "\n";
+        for (const auto& cost : function.SelfCosts)
+            out << cost.first << " " << cost.second << "\n";
+        for (const auto& call : function.Calls)
+        {
+            auto callee = call.first.first;
+            out << "cfl=" << files.Get(getFile(callee)) << "\n";
+            out << "cfn=" << fns.Get(names[callee]) << "\n";
+            out << "calls=" << call.second.Count << " " << profile.GetFrame(functions[callee].Frame).LineDefined <<
+                "\n";
+            out << call.first.second << " " << call.second.Cost << "\n";
+        }
+        out << "\n";
+    }
+    out.flush();
+}
@@ -0,0 +1,715 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "Daemon.hpp"
+#include "Report.hpp"
+#include "PProfWriter.hpp"
+#include "BinaryProfile.hpp"
+
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <Moe.Core/Logging.hpp>
+
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+static const size_t MAX_REQUEST_SIZE = 64 * 1024;
+static const int MAX_POLL_TIMEOUT = 1000;
+static const int TARGET_POLL_TIMEOUT = 100;  // 有目标时检查其事件的最大间隔（毫秒），决定信号被延迟投递的上限
+static const uint32_t DEFAULT_PROFILE_SECONDS = 30;
+
+namespace
+{
+    void SetNonBlocking(int fd)
+    {
+        auto flags = ::fcntl(fd, F_GETFL, 0);
+        if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+            MOE_THROW(ApiException, "Set non-blocking error, errno={0}({1})", errno, strerror(errno));
+    }
+
+    uint64_t ParseNumber(const std::string& text, const char* what)
+    {
+        size_t processed = 0;
+        auto ret = Convert::ParseUInt(text.c_str(), text.size(), processed);
+        if (text.empty() || processed < text.size())
+            MOE_THROW(BadFormatException, "Invalid {0}: {1}", what, text);
+        return ret;
+    }
+
+    std::string GetQueryParameter(const std::string& query, const std::string& key)
+    {
+        size_t start = 0;
+        while (start < query.size())
+        {
+            auto end = query.find('&', start);
+            if (end == string::npos)
+                end = query.size();
+            auto eq = query.find('=', start);
+            if (eq != string::npos && eq < end && query.compare(start, eq - start, key) == 0 &&
+                eq - start == key.size())
+            {
+                return query.substr(eq + 1, end - eq - 1);
+            }
+            start = end + 1;
+        }
+        return string();
+    }
+
+    const char* GetHttpStatusText(int status)
+    {
+        switch (status)
+        {
+            case 200:
+                return "OK";
+            case 400:
+                return "Bad Request";
+            case 404:
+                return "Not Found";
+            case 410:
+                return "Gone";
+            default:
+                return "Internal Server Error";
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////// Daemon
+
+struct Daemon::Target
+{
+    uint64_t Pid = 0;
+    unique_ptr<Debugger> Process;
+    unique_ptr<LuaSampler> Sampler;  // 持有 Proto 缓存，需先于 Process 析构
+    uintptr_t LuaState = 0;
+    ReportOptions Options;  // 内存映射与标签
+
+    uint32_t Interval = 0;
+    bool Running = false;
+    Clock::time_point NextSample;
+
+    Profile Samples;
+
+    ~Target()
+    {
+        Sampler.reset();
+        Process.reset();
+    }
+};
+
+struct Daemon::Connection
+{
+    int Fd = -1;
+    bool Http = false;
+    bool Closing = false;  // 写完后关闭
+    bool InputClosed = false;  // 对端已关闭写端
+    std::string Input;
+    std::string Output;
+
+    // HTTP 采样窗口
+    uint64_t WindowPid = 0;
+    unique_ptr<Profile> Window;
+    Clock::time_point WindowEnd;
+
+    ~Connection()
+    {
+        if (Fd >= 0)
+            ::close(Fd);
+    }
+};
+
+Daemon::Daemon(const DaemonOptions& options)
+    : m_stOptions(options)
+{
+    // 控制套接字
+    m_iUnixListener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_iUnixListener < 0)
+        MOE_THROW(ApiException, "Create unix socket error, errno={0}({1})", errno, strerror(errno));
+
+    sockaddr_un addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (options.SocketPath.size() >= sizeof(addr.sun_path))
+    {
+        ::close(m_iUnixListener);
+        MOE_THROW(BadArgumentException, "Socket path too long: {0}", options.SocketPath);
+    }
+    ::strcpy(addr.sun_path, options.SocketPath.c_str());
+    ::unlink(options.SocketPath.c_str());
+
+    // 服务可以挂接任意进程：套接字文件在 bind 时就以 0600 创建，不留其他用户可以连接的间隙
+    auto mask = ::umask(0077);
+    auto bound = ::bind(m_iUnixListener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    int err = errno;
+    ::umask(mask);
+    if (bound != 0)
+    {
+        ::close(m_iUnixListener);
+        MOE_THROW(ApiException, "Bind on \"{0}\" error, errno={1}({2})", options.SocketPath, err, strerror(err));
+    }
+    if (::chmod(options.SocketPath.c_str(), 0600) != 0)
+    {
+        err = errno;
+        ::close(m_iUnixListener);
+        ::unlink(options.SocketPath.c_str());
+        MOE_THROW(ApiException, "Chmod \"{0}\" error, errno={1}({2})", options.SocketPath, err, strerror(err));
+    }
+    if (::listen(m_iUnixListener, 16) != 0)
+    {
+        err = errno;
+        ::close(m_iUnixListener);
+        ::unlink(options.SocketPath.c_str());
+        MOE_THROW(ApiException, "Listen on \"{0}\" error, errno={1}({2})", options.SocketPath, err, strerror(err));
+    }
+    SetNonBlocking(m_iUnixListener);
+    MOE_LOG_INFO("Listening on {0}", options.SocketPath);
+
+    // HTTP
+    if (options.HttpPort != 0)
+    {
+        m_iHttpListener = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (m_iHttpListener < 0)
+        {
+            int err = errno;
+            ::close(m_iUnixListener);
+            MOE_THROW(ApiException, "Create tcp socket error, errno={0}({1})", err, strerror(err));
+        }
+
+        int reuse = 1;
+        ::setsockopt(m_iHttpListener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in inAddr;
+        ::memset(&inAddr, 0, sizeof(inAddr));
+        inAddr.sin_family = AF_INET;
+        inAddr.sin_port = htons(options.HttpPort);
+        inAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(m_iHttpListener, reinterpret_cast<sockaddr*>(&inAddr), sizeof(inAddr)) != 0 ||
+            ::listen(m_iHttpListener, 16) != 0)
+        {
+            int err = errno;
+            ::close(m_iHttpListener);
+            ::close(m_iUnixListener);
+            MOE_THROW(ApiException, "Listen on port {0} error, errno={1}({2})", options.HttpPort, err, strerror(err));
+        }
+        SetNonBlocking(m_iHttpListener);
+        MOE_LOG_INFO("Serving http on 127.0.0.1:{0}", options.HttpPort);
+    }
+}
+
+Daemon::~Daemon()
+{
+    m_stConnections.clear();
+    m_stTargets.clear();
+
+    if (m_iHttpListener >= 0)
+        ::close(m_iHttpListener);
+    ::close(m_iUnixListener);
+    ::unlink(m_stOptions.SocketPath.c_str());
+}
+
+void Daemon::Run(const std::function<bool()>& stopRequested)
+{
+    vector<pollfd> fds;
+    while (!stopRequested())
+    {
+        fds.clear();
+        fds.push_back(pollfd { m_iUnixListener, POLLIN, 0 });
+        if (m_iHttpListener >= 0)
+            fds.push_back(pollfd { m_iHttpListener, POLLIN, 0 });
+        auto listenerCount = fds.size();
+        for (const auto& conn : m_stConnections)
+        {
+            short events = (conn->Closing || conn->InputClosed) ? 0 : POLLIN;
+            if (!conn->Output.empty())
+                events |= POLLOUT;
+            fds.push_back(pollfd { conn->Fd, events, 0 });
+        }
+
+        auto ret = ::poll(fds.data(), fds.size(), GetPollTimeout(Clock::now()));
+        if (ret < 0 && errno != EINTR)
+            MOE_THROW(ApiException, "Poll error, errno={0}({1})", errno, strerror(errno));
+
+        if (ret > 0)
+        {
+            // 先处理已有连接，新连接在下一轮加入
+            for (size_t i = listenerCount; i < fds.size(); ++i)
+            {
+                auto& conn = *m_stConnections[i - listenerCount];
+                if (conn.InputClosed && (fds[i].revents & (POLLHUP | POLLERR)))
+                {
+                    // 对端已完全断开，放弃未写完的应答与采样窗口
+                    ::close(conn.Fd);
+                    conn.Fd = -1;
+                    continue;
+                }
+                if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                    Receive(conn);
+                if (conn.Fd >= 0 && (fds[i].revents & POLLOUT))
+                    Send(conn);
+            }
+            if (fds[0].revents & POLLIN)
+                Accept(m_iUnixListener, false);
+            if (m_iHttpListener >= 0 && (fds[1].revents & POLLIN))
+                Accept(m_iHttpListener, true);
+        }
+
+        auto now = Clock::now();
+        PollTargets();
+        Sample(now);
+        CompleteWindows(now);
+
+        // 回收已关闭的连接
+        m_stConnections.erase(remove_if(m_stConnections.begin(), m_stConnections.end(),
+            [](const unique_ptr<Connection>& conn) { return conn->Fd < 0; }), m_stConnections.end());
+    }
+}
+
+void Daemon::Accept(int listener, bool http)
+{
+    while (true)
+    {
+        auto fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                MOE_LOG_ERROR("Accept error, errno={0}({1})", errno, strerror(errno));
+            return;
+        }
+
+        unique_ptr<Connection> conn(new Connection());
+        conn->Fd = fd;
+        conn->Http = http;
+        m_stConnections.emplace_back(std::move(conn));
+    }
+}
+
+void Daemon::Receive(Connection& conn)
+{
+    char buffer[4096];
+    bool finished = false;
+    while (true)
+    {
+        auto count = ::recv(conn.Fd, buffer, sizeof(buffer), 0);
+        if (count > 0)
+        {
+            conn.Input.append(buffer, static_cast<size_t>(count));
+            continue;
+        }
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            break;
+
+        // 对端关闭写端或出错：仍处理已收到的请求，应答写完后再关闭（如 echo cmd | nc -U）
+        finished = true;
+        conn.InputClosed = true;
+        break;
+    }
+
+    if (conn.Input.size() > MAX_REQUEST_SIZE)
+    {
+        MOE_LOG_WARN("Request too large, closing connection");
+        ::close(conn.Fd);
+        conn.Fd = -1;
+        return;
+    }
+
+    if (conn.Http)
+    {
+        auto end = conn.Input.find("\r\n\r\n");
+        if (!conn.Closing && !conn.Window && end != string::npos)
+        {
+            auto request = conn.Input.substr(0, conn.Input.find("\r\n"));
+            conn.Input.clear();
+            HandleHttpRequest(conn, request);
+        }
+    }
+    else
+    {
+        // 最后一行可以没有换行符
+        if (finished && !conn.Input.empty() && conn.Input.back() != '\n')
+            conn.Input.push_back('\n');
+
+        size_t start = 0, end = 0;
+        while ((end = conn.Input.find('\n', start)) != string::npos)
+        {
+            auto line = conn.Input.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            start = end + 1;
+            if (!line.empty())
+                conn.Output.append(HandleCommand(line));
+        }
+        conn.Input.erase(0, start);
+    }
+
+    if (finished && !conn.Window)
+        conn.Closing = true;
+    if (!conn.Output.empty() || conn.Closing)
+        Send(conn);
+}
+
+void Daemon::Send(Connection& conn)
+{
+    while (!conn.Output.empty())
+    {
+        auto count = ::send(conn.Fd, conn.Output.data(), conn.Output.size(), MSG_NOSIGNAL);
+        if (count > 0)
+        {
+            conn.Output.erase(0, static_cast<size_t>(count));
+            continue;
+        }
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return;
+
+        ::close(conn.Fd);
+        conn.Fd = -1;
+        return;
+    }
+
+    if (conn.Closing)
+    {
+        ::close(conn.Fd);
+        conn.Fd = -1;
+    }
+}
+
+void Daemon::PollTargets()
+{
+    // 目标在采样之间一直保持挂接，需要替它投递其间收到的信号并回收已退出的进程
+    for (auto it = m_stTargets.begin(); it != m_stTargets.end(); )
+    {
+        auto& target = **it;
+        try
+        {
+            if (target.Process->Poll())
+            {
+                ++it;
+                continue;
+            }
+            MOE_LOG_WARN("Target {0} terminated, detached", target.Pid);
+        }
+        catch (const ExceptionBase& ex)
+        {
+            MOE_LOG_ERROR("Poll target {0} failure, detached: {1}", target.Pid, ex.GetDescription());
+        }
+        it = m_stTargets.erase(it);
+    }
+}
+
+void Daemon::Sample(Clock::time_point now)
+{
+    vector<LuaStackFrame> stack;
+    for (auto it = m_stTargets.begin(); it != m_stTargets.end(); )
+    {
+        auto& target = **it;
+        bool windowed = any_of(m_stConnections.begin(), m_stConnections.end(),
+            [&](const unique_ptr<Connection>& conn) { return conn->Window && conn->WindowPid == target.Pid; });
+        if ((!target.Running && !windowed) || now < target.NextSample)
+        {
+            ++it;
+            continue;
+        }
+
+        if (target.Process->GetStatus() == ProcessStatus::Terminated)
+        {
+            MOE_LOG_WARN("Target {0} terminated, detached", target.Pid);
+            it = m_stTargets.erase(it);
+            continue;
+        }
+
+        try
+        {
+            stack = target.Sampler->DumpStack(target.LuaState);
+            if (target.Running)
+                target.Samples.AddSample(target.Samples.InternStack(stack));
+            for (const auto& conn : m_stConnections)
+            {
+                if (conn->Window && conn->WindowPid == target.Pid)
+                    conn->Window->AddSample(conn->Window->InternStack(stack));
+            }
+        }
+        catch (const ExceptionBase& ex)
+        {
+            MOE_LOG_ERROR("Capture frame of {0} failure: {1}", target.Pid, ex.GetDescription());
+        }
+
+        // 落后太多时不追赶，避免连续采样
+        target.NextSample += chrono::milliseconds(target.Interval);
+        if (target.NextSample < now)
+            target.NextSample = now + chrono::milliseconds(target.Interval);
+        ++it;
+    }
+}
+
+void Daemon::CompleteWindows(Clock::time_point now)
+{
+    for (const auto& conn : m_stConnections)
+    {
+        if (!conn->Window || conn->Fd < 0)
+            continue;
+
+        auto it = find_if(m_stTargets.begin(), m_stTargets.end(),
+            [&](const unique_ptr<Target>& target) { return target->Pid == conn->WindowPid; });
+        if (it == m_stTargets.end())
+        {
+            conn->Window.reset();
+            WriteHttpResponse(*conn, 410, "text/plain", "target detached\n");
+            continue;
+        }
+        if (now < conn->WindowEnd)
+            continue;
+
+        auto body = RenderProfile(*conn->Window, "pprof");
+        conn->Window.reset();
+        WriteHttpResponse(*conn, 200, "application/octet-stream", body);
+    }
+}
+
+std::string Daemon::HandleCommand(const std::string& line)
+{
+    vector<string> args;
+    StringUtils::Split(args, line, ' ', StringUtils::SplitFlags::RemoveEmptyEntries);
+    if (args.empty())
+        return "ERR empty command\n";
+
+    try
+    {
+        const auto& cmd = args[0];
+        if (cmd == "list")
+        {
+            string ret = StringUtils::Format("OK {0}\n", m_stTargets.size());
+            for (const auto& target : m_stTargets)
+            {
+                ret.append(StringUtils::Format("{0} {1}ms {2} {3}\n", target->Pid, target->Interval,
+                    target->Running ? "running" : "stopped", target->Samples.GetTotalSampleCount()));
+            }
+            return ret;
+        }
+
+        if (cmd != "attach" && cmd != "detach" && cmd != "start" && cmd != "stop" && cmd != "rate" && cmd != "fetch")
+            MOE_THROW(BadArgumentException, "Unknown command {0}", cmd);
+        if (args.size() < 2)
+            MOE_THROW(BadArgumentException, "Missing pid");
+        auto pid = ParseNumber(args[1], "pid");
+
+        if (cmd == "attach")
+        {
+            for (const auto& target : m_stTargets)
+            {
+                if (target->Pid == pid)
+                    MOE_THROW(ObjectExistsException, "Already attached to {0}", pid);
+            }
+
+            vector<uintptr_t> entries;
+            if (args.size() >= 4)
+            {
+                vector<string> container;
+                StringUtils::Split(container, args[3], ',', StringUtils::SplitFlags::RemoveEmptyEntries);
+                for (const auto& i : container)
+                    entries.push_back(static_cast<uintptr_t>(ParseNumber(i, "entry point")));
+            }
+
+            // 附加、解析调试符号与抓取 lua_State 只在此处发生一次
+            unique_ptr<Target> target(new Target());
+            target->Pid = pid;
+            target->Interval = args.size() >= 3 ? static_cast<uint32_t>(ParseNumber(args[2], "interval")) :
+                m_stOptions.DefaultInterval;
+            if (target->Interval == 0)
+                MOE_THROW(BadArgumentException, "Interval must be positive");
+            target->Process.reset(new Debugger(pid));
+            target->Sampler.reset(new LuaSampler(*target->Process));
+            target->LuaState = target->Sampler->FetchLuaState(entries);
+            CollectProcessInfo(*target->Process, target->Options);
+            InitProfile(*target, target->Samples);
+            m_stTargets.emplace_back(std::move(target));
+            MOE_LOG_INFO("Attached to {0}", pid);
+            return "OK\n";
+        }
+
+        auto& target = FindTarget(pid);
+        if (cmd == "detach")
+        {
+            m_stTargets.erase(find_if(m_stTargets.begin(), m_stTargets.end(),
+                [&](const unique_ptr<Target>& i) { return i.get() == &target; }));
+            MOE_LOG_INFO("Detached from {0}", pid);
+            return "OK\n";
+        }
+        else if (cmd == "start")
+        {
+            target.Samples = Profile();
+            InitProfile(target, target.Samples);
+            target.Running = true;
+            target.NextSample = Clock::now();
+            return "OK\n";
+        }
+        else if (cmd == "stop")
+        {
+            target.Running = false;
+            return StringUtils::Format("OK {0}\n", target.Samples.GetTotalSampleCount());
+        }
+        else if (cmd == "rate")
+        {
+            if (args.size() < 3)
+                MOE_THROW(BadArgumentException, "Missing interval");
+            auto interval = static_cast<uint32_t>(ParseNumber(args[2], "interval"));
+            if (interval == 0)
+                MOE_THROW(BadArgumentException, "Interval must be positive");
+            target.Interval = interval;
+            target.Samples.SetPeriod(static_cast<uint64_t>(interval) * 1000000u);
+            return "OK\n";
+        }
+        else if (cmd == "fetch")
+        {
+            auto data = RenderProfile(target.Samples, args.size() >= 3 ? args[2] : string("pprof"));
+            return StringUtils::Format("OK {0}\n", data.size()) + data;
+        }
+        MOE_THROW(BadArgumentException, "Unknown command {0}", cmd);
+    }
+    catch (const ExceptionBase& ex)
+    {
+        return StringUtils::Format("ERR {0}\n", ex.GetDescription());
+    }
+    catch (const exception& ex)
+    {
+        return StringUtils::Format("ERR {0}\n", ex.what());
+    }
+}
+
+void Daemon::HandleHttpRequest(Connection& conn, const std::string& request)
+{
+    // GET /path?query HTTP/1.1
+    vector<string> parts;
+    StringUtils::Split(parts, request, ' ', StringUtils::SplitFlags::RemoveEmptyEntries);
+    if (parts.size() < 2 || parts[0] != "GET")
+    {
+        WriteHttpResponse(conn, 400, "text/plain", "bad request\n");
+        return;
+    }
+
+    auto question = parts[1].find('?');
+    auto path = parts[1].substr(0, question);
+    auto query = question == string::npos ? string() : parts[1].substr(question + 1);
+
+    if (path != "/debug/pprof/profile" && path != "/debug/pprof/snapshot")
+    {
+        WriteHttpResponse(conn, 404, "text/plain", "not found\n");
+        return;
+    }
+
+    try
+    {
+        auto pid = ParseNumber(GetQueryParameter(query, "pid"), "pid");
+        auto& target = FindTarget(pid);
+
+        if (path == "/debug/pprof/profile")
+        {
+            auto secondsText = GetQueryParameter(query, "seconds");
+            auto seconds = secondsText.empty() ? DEFAULT_PROFILE_SECONDS :
+                static_cast<uint32_t>(ParseNumber(secondsText, "seconds"));
+
+            // 在采样窗口结束时应答
+            conn.WindowPid = pid;
+            conn.Window.reset(new Profile());
+            InitProfile(target, *conn.Window);
+            conn.WindowEnd = Clock::now() + chrono::seconds(seconds);
+            if (!target.Running)
+                target.NextSample = Clock::now();
+            return;
+        }
+
+        // /debug/pprof/snapshot
+        auto format = GetQueryParameter(query, "format");
+        auto body = RenderProfile(target.Samples, format.empty() ? string("pprof") : format);
+        WriteHttpResponse(conn, 200, format == "folded" ? "text/plain" : "application/octet-stream", body);
+    }
+    catch (const ObjectNotFoundException& ex)
+    {
+        WriteHttpResponse(conn, 404, "text/plain", ex.GetDescription() + "\n");
+    }
+    catch (const ExceptionBase& ex)
+    {
+        WriteHttpResponse(conn, 400, "text/plain", ex.GetDescription() + "\n");
+    }
+}
+
+void Daemon::WriteHttpResponse(Connection& conn, int status, const std::string& contentType,
+    const std::string& body)
+{
+    conn.Output.append(StringUtils::Format("HTTP/1.1 {0} {1}\r\nContent-Type: {2}\r\nContent-Length: {3}\r\n"
+        "Connection: close\r\n\r\n", status, GetHttpStatusText(status), contentType, body.size()));
+    conn.Output.append(body);
+    conn.Closing = true;
+    Send(conn);
+}
+
+Daemon::Target& Daemon::FindTarget(uint64_t pid)
+{
+    for (const auto& target : m_stTargets)
+    {
+        if (target->Pid == pid)
+            return *target;
+    }
+    MOE_THROW(ObjectNotFoundException, "Not attached to {0}", pid);
+}
+
+void Daemon::InitProfile(const Target& target, Profile& profile)const
+{
+    profile.SetPeriod(static_cast<uint64_t>(target.Interval) * 1000000u);
+    profile.SetStartTime(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch()).count()));
+    for (const auto& mapping : target.Options.Mappings)
+        profile.AddMapping(mapping.Start, mapping.End, mapping.Offset, mapping.Path);
+    for (const auto& label : target.Options.Labels)
+        profile.SetLabel(label.first, label.second);
+}
+
+std::string Daemon::RenderProfile(Profile& profile, const std::string& format)const
+{
+    auto now = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch()).count());
+    if (now > profile.GetStartTime())
+        profile.SetDuration(now - profile.GetStartTime());
+
+    ostringstream out;
+    if (format == "pprof")
+        WritePProf(profile, out);
+    else if (format == "folded")
+        WriteFoldedProfile(profile, out);
+    else if (format == "binary")
+        WriteBinaryProfile(profile, nullptr, out);
+    else
+        MOE_THROW(BadArgumentException, "Unknown format {0}", format);
+    return out.str();
+}
+
+int Daemon::GetPollTimeout(Clock::time_point now)const
+{
+    auto next = now + chrono::milliseconds(m_stTargets.empty() ? MAX_POLL_TIMEOUT : TARGET_POLL_TIMEOUT);
+    for (const auto& target : m_stTargets)
+    {
+        bool windowed = any_of(m_stConnections.begin(), m_stConnections.end(),
+            [&](const unique_ptr<Connection>& conn) { return conn->Window && conn->WindowPid == target->Pid; });
+        if (target->Running || windowed)
+            next = min(next, target->NextSample);
+    }
+    for (const auto& conn : m_stConnections)
+    {
+        if (conn->Window)
+            next = min(next, conn->WindowEnd);
+    }
+
+    if (next <= now)
+        return 0;
+    return static_cast<int>(chrono::duration_cast<chrono::milliseconds>(next - now).count()) + 1;
+}
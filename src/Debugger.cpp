@@ -7,6 +7,7 @@
  * @see http://sigalrm.blogspot.com/2010/07/writing-minimal-debugger.html
  */
 #include "Debugger.hpp"
+#include "RemoteLuaWrapper.hpp"
 
 #include <Moe.Core/Logging.hpp>
 
@@ -14,11 +15,16 @@ extern "C" {
 #include <pmparser.h>
 }
 
+#include <map>
+#include <algorithm>
 #include <unistd.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/user.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <sys/ptrace.h>
 #include <sys/syscall.h>
 #include <sys/wait.h>
@@ -27,6 +33,16 @@ using namespace std;
 using namespace moe;
 using namespace lperf;
 
+namespace
+{
+    // linux/ptrace.h 中的 PTRACE_EVENT_STOP，该头文件不能与 sys/ptrace.h 同时包含
+    const int PTRACE_EVENT_STOP_CODE = 128;
+
+    // pmparser 的解析状态是全局的；遍历时直接沿链表进行，不使用 pmparser_next 的全局游标，
+    // 否则提前退出遍历会使游标指向已释放的节点
+    std::mutex s_stProcMapsLock;
+}
+
 //////////////////////////////////////////////////////////////////////////////// Breakpoint
 
 Breakpoint::Breakpoint(Debugger& dbg, uintptr_t address)
@@ -88,17 +104,48 @@ void Breakpoint::Disable()
     MOE_LOG_INFO("Breakpoint disabled, address {0}", m_uAddress);
 }
 
-//////////////////////////////////////////////////////////////////////////////// Debugger
+//////////////////////////////////////////////////////////////////////////////// DebugSymbols
 
-Debugger::Debugger(ProcessId pid, bool interrupt)
-    : m_uPid(pid)
+std::shared_ptr<DebugSymbols> DebugSymbols::Load(ProcessId pid)
 {
+    static mutex s_stLock;
+    static map<pair<dev_t, ino_t>, weak_ptr<DebugSymbols>> s_stLoaded;
+
     // 打开可执行文件
     string path = StringUtils::Format("/proc/{0}/exe", pid);
     auto fd = open(path.c_str(), O_RDONLY);
     if (fd == -1)
         MOE_THROW(ApiException, "Open executable file \"{0}\" error, errno={1}({2})", path, errno, strerror(errno));
-    
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        MOE_THROW(ApiException, "Stat executable file \"{0}\" error, errno={1}({2})", path, errno, strerror(errno));
+    }
+
+    // 加载期间持有锁，同时挂接的多个进程只加载一次
+    lock_guard<mutex> guard(s_stLock);
+    auto key = make_pair(st.st_dev, st.st_ino);
+    auto it = s_stLoaded.find(key);
+    if (it != s_stLoaded.end())
+    {
+        auto ret = it->second.lock();
+        if (ret)
+        {
+            MOE_LOG_DEBUG("Reuse debug symbols of process {0}", pid);
+            ::close(fd);
+            return ret;
+        }
+    }
+
+    auto ret = make_shared<DebugSymbols>(fd);
+    s_stLoaded[key] = ret;
+    return ret;
+}
+
+DebugSymbols::DebugSymbols(int fd)
+{
     m_stElfParser = elf::elf(elf::create_mmap_loader(fd));  // FIXME: leak fd?
     try
     {
@@ -109,8 +156,89 @@ Debugger::Debugger(ProcessId pid, bool interrupt)
         MOE_LOG_WARN("Load dwarf error: {0}", ex.what());
         m_stDwarfParser = dwarf::dwarf();
     }
+}
+
+const std::string& DebugSymbols::GetFunctionName(uintptr_t address)
+{
+    // 条目只增不减，返回的引用在加锁之外仍然有效
+    lock_guard<mutex> guard(m_stLock);
+
+    auto it = m_stSymbolCacheMap.find(address);
+    if (it != m_stSymbolCacheMap.end())
+        return it->second;
+
+    for (auto& cu : m_stDwarfParser.compilation_units())
+    {
+        if (!cu.root().has(dwarf::DW_AT::low_pc))
+            continue;
+
+        if (dwarf::die_pc_range(cu.root()).contains(address))
+        {
+            for (const auto& die : cu.root())
+            {
+                if (die.has(dwarf::DW_AT::low_pc) && die.has(dwarf::DW_AT::name))
+                {
+                    if (dwarf::die_pc_range(die).contains(address))
+                    {
+                        auto name = dwarf::at_name(die);
+                        m_stSymbolCacheMap.emplace(address, std::move(name));
+                        return m_stSymbolCacheMap[address];
+                    }
+                }
+            }
+        }
+    }
+
+    m_stSymbolCacheMap.emplace(address, string());
+    return m_stSymbolCacheMap[address];
+}
+
+uintptr_t DebugSymbols::FindFunction(const char* func, bool skipPrologue)
+{
+    lock_guard<mutex> guard(m_stLock);
+
+    for (const auto& cu : m_stDwarfParser.compilation_units())
+    {
+        for (const auto& die : cu.root())
+        {
+            if (die.has(dwarf::DW_AT::name) && dwarf::at_name(die) == func)
+            {
+                auto pc = at_low_pc(die);
+                auto entry = GetLineEntryFromPC(pc);
+                if (skipPrologue)
+                    ++entry;  // skip prologue
+                return entry->address;
+            }
+        }
+    }
+    MOE_THROW(ObjectNotFoundException, "Function {0} not found", func);
+}
+
+dwarf::line_table::iterator DebugSymbols::GetLineEntryFromPC(uint64_t pc)
+{
+    for (const auto& cu : m_stDwarfParser.compilation_units())
+    {
+        if (dwarf::die_pc_range(cu.root()).contains(pc))
+        {
+            const auto& lt = cu.get_line_table();
+            const auto it = lt.find_address(pc);
+            if (it == lt.end())
+                MOE_THROW(ObjectNotFoundException, "Cannot find line entry");
+            else
+                return it;
+        }
+    }
+    MOE_THROW(ObjectNotFoundException, "Cannot find line entry");
+}
+
+//////////////////////////////////////////////////////////////////////////////// Debugger
 
-    if (m_stElfParser.get_hdr().type == elf::et::dyn)
+Debugger::Debugger(ProcessId pid, bool interrupt)
+    : m_uPid(pid)
+{
+    // 加载调试符号
+    m_pSymbols = DebugSymbols::Load(pid);
+    if (m_pSymbols->GetElf().get_hdr().type == elf::et::dyn)
         GetProcessBaseAddress();
 
     // 挂到进程上
@@ -211,6 +339,65 @@ bool Debugger::Wait()
     return true;
 }
 
+bool Debugger::Poll()
+{
+    if (m_uStatus == ProcessStatus::Terminated)
+        return false;
+    if (m_uStatus != ProcessStatus::Running)
+        return true;
+
+    while (true)
+    {
+        int status = 0;
+        auto progeny = ::waitpid(static_cast<pid_t>(m_uPid), &status, WNOHANG | __WALL);
+        if (progeny == 0)
+            return true;
+        if (progeny < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == ECHILD)  // 已被回收
+            {
+                m_uStatus = ProcessStatus::Terminated;
+                return false;
+            }
+            MOE_THROW(ApiException, "Poll process {0} error, errno={1}({2})", m_uPid, errno, strerror(errno));
+        }
+
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+        {
+            m_uStatus = ProcessStatus::Terminated;
+            m_iLastSignal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+            m_iExitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 0;
+            MOE_LOG_TRACE("Process {0} terminated", m_uPid);
+            return false;
+        }
+        if (!WIFSTOPPED(status))
+            continue;
+
+        auto signum = WSTOPSIG(status);
+        if ((status >> 16) == PTRACE_EVENT_STOP_CODE)
+        {
+            // group-stop 保持停止但不占用 ptrace-stop；其余的事件停止（如残留的打断）不携带信号
+            if (signum == SIGSTOP || signum == SIGTSTP || signum == SIGTTIN || signum == SIGTTOU)
+            {
+                MOE_LOG_TRACE("Process {0} group-stopped on signal {1}", m_uPid, signum);
+                if (::ptrace(PTRACE_LISTEN, m_uPid, 0, 0) != 0)
+                {
+                    MOE_THROW(ApiException, "Listen on process {0} error, errno={1}({2})", m_uPid, errno,
+                        strerror(errno));
+                }
+                continue;
+            }
+            signum = 0;
+        }
+
+        MOE_LOG_TRACE("Process {0} stopped on signal {1}, deliver it", m_uPid, signum);
+        if (::ptrace(PTRACE_CONT, m_uPid, 0, signum) != 0)
+            MOE_THROW(ApiException, "Continue on process {0} error, errno={1}({2})", m_uPid, errno, strerror(errno));
+    }
+}
+
 void Debugger::Interrupt()
 {
     if (::ptrace(PTRACE_INTERRUPT, m_uPid, 0, 0) != 0)
@@ -473,28 +660,31 @@ uint8_t Debugger::ReadByte(uintptr_t address)
     return reinterpret_cast<const uint8_t*>(&data)[0];
 }
 
-std::string Debugger::ReadString(uintptr_t address, size_t maxlen)
+std::string Debugger::ReadString(uintptr_t address, size_t maxlen)const
 {
-    string ret;
-    ret.reserve(128);
+    auto pageSize = MemoryAccessorBase<>::GetPageSize();
 
-    size_t offset = 0;
-    while (offset < maxlen)
+    // 每次读取到页的边界为止，避免因下一页不可读而失败；在读到的整段中查找结尾
+    string ret;
+    while (ret.size() < maxlen)
     {
-        auto val = Read(address + offset);
-        auto b = reinterpret_cast<const uint8_t*>(&val);
-        for (auto i = 0; i < sizeof(val); ++i)
+        auto current = address + ret.size();
+        auto chunk = min(pageSize - (current & (pageSize - 1)), maxlen - ret.size());
+
+        auto offset = ret.size();
+        ret.resize(offset + chunk);
+        auto sz = ReadMemory(current, reinterpret_cast<uint8_t*>(&ret[offset]), chunk);
+        if (sz == 0)
+            MOE_THROW(ApiException, "Read string on process {0} error, address={1}", m_uPid, current);
+
+        auto end = ::memchr(&ret[offset], 0, sz);
+        if (end)
         {
-            auto ch = b[i];
-            if (ch == 0)
-                return ret;
-            ret.push_back(static_cast<char>(ch));
+            ret.resize(static_cast<size_t>(static_cast<const char*>(end) - ret.data()));
+            return ret;
         }
-        offset += sizeof(val);
+        ret.resize(offset + sz);
     }
-
-    if (ret.size() > maxlen)
-        ret.resize(maxlen);
     return ret;
 }
 
@@ -514,6 +704,56 @@ size_t Debugger::ReadBytes(uintptr_t address, uint8_t buffer[], size_t count)
     return count;
 }
 
+size_t Debugger::ReadMemory(uintptr_t address, uint8_t buffer[], size_t count)const
+{
+    size_t offset = 0;
+    while (offset < count)
+    {
+        struct iovec local = { buffer + offset, count - offset };
+        struct iovec remote = { reinterpret_cast<void*>(address + offset), count - offset };
+        auto ret = ::process_vm_readv(static_cast<pid_t>(m_uPid), &local, 1, &remote, 1, 0);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (offset > 0 || errno == EFAULT)
+                break;
+            MOE_THROW(ApiException, "Read memory of process {0} error, address={1}, errno={2}({3})", m_uPid,
+                address, errno, strerror(errno));
+        }
+        if (ret == 0)
+            break;
+        offset += static_cast<size_t>(ret);
+    }
+    return offset;
+}
+
+size_t Debugger::ReadMemory(const struct iovec* local, const struct iovec* remote, size_t count)const
+{
+    // 每次调用各取一段本地与远端范围，两侧总长度相同，因此只需一一对应
+    size_t ret = 0;
+    for (size_t i = 0; i < count; i += IOV_MAX)
+    {
+        auto batch = min<size_t>(count - i, IOV_MAX);
+        size_t expected = 0;
+        for (size_t j = 0; j < batch; ++j)
+            expected += remote[i + j].iov_len;
+
+        auto sz = ::process_vm_readv(static_cast<pid_t>(m_uPid), local + i, batch, remote + i, batch, 0);
+        if (sz < 0)
+        {
+            if (errno == EFAULT)
+                return ret;
+            MOE_THROW(ApiException, "Read memory of process {0} error, errno={1}({2})", m_uPid, errno,
+                strerror(errno));
+        }
+        ret += static_cast<size_t>(sz);
+        if (static_cast<size_t>(sz) != expected)
+            break;
+    }
+    return ret;
+}
+
 void Debugger::Write(uintptr_t address, Word data)
 {
     if (m_uStatus != ProcessStatus::Paused)
@@ -561,21 +801,7 @@ Breakpoint* Debugger::CreateBreakpoint(uintptr_t address)
 
 Breakpoint* Debugger::CreateBreakpoint(const char* func, bool skipPrologue)
 {
-    for (const auto& cu : m_stDwarfParser.compilation_units())
-    {
-        for (const auto& die : cu.root())
-        {
-            if (die.has(dwarf::DW_AT::name) && dwarf::at_name(die) == func)
-            {
-                auto pc = at_low_pc(die);
-                auto entry = GetLineEntryFromPC(pc);
-                if (skipPrologue)
-                    ++entry;  // skip prologue
-                return CreateBreakpoint(entry->address + m_uAddressOffset);
-            }
-        }
-    }
-    MOE_THROW(ObjectNotFoundException, "Function {0} not found", func);
+    return CreateBreakpoint(m_pSymbols->FindFunction(func, skipPrologue) + m_uAddressOffset);
 }
 
 Breakpoint* Debugger::GetBreakpoint(uintptr_t address)
@@ -603,36 +829,80 @@ void Debugger::RemoveBreakpoint(Breakpoint* breakpoint)
 
 const std::string& Debugger::GetFunctionName(uintptr_t address)
 {
-    address -= GetAddressOffset();
+    return m_pSymbols->GetFunctionName(address - GetAddressOffset());
+}
 
-    auto it = m_stSymbolCacheMap.find(address);
-    if (it != m_stSymbolCacheMap.end())
-        return it->second;
+std::vector<MemoryMapping> Debugger::GetExecutableMappings()
+{
+    lock_guard<mutex> guard(s_stProcMapsLock);
+    procmaps_struct* maps = pmparser_parse(static_cast<int>(m_uPid));
+    if (!maps)
+        MOE_THROW(ApiException, "Cannot parse memory map of process {0}", m_uPid);
 
-    for (auto& cu : m_stDwarfParser.compilation_units())
+    vector<MemoryMapping> ret;
+    for (auto p = maps; p != nullptr; p = p->next)
     {
-        if (!cu.root().has(dwarf::DW_AT::low_pc))
+        if (!p->is_x)
             continue;
 
-        if (dwarf::die_pc_range(cu.root()).contains(address))
-        {
-            for (const auto& die : cu.root())
-            {
-                if (die.has(dwarf::DW_AT::low_pc) && die.has(dwarf::DW_AT::name))
-                {
-                    if (dwarf::die_pc_range(die).contains(address))
-                    {
-                        auto name = dwarf::at_name(die);
-                        m_stSymbolCacheMap.emplace(address, std::move(name));
-                        return m_stSymbolCacheMap[address];
-                    }
-                }
-            }
-        }
+        MemoryMapping mapping;
+        mapping.Start = reinterpret_cast<uintptr_t>(p->addr_start);
+        mapping.End = reinterpret_cast<uintptr_t>(p->addr_end);
+        mapping.Offset = static_cast<uintptr_t>(p->offset);
+        mapping.Path = p->pathname;
+        ret.emplace_back(std::move(mapping));
     }
 
-    m_stSymbolCacheMap.emplace(address, string());
-    return m_stSymbolCacheMap[address];
+    pmparser_free(maps);
+    return ret;
+}
+
+std::string Debugger::GetBuildId()
+{
+    const auto& section = m_pSymbols->GetElf().get_section(".note.gnu.build-id");
+    if (!section.valid() || section.size() < 12)
+        return string();
+
+    // Elf_Nhdr: namesz, descsz, type，之后为4字节对齐的名称与描述
+    auto data = static_cast<const uint8_t*>(section.data());
+    uint32_t nameSize = 0, descSize = 0;
+    memcpy(&nameSize, data, sizeof(nameSize));
+    memcpy(&descSize, data + 4, sizeof(descSize));
+    size_t descOffset = 12 + ((static_cast<size_t>(nameSize) + 3) & ~static_cast<size_t>(3));
+    if (descOffset + descSize > section.size())
+        return string();
+
+    static const char HEX[] = "0123456789abcdef";
+    string ret;
+    ret.reserve(descSize * 2);
+    for (size_t i = 0; i < descSize; ++i)
+    {
+        auto b = data[descOffset + i];
+        ret.push_back(HEX[b >> 4]);
+        ret.push_back(HEX[b & 0xF]);
+    }
+    return ret;
+}
+
+std::string Debugger::GetCommandLine()
+{
+    string path = StringUtils::Format("/proc/{0}/cmdline", m_uPid);
+    auto fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        MOE_THROW(ApiException, "Open \"{0}\" error, errno={1}({2})", path, errno, strerror(errno));
+
+    string ret;
+    char buffer[1024];
+    size_t count = 0;
+    while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        ret.append(buffer, count);
+    fclose(fp);
+
+    // 参数以'\0'分隔
+    while (!ret.empty() && ret.back() == '\0')
+        ret.pop_back();
+    replace(ret.begin(), ret.end(), '\0', ' ');
+    return ret;
 }
 
 void Debugger::GetProcessBaseAddress()
@@ -643,12 +913,12 @@ void Debugger::GetProcessBaseAddress()
     if (!realpath(path.c_str(), real))
         MOE_THROW(ApiException, "Cannot get real path of process {0}", m_uPid);
 
+    lock_guard<mutex> guard(s_stProcMapsLock);
     procmaps_struct* maps = pmparser_parse(m_uPid);
     if (!maps)
         MOE_THROW(ApiException, "Cannot parse memory map of process {0}", m_uPid);
 
-    procmaps_struct* p = nullptr;
-    while ((p = pmparser_next()) != nullptr)
+    for (auto p = maps; p != nullptr; p = p->next)
     {
         if (p->is_x && strcmp(real, p->pathname) == 0)  // FIXME: p->pathname can only contain 600 bytes
         {
@@ -689,19 +959,55 @@ bool Debugger::StepOverBreakpoint()
     return false;
 }
 
-dwarf::line_table::iterator Debugger::GetLineEntryFromPC(uint64_t pc)
+//////////////////////////////////////////////////////////////////////////////// FindProcesses
+
+std::vector<ProcessId> lperf::FindProcesses(const std::string& name)
 {
-    for (const auto& cu : m_stDwarfParser.compilation_units())
+    auto dir = ::opendir("/proc");
+    if (!dir)
+        MOE_THROW(ApiException, "Open /proc error, errno={0}({1})", errno, strerror(errno));
+
+    vector<ProcessId> ret;
+    auto self = static_cast<ProcessId>(::getpid());
+    struct dirent* entry = nullptr;
+    while ((entry = ::readdir(dir)) != nullptr)
     {
-        if (dwarf::die_pc_range(cu.root()).contains(pc))
+        char* end = nullptr;
+        auto pid = static_cast<ProcessId>(strtoull(entry->d_name, &end, 10));
+        if (pid == 0 || *end != '\0' || pid == self)
+            continue;
+
+        // 进程名
+        string comm;
+        auto fp = fopen(StringUtils::Format("/proc/{0}/comm", pid).c_str(), "rb");
+        if (fp)
         {
-            const auto& lt = cu.get_line_table();
-            const auto it = lt.find_address(pc);
-            if (it == lt.end())
-                MOE_THROW(ObjectNotFoundException, "Cannot find line entry");
-            else
-                return it;
+            char buffer[64] = {};
+            if (fgets(buffer, sizeof(buffer), fp))
+                comm = buffer;
+            fclose(fp);
+            while (!comm.empty() && comm.back() == '\n')
+                comm.pop_back();
         }
+
+        // 可执行文件的文件名（进程名最长只有15个字符）
+        string exe;
+        char link[PATH_MAX];
+        auto len = ::readlink(StringUtils::Format("/proc/{0}/exe", pid).c_str(), link, sizeof(link) - 1);
+        if (len > 0)
+        {
+            link[len] = '\0';
+            exe = link;
+            auto pos = exe.rfind('/');
+            if (pos != string::npos)
+                exe = exe.substr(pos + 1);
+        }
+
+        if (comm == name || exe == name)
+            ret.push_back(pid);
     }
-    MOE_THROW(ObjectNotFoundException, "Cannot find line entry");
+    ::closedir(dir);
+
+    sort(ret.begin(), ret.end());
+    return ret;
 }
@@ -0,0 +1,301 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "FlameGraph.hpp"
+#include "Report.hpp"
+
+#include <ostream>
+#include <algorithm>
+#include <cinttypes>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+namespace
+{
+    const unsigned PADDING_X = 10;
+    const unsigned PADDING_TOP = 40;
+    const unsigned PADDING_BOTTOM = 30;
+    const unsigned FONT_SIZE = 12;
+    const double FONT_WIDTH = 0.59;  // 字符宽度与字号之比的估计值
+
+    const char* const FLAMEGRAPH_SCRIPT = R"(<script type="text/ecmascript"><![CDATA[
+(function() {
+    var svg = document.getElementById('flamegraph');
+    var frames = svg.querySelectorAll('g.f');
+    var details = document.getElementById('details');
+    var width = +svg.getAttribute('data-w'), pad = +svg.getAttribute('data-p');
+    var fontWidth = +svg.getAttribute('data-fw');
+    function fit(g, w) {
+        var t = g.querySelector('text'), n = g.getAttribute('data-n');
+        var c = Math.floor((w - 6) / fontWidth);
+        t.textContent = c < 3 ? '' : (n.length <= c ? n : n.substring(0, c - 2) + '..');
+    }
+    function zoom(target) {
+        var zx = target ? +target.getAttribute('data-x') : 0, zw = target ? +target.getAttribute('data-w') : 1;
+        var zd = target ? +target.getAttribute('data-d') : 0, scale = (width - 2 * pad) / zw;
+        for (var i = 0; i < frames.length; ++i) {
+            var g = frames[i], x = +g.getAttribute('data-x'), w = +g.getAttribute('data-w');
+            var d = +g.getAttribute('data-d'), r = g.querySelector('rect'), t = g.querySelector('text');
+            var visible = true;
+            if (d < zd) {
+                visible = x <= zx && x + w >= zx + zw;
+                x = zx; w = zw;
+            } else if (x + w <= zx || x >= zx + zw) {
+                visible = false;
+            }
+            g.style.display = visible ? '' : 'none';
+            if (!visible)
+                continue;
+            var nx = pad + (x - zx) * scale, nw = w * scale;
+            r.setAttribute('x', nx);
+            r.setAttribute('width', nw);
+            t.setAttribute('x', nx + 3);
+            fit(g, nw);
+        }
+    }
+    for (var i = 0; i < frames.length; ++i) {
+        frames[i].onclick = function() { zoom(this); };
+        frames[i].onmouseover = function() { details.textContent = this.querySelector('title').textContent; };
+        frames[i].onmouseout = function() { details.textContent = ' '; };
+    }
+    document.getElementById('unzoom').onclick = function() { zoom(null); };
+})();
+]]></script>
+)";
+
+    void WriteXmlEscaped(std::ostream& out, const std::string& str)
+    {
+        for (auto c : str)
+        {
+            switch (c)
+            {
+                case '&':
+                    out << "&amp;";
+                    break;
+                case '<':
+                    out << "&lt;";
+                    break;
+                case '>':
+                    out << "&gt;";
+                    break;
+                case '"':
+                    out << "&quot;";
+                    break;
+                default:
+                    out.put(c);
+                    break;
+            }
+        }
+    }
+
+    /**
+     * @brief 按帧类型选取颜色，同名的帧颜色一致
+     */
+    string PickColor(LuaFunctionType type, const std::string& name)
+    {
+        auto hash = std::hash<std::string>()(name);
+        auto v1 = (hash & 0xFF) / 255.;
+        auto v2 = ((hash >> 8) & 0xFF) / 255.;
+
+        unsigned r = 0, g = 0, b = 0;
+        switch (type)
+        {
+            case LuaFunctionType::Lua:  // 暖色
+                r = 205 + static_cast<unsigned>(50 * v1);
+                g = static_cast<unsigned>(230 * v2);
+                b = 55;
+                break;
+            case LuaFunctionType::Native:  // 蓝色
+                r = 50 + static_cast<unsigned>(60 * v1);
+                g = 150 + static_cast<unsigned>(60 * v2);
+                b = 215;
+                break;
+            case LuaFunctionType::VirtualMachine:  // 绿色
+                r = 80 + static_cast<unsigned>(60 * v1);
+                g = 190 + static_cast<unsigned>(55 * v2);
+                b = 80;
+                break;
+            case LuaFunctionType::Unknown:
+            default:
+                r = g = b = 160 + static_cast<unsigned>(40 * v1);
+                break;
+        }
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "rgb(%u,%u,%u)", r, g, b);
+        return buffer;
+    }
+
+    /**
+     * @brief 经过剪枝后需要绘制的节点
+     */
+    struct FlameNode
+    {
+        ProfileId Stack;  // INVALID_PROFILE_ID 表示根节点
+        unsigned Depth;
+        uint64_t X;  // 以采样数为单位的横坐标
+        uint64_t Total;
+    };
+}
+
+void lperf::WriteFlameGraph(const Profile& profile, std::ostream& out, const FlameGraphOptions& options)
+{
+    auto stackCount = profile.GetStackCount();
+
+    // 父节点的ID总是小于子节点，逆序遍历即可累计总计数
+    vector<uint64_t> totals(stackCount);
+    for (ProfileId i = 0; i < stackCount; ++i)
+        totals[i] = profile.GetSampleCount(i);
+    uint64_t rootTotal = 0;
+    for (auto i = stackCount; i > 0; --i)
+    {
+        auto parent = profile.GetStack(i - 1).Parent;
+        if (parent == INVALID_PROFILE_ID)
+            rootTotal += totals[i - 1];
+        else
+            totals[parent] += totals[i - 1];
+    }
+
+    // 按父节点分组子节点（下标0为根节点）
+    vector<size_t> childOffsets(stackCount + 2, 0);
+    for (ProfileId i = 0; i < stackCount; ++i)
+    {
+        auto parent = profile.GetStack(i).Parent;
+        ++childOffsets[(parent == INVALID_PROFILE_ID ? 0 : parent + 1) + 1];
+    }
+    for (size_t i = 1; i < childOffsets.size(); ++i)
+        childOffsets[i] += childOffsets[i - 1];
+    vector<ProfileId> children(stackCount);
+    {
+        auto cursor = childOffsets;
+        for (ProfileId i = 0; i < stackCount; ++i)
+        {
+            auto parent = profile.GetStack(i).Parent;
+            children[cursor[parent == INVALID_PROFILE_ID ? 0 : parent + 1]++] = i;
+        }
+    }
+
+    vector<string> names(profile.GetFrameCount());
+    for (ProfileId i = 0; i < profile.GetFrameCount(); ++i)
+        names[i] = FormatProfileFrame(profile, profile.GetFrame(i));
+
+    // 深度优先布局，同时剪除不足最小宽度的子树
+    auto scale = rootTotal == 0 ? 0. : static_cast<double>(options.Width - 2 * PADDING_X) / rootTotal;
+    auto minTotal = options.MinWidth <= 0 || scale == 0 ? 0. : options.MinWidth / scale;
+    vector<FlameNode> nodes;
+    vector<FlameNode> pending;
+    unsigned maxDepth = 0;
+    pending.push_back(FlameNode { INVALID_PROFILE_ID, 0, 0, rootTotal });
+    while (!pending.empty())
+    {
+        auto node = pending.back();
+        pending.pop_back();
+        nodes.push_back(node);
+        maxDepth = std::max(maxDepth, node.Depth);
+
+        auto index = node.Stack == INVALID_PROFILE_ID ? 0 : node.Stack + 1;
+        auto begin = children.begin() + childOffsets[index];
+        auto end = children.begin() + childOffsets[index + 1];
+        sort(begin, end, [&](ProfileId a, ProfileId b) {
+            return names[profile.GetStack(a).Frame] < names[profile.GetStack(b).Frame];
+        });
+
+        // 子节点从左侧开始排布，自身计数留在右侧
+        auto x = node.X;
+        auto first = pending.size();
+        for (auto it = begin; it != end; ++it)
+        {
+            auto total = totals[*it];
+            if (total == 0)
+                continue;
+            if (total >= minTotal)
+                pending.push_back(FlameNode { *it, node.Depth + 1, x, total });
+            x += total;
+        }
+        std::reverse(pending.begin() + first, pending.end());
+    }
+
+    // 输出
+    auto height = PADDING_TOP + PADDING_BOTTOM + (maxDepth + 1) * options.FrameHeight;
+    auto fontWidth = FONT_SIZE * FONT_WIDTH;
+    if (options.Html)
+    {
+        out << "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>";
+        WriteXmlEscaped(out, options.Title);
+        out << "</title>\n</head>\n<body style=\"margin:0\">\n";
+    }
+    else
+        out << "<?xml version=\"1.0\" standalone=\"no\"?>\n";
+
+    out << "<svg id=\"flamegraph\" version=\"1.1\" xmlns=\"http://www.w3.org/2000/svg\" width=\"" << options.Width <<
+        "\" height=\"" << height << "\" viewBox=\"0 0 " << options.Width << " " << height << "\" data-w=\"" <<
+        options.Width << "\" data-p=\"" << PADDING_X << "\" data-fw=\"" << fontWidth << "\">\n";
+    out << "<style>text{font-family:Verdana,sans-serif;font-size:" << FONT_SIZE << "px;fill:#000}"
+        "g.f{cursor:pointer}g.f:hover rect{stroke:#000;stroke-width:0.5}</style>\n";
+    out << "<rect x=\"0\" y=\"0\" width=\"100%\" height=\"100%\" fill=\"#f8f8f8\"/>\n";
+    out << "<text x=\"" << options.Width / 2 << "\" y=\"24\" text-anchor=\"middle\" style=\"font-size:17px\">";
+    WriteXmlEscaped(out, options.Title);
+    out << "</text>\n";
+    out << "<text id=\"unzoom\" x=\"" << PADDING_X << "\" y=\"24\" style=\"cursor:pointer\">Reset Zoom</text>\n";
+    out << "<text id=\"details\" x=\"" << PADDING_X << "\" y=\"" << height - 10 << "\"> </text>\n";
+
+    string name;
+    char buffer[64];
+    for (const auto& node : nodes)
+    {
+        LuaFunctionType type = LuaFunctionType::Unknown;
+        if (node.Stack == INVALID_PROFILE_ID)
+            name = "all";
+        else
+        {
+            const auto& frame = profile.GetFrame(profile.GetStack(node.Stack).Frame);
+            type = frame.Type;
+            name = names[profile.GetStack(node.Stack).Frame];
+        }
+
+        auto x = PADDING_X + node.X * scale;
+        auto w = node.Total * scale;
+        auto y = height - PADDING_BOTTOM - (node.Depth + 1) * options.FrameHeight;
+
+        out << "<g class=\"f\" data-x=\"" << node.X << "\" data-w=\"" << node.Total << "\" data-d=\"" <<
+            node.Depth << "\" data-n=\"";
+        WriteXmlEscaped(out, name);
+        out << "\"><title>";
+        WriteXmlEscaped(out, name);
+        snprintf(buffer, sizeof(buffer), " (%" PRIu64 " samples, %.2f%%)", node.Total,
+            rootTotal == 0 ? 0. : node.Total * 100. / rootTotal);
+        out << buffer;
+        if (options.Detail && node.Stack != INVALID_PROFILE_ID)
+            WriteXmlEscaped(out, options.Detail(node.Stack));
+        out << "</title>";
+
+        snprintf(buffer, sizeof(buffer), "x=\"%.2f\" y=\"%u\" width=\"%.2f\" height=\"%u\"", x, y, w,
+            options.FrameHeight - 1);
+        out << "<rect " << buffer << " rx=\"2\" fill=\"" << (options.Color && node.Stack != INVALID_PROFILE_ID ?
+            options.Color(node.Stack) : PickColor(type, name)) << "\"/>";
+
+        snprintf(buffer, sizeof(buffer), "x=\"%.2f\" y=\"%.1f\"", x + 3, y + options.FrameHeight * 0.75);
+        out << "<text " << buffer << ">";
+        auto fit = static_cast<size_t>(std::max(0., (w - 6) / fontWidth));
+        if (fit >= 3)
+        {
+            if (name.size() <= fit)
+                WriteXmlEscaped(out, name);
+            else
+            {
+                WriteXmlEscaped(out, name.substr(0, fit - 2));
+                out << "..";
+            }
+        }
+        out << "</text></g>\n";
+    }
+
+    out << FLAMEGRAPH_SCRIPT;
+    out << "</svg>\n";
+    if (options.Html)
+        out << "</body>\n</html>\n";
+    out.flush();
+}
@@ -0,0 +1,107 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "GzipStream.hpp"
+
+#include <ostream>
+#include <fstream>
+#include <cstring>
+
+#include <Moe.Core/Exception.hpp>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+static const size_t GZIP_CHUNK_SIZE = 64 * 1024;
+
+GzipOutputStream::GzipOutputStream(std::ostream& out, int level)
+    : m_stOutput(out), m_stBuffer(GZIP_CHUNK_SIZE)
+{
+    ::memset(&m_stStream, 0, sizeof(m_stStream));
+    auto ret = ::deflateInit2(&m_stStream, level, Z_DEFLATED, 15 + 16 /* gzip header */, 8, Z_DEFAULT_STRATEGY);
+    if (ret != Z_OK)
+        MOE_THROW(ApiException, "Initialize zlib error, ret={0}", ret);
+}
+
+GzipOutputStream::~GzipOutputStream()
+{
+    ::deflateEnd(&m_stStream);
+}
+
+void GzipOutputStream::Write(const void* data, size_t size)
+{
+    if (m_bFinished)
+        MOE_THROW(InvalidCallException, "Stream already finished");
+
+    m_stStream.next_in = static_cast<Bytef*>(const_cast<void*>(data));
+    m_stStream.avail_in = static_cast<uInt>(size);
+    Deflate(Z_NO_FLUSH);
+}
+
+void GzipOutputStream::Finish()
+{
+    if (m_bFinished)
+        return;
+
+    m_stStream.next_in = nullptr;
+    m_stStream.avail_in = 0;
+    Deflate(Z_FINISH);
+    m_bFinished = true;
+    m_stOutput.flush();
+}
+
+void GzipOutputStream::Deflate(int flush)
+{
+    do
+    {
+        m_stStream.next_out = m_stBuffer.data();
+        m_stStream.avail_out = static_cast<uInt>(m_stBuffer.size());
+
+        auto ret = ::deflate(&m_stStream, flush);
+        if (ret == Z_STREAM_ERROR)
+            MOE_THROW(ApiException, "Compress data error, ret={0}", ret);
+
+        auto produced = m_stBuffer.size() - m_stStream.avail_out;
+        if (produced > 0)
+            m_stOutput.write(reinterpret_cast<const char*>(m_stBuffer.data()), produced);
+        if (!m_stOutput)
+            MOE_THROW(ApiException, "Write compressed data error");
+    } while (m_stStream.avail_out == 0 || (flush == Z_FINISH && m_stStream.avail_in != 0));
+}
+
+bool lperf::IsGzipFile(const std::string& path)
+{
+    ifstream in(path, ios::in | ios::binary);
+    unsigned char magic[2] = {};
+    if (!in.read(reinterpret_cast<char*>(magic), sizeof(magic)))
+        return false;
+    return magic[0] == 0x1F && magic[1] == 0x8B;
+}
+
+void lperf::ReadGzipFile(const std::string& path, std::string& out)
+{
+    auto file = ::gzopen(path.c_str(), "rb");
+    if (!file)
+        MOE_THROW(ApiException, "Cannot open \"{0}\"", path);
+
+    out.clear();
+    vector<char> buffer(GZIP_CHUNK_SIZE);
+    while (true)
+    {
+        auto count = ::gzread(file, buffer.data(), static_cast<unsigned>(buffer.size()));
+        if (count < 0)
+        {
+            int err = 0;
+            string message = ::gzerror(file, &err);
+            ::gzclose(file);
+            MOE_THROW(BadFormatException, "Decompress \"{0}\" error: {1}", path, message);
+        }
+        if (count == 0)
+            break;
+        out.append(buffer.data(), static_cast<size_t>(count));
+    }
+    ::gzclose(file);
+}
@@ -0,0 +1,124 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "HeavyHitters.hpp"
+
+#include <cassert>
+#include <algorithm>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+static const char* const TAIL_FRAME_NAME = "(tail)";
+
+// 哈希表节点与有序集合节点的额外开销（估算）
+static const size_t ENTRY_OVERHEAD = 96;
+
+size_t HeavyHitterProfile::StackKeyHasher::operator()(const StackKey& key)const noexcept
+{
+    size_t ret = key.size();
+    for (auto frame : key)
+        ret ^= frame + 0x9E3779B9u + (ret << 6) + (ret >> 2);
+    return ret;
+}
+
+HeavyHitterProfile::HeavyHitterProfile(bool lineMode, size_t memoryCap)
+    : m_uMemoryCap(memoryCap), m_stDictionary(lineMode)
+{
+}
+
+void HeavyHitterProfile::AddSample(const std::vector<LuaStackFrame>& stack)
+{
+    ++m_uTotalSampleCount;
+
+    // 空栈与其他报告一样归入 (idle)，使总数与误差上限包含空闲的采样
+    m_stKeyBuffer.clear();
+    if (stack.empty())
+        m_stKeyBuffer.push_back(m_stDictionary.GetStack(m_stDictionary.InternIdleStack()).Frame);
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+        m_stKeyBuffer.push_back(m_stDictionary.InternFrame(*it));
+
+    auto leaf = m_stKeyBuffer.back();
+    if (m_stLeafCounts.size() <= leaf)
+        m_stLeafCounts.resize(leaf + 1);
+    ++m_stLeafCounts[leaf];
+
+    auto it = m_stEntries.find(m_stKeyBuffer);
+    if (it != m_stEntries.end())
+    {
+        m_stOrder.erase(make_pair(it->second.Count, &it->first));
+        ++it->second.Count;
+        m_stOrder.emplace(it->second.Count, &it->first);
+        return;
+    }
+
+    // 腾出空间后插入，新堆栈之前可能出现过的次数不超过淘汰下限
+    auto cost = GetEntryCost(m_stKeyBuffer);
+    while (!m_stEntries.empty() && m_uMemoryUsage + cost > m_uMemoryCap)
+        EvictMin();
+
+    auto ret = m_stEntries.emplace(m_stKeyBuffer, Entry());
+    auto& entry = ret.first->second;
+    entry.Count = m_uFloor + 1;
+    entry.Error = m_uFloor;
+    m_stOrder.emplace(entry.Count, &ret.first->first);
+    m_uMemoryUsage += cost;
+}
+
+uint64_t HeavyHitterProfile::BuildProfile(Profile& out)const
+{
+    // 复制字典，使栈帧ID保持一致
+    out = m_stDictionary;
+
+    vector<uint64_t> tail(m_stLeafCounts);
+    for (const auto& i : m_stEntries)
+    {
+        auto count = i.second.Count - i.second.Error;
+        if (count == 0)
+            continue;
+
+        auto stack = INVALID_PROFILE_ID;
+        for (auto frame : i.first)
+            stack = out.InternStack(stack, frame);
+        out.AddSample(stack, count);
+        tail[i.first.back()] -= count;
+    }
+
+    ProfileFrame tailFrame;
+    tailFrame.Type = LuaFunctionType::Unknown;
+    tailFrame.Name = out.InternString(TAIL_FRAME_NAME);
+    auto tailRoot = INVALID_PROFILE_ID;
+
+    uint64_t ret = 0;
+    for (ProfileId i = 0; i < tail.size(); ++i)
+    {
+        if (tail[i] == 0)
+            continue;
+        if (tailRoot == INVALID_PROFILE_ID)
+            tailRoot = out.InternStack(INVALID_PROFILE_ID, out.InternFrame(tailFrame));
+        out.AddSample(out.InternStack(tailRoot, i), tail[i]);
+        ret += tail[i];
+    }
+    return ret;
+}
+
+size_t HeavyHitterProfile::GetEntryCost(const StackKey& key)const noexcept
+{
+    return sizeof(StackKey) + sizeof(Entry) + key.size() * sizeof(ProfileId) + ENTRY_OVERHEAD;
+}
+
+void HeavyHitterProfile::EvictMin()
+{
+    auto min = m_stOrder.begin();
+    auto it = m_stEntries.find(*min->second);
+    assert(it != m_stEntries.end());
+
+    m_uFloor = std::max(m_uFloor, min->first);
+    m_uMemoryUsage -= GetEntryCost(it->first);
+    m_stOrder.erase(min);
+    m_stEntries.erase(it);
+    ++m_uEvictionCount;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "LiveTop.hpp"
+#include "Report.hpp"
+
+#include <cmath>
+#include <ostream>
+#include <algorithm>
+#include <cinttypes>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+LiveTop::LiveTop(double halfLife, bool lineMode)
+    : m_dHalfLife(halfLife), m_stProfile(lineMode)
+{
+}
+
+void LiveTop::OnSample(const std::vector<LuaStackFrame>& stack)
+{
+    // 空栈计入 (idle)，各函数的百分比以包括空闲在内的全部采样为分母
+    m_stProfile.AddSample(m_stProfile.InternStack(stack));
+}
+
+void LiveTop::Update(double elapsed)
+{
+    if (elapsed <= 0)
+        return;
+
+    auto frameCount = m_stProfile.GetFrameCount();
+    m_stSelfRates.resize(frameCount, 0.);
+    m_stTotalRates.resize(frameCount, 0.);
+    m_stTotalCounts.resize(frameCount, 0);
+    m_stWindowSelf.assign(frameCount, 0);
+    m_stWindowTotal.assign(frameCount, 0);
+    m_stFrameMarks.resize(frameCount, 0);
+
+    // 只遍历本窗口内有采样的堆栈
+    uint64_t windowSamples = 0;
+    for (auto id : m_stProfile.GetDirtyStacks())
+    {
+        auto count = m_stProfile.GetDeltaCount(id);
+        windowSamples += count;
+        m_stWindowSelf[m_stProfile.GetStack(id).Frame] += count;
+
+        ++m_uMark;
+        for (auto node = id; node != INVALID_PROFILE_ID; node = m_stProfile.GetStack(node).Parent)
+        {
+            auto frame = m_stProfile.GetStack(node).Frame;
+            if (m_stFrameMarks[frame] == m_uMark)
+                continue;
+            m_stFrameMarks[frame] = m_uMark;
+            m_stWindowTotal[frame] += count;
+        }
+    }
+    m_stProfile.ResetDelta();
+
+    // 指数衰减：经过一个半衰期，旧窗口的权重减半；第一个窗口直接作为初值
+    auto alpha = m_dHalfLife > 0 && m_bInitialized ? 1. - exp(-elapsed * log(2.) / m_dHalfLife) : 1.;
+    m_bInitialized = true;
+    m_dSampleRate += alpha * (windowSamples / elapsed - m_dSampleRate);
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        m_stSelfRates[i] += alpha * (m_stWindowSelf[i] / elapsed - m_stSelfRates[i]);
+        m_stTotalRates[i] += alpha * (m_stWindowTotal[i] / elapsed - m_stTotalRates[i]);
+        m_stTotalCounts[i] += m_stWindowTotal[i];
+    }
+}
+
+void LiveTop::Write(std::ostream& out, unsigned topCount)const
+{
+    vector<ProfileId> frames;
+    for (ProfileId i = 0; i < m_stTotalRates.size(); ++i)
+    {
+        if (m_stTotalRates[i] > 0. || m_stSelfRates[i] > 0.)
+            frames.push_back(i);
+    }
+    sort(frames.begin(), frames.end(), [&](ProfileId lhs, ProfileId rhs) {
+        if (m_stSelfRates[lhs] != m_stSelfRates[rhs])
+            return m_stSelfRates[lhs] > m_stSelfRates[rhs];
+        return m_stTotalRates[lhs] > m_stTotalRates[rhs];
+    });
+    if (frames.size() > topCount)
+        frames.resize(topCount);
+
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "%10.1f samples/s, %" PRIu64 " samples in total\n\n", m_dSampleRate,
+        GetTotalSampleCount());
+    out << buffer;
+    out << "   self%   total%   self/s  total/s      samples  function\n";
+    for (auto frame : frames)
+    {
+        auto self = m_dSampleRate > 0. ? m_stSelfRates[frame] * 100. / m_dSampleRate : 0.;
+        auto total = m_dSampleRate > 0. ? m_stTotalRates[frame] * 100. / m_dSampleRate : 0.;
+        snprintf(buffer, sizeof(buffer), " %6.2f%%  %6.2f%% %8.1f %8.1f %12" PRIu64 "  ", self, total,
+            m_stSelfRates[frame], m_stTotalRates[frame], m_stTotalCounts[frame]);
+        out << buffer << FormatProfileFrame(m_stProfile, m_stProfile.GetFrame(frame)) << "\n";
+    }
+    out.flush();
+}
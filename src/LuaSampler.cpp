@@ -6,8 +6,11 @@
 #include "LuaSampler.hpp"
 #include "RemoteLuaWrapper.hpp"
 
+#include <mutex>
+#include <atomic>
 #include <csignal>
 #include <functional>
+#include <pthread.h>
 
 #include <Moe.Core/Logging.hpp>
 
@@ -21,12 +24,26 @@ public:
     ProcessPauseScope(Debugger& dbg)
         : m_pDebugger(dbg)
     {
-        if (m_pDebugger.GetStatus() == ProcessStatus::Running)
-            m_pDebugger.Interrupt();
+        // 暂停期间推迟信号的处理，保证退出前目标进程总能被恢复执行
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        sigaddset(&mask, SIGHUP);
+        pthread_sigmask(SIG_BLOCK, &mask, &m_stOldMask);
 
-        signal(SIGINT, SIG_IGN);
-        signal(SIGTERM, SIG_IGN);
-        signal(SIGHUP, SIG_IGN);
+        if (m_pDebugger.GetStatus() == ProcessStatus::Running)
+        {
+            try
+            {
+                m_pDebugger.Interrupt();
+            }
+            catch (...)
+            {
+                pthread_sigmask(SIG_SETMASK, &m_stOldMask, nullptr);
+                throw;
+            }
+        }
     }
 
     ~ProcessPauseScope()
@@ -34,35 +51,44 @@ public:
         if (m_pDebugger.GetStatus() == ProcessStatus::Paused)
             m_pDebugger.ContinueSafe();
 
-        signal(SIGINT, SIG_DFL);
-        signal(SIGTERM, SIG_DFL);
-        signal(SIGHUP, SIG_DFL);
+        pthread_sigmask(SIG_SETMASK, &m_stOldMask, nullptr);
     }
 
 private:
     Debugger& m_pDebugger;
+    sigset_t m_stOldMask;
 };
 
 class ProcessWatchScope
 {
 private:
-    static Debugger*& GetDebuggerInstance()noexcept
+    static const size_t MAX_WATCHING = 256;
+
+    // 多个线程可能同时在等待各自的进程，信号处理函数中只能访问无锁的数据
+    static std::atomic<Debugger*>* GetDebuggerInstances()noexcept
     {
-        static Debugger* s_pInstance = nullptr;
-        return s_pInstance;
+        static std::atomic<Debugger*> s_pInstances[MAX_WATCHING];
+        return s_pInstances;
     }
 
-    static void OnSignal(int)
+    static std::mutex& GetHandlerLock()noexcept
     {
-        if (!GetDebuggerInstance())
-            return;
+        static std::mutex s_stLock;
+        return s_stLock;
+    }
 
-        auto& debugger = *GetDebuggerInstance();
-        if (debugger.GetStatus() == ProcessStatus::Running)
+    static void OnSignal(int)
+    {
+        auto instances = GetDebuggerInstances();
+        for (size_t i = 0; i < MAX_WATCHING; ++i)
         {
+            auto debugger = instances[i].load();
+            if (!debugger || debugger->GetStatus() != ProcessStatus::Running)
+                continue;
+
             try
             {
-                debugger.SendSignal(SIGINT);
+                debugger->SendSignal(SIGINT);
             }
             catch (const ExceptionBase& ex)
             {
@@ -74,24 +100,50 @@ private:
 public:
     ProcessWatchScope(Debugger& dbg)
     {
-        assert(!GetDebuggerInstance());
-        GetDebuggerInstance() = &dbg;
+        auto instances = GetDebuggerInstances();
+        for (size_t i = 0; i < MAX_WATCHING && !m_pSlot; ++i)
+        {
+            Debugger* expected = nullptr;
+            if (instances[i].compare_exchange_strong(expected, &dbg))
+                m_pSlot = &instances[i];
+        }
+        if (!m_pSlot)
+            MOE_LOG_WARN("Too many processes are being watched, process {0} cannot be cancelled", dbg.GetPid());
 
-        signal(SIGINT, OnSignal);
-        signal(SIGTERM, OnSignal);
-        signal(SIGHUP, OnSignal);
+        // 第一个作用域安装信号处理函数，最后一个恢复
+        std::lock_guard<std::mutex> guard(GetHandlerLock());
+        if (s_uWatchingCount++ == 0)
+        {
+            s_pOldHandlers[0] = signal(SIGINT, OnSignal);
+            s_pOldHandlers[1] = signal(SIGTERM, OnSignal);
+            s_pOldHandlers[2] = signal(SIGHUP, OnSignal);
+        }
     }
 
     ~ProcessWatchScope()
     {
-        GetDebuggerInstance() = nullptr;
+        if (m_pSlot)
+            m_pSlot->store(nullptr);
 
-        signal(SIGINT, SIG_DFL);
-        signal(SIGTERM, SIG_DFL);
-        signal(SIGHUP, SIG_DFL);
+        std::lock_guard<std::mutex> guard(GetHandlerLock());
+        if (--s_uWatchingCount == 0)
+        {
+            signal(SIGINT, s_pOldHandlers[0]);
+            signal(SIGTERM, s_pOldHandlers[1]);
+            signal(SIGHUP, s_pOldHandlers[2]);
+        }
     }
+
+private:
+    static size_t s_uWatchingCount;
+    static sighandler_t s_pOldHandlers[3];
+
+    std::atomic<Debugger*>* m_pSlot = nullptr;
 };
 
+size_t ProcessWatchScope::s_uWatchingCount = 0;
+sighandler_t ProcessWatchScope::s_pOldHandlers[3] = {};
+
 class LuaStateFetcher
 {
 public:
@@ -177,20 +229,46 @@ private:
     std::vector<Breakpoint*> m_stBreakpoints;
 };
 
-class MemoryAccessor :
+class VmMemoryAccessor :
     public MemoryAccessorBase<>
 {
 public:
-    MemoryAccessor(Debugger& dbg)
+    VmMemoryAccessor(const Debugger& dbg)
         : m_pDebugger(dbg) {}
 
 public:
     void Read(uintptr_t address, moe::MutableBytesView output)
     {
-        assert(address % sizeof(Word) == 0);
-        assert(output.GetSize() % sizeof(Word) == 0);
-        auto sz = m_pDebugger.ReadBytes(address, output.GetBuffer(), output.GetSize());
-        assert(sz == output.GetSize());
+        auto sz = m_pDebugger.ReadMemory(address, output.GetBuffer(), output.GetSize());
+        if (sz != output.GetSize())
+            MOE_THROW(ApiException, "Cannot read {0} bytes at {1}", output.GetSize(), address);
+    }
+
+    void ReadBatch(const std::vector<MemoryReadRequest>& requests)
+    {
+        m_stLocal.resize(requests.size());
+        m_stRemote.resize(requests.size());
+        size_t total = 0;
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            m_stLocal[i].iov_base = requests[i].Output;
+            m_stLocal[i].iov_len = requests[i].Size;
+            m_stRemote[i].iov_base = reinterpret_cast<void*>(requests[i].Address);
+            m_stRemote[i].iov_len = requests[i].Size;
+            total += requests[i].Size;
+        }
+
+        auto sz = m_pDebugger.ReadMemory(m_stLocal.data(), m_stRemote.data(), requests.size());
+        if (sz != total)
+        {
+            // 找出第一个未能读取的请求
+            for (const auto& request : requests)
+            {
+                if (sz < request.Size)
+                    MOE_THROW(ApiException, "Cannot read {0} bytes at {1}", request.Size, request.Address);
+                sz -= request.Size;
+            }
+        }
     }
 
     std::string ReadString(uintptr_t address, size_t maxlen)
@@ -199,22 +277,25 @@ public:
     }
 
 private:
-    Debugger& m_pDebugger;
+    const Debugger& m_pDebugger;
+    std::vector<struct iovec> m_stLocal;
+    std::vector<struct iovec> m_stRemote;
 };
 
-class MemoryAccessorScope
+namespace
 {
-public:
-    MemoryAccessorScope(MemoryAccessorPtr p)
-    {
-        SetGlobalMemoryAccessor(p);
-    }
-
-    ~MemoryAccessorScope()
+    /**
+     * @brief 判断复制的调用帧是否未变
+     *
+     * CallInfo（含savedpc与previous）与函数值均相同时，闭包及其Proto也相同（二者创建后不再改变），
+     * 因此解析结果只取决于这一帧与其调用者。
+     */
+    bool IsSameFrame(const LuaObjects::RawCallFrame& lhs, const LuaObjects::RawCallFrame& rhs)noexcept
     {
-        SetGlobalMemoryAccessor(nullptr);
+        return lhs.Address == rhs.Address && ::memcmp(&lhs.Info, &rhs.Info, sizeof(lhs.Info)) == 0 &&
+            lhs.Func.tt_ == rhs.Func.tt_ && ::memcmp(&lhs.Func.value_, &rhs.Func.value_, sizeof(lhs.Func.value_)) == 0;
     }
-};
+}
 
 //////////////////////////////////////////////////////////////////////////////// LuaSampler
 
@@ -270,27 +351,174 @@ uintptr_t LuaSampler::FetchLuaState(const std::vector<uintptr_t>& customEntryPoi
 }
 
 std::vector<LuaStackFrame> LuaSampler::DumpStack(uintptr_t address)
+{
+    LuaRawStack stack;
+    CaptureStack(address, stack);
+
+    vector<LuaStackFrame> ret;
+    Symbolize(stack, ret);
+    return ret;
+}
+
+void LuaSampler::CaptureStack(uintptr_t address, LuaRawStack& out)
 {
     ProcessPauseScope scope(m_pDebugger);
+    VmMemoryAccessor accessor(m_pDebugger);
+    ReadPlanner planner(accessor);
 
-    auto accessor = static_pointer_cast<MemoryAccessorBase<>>(make_shared<MemoryAccessor>(m_pDebugger));
-    MemoryAccessorScope memScope(accessor);
+    out.Address = address;
+    out.Frames.clear();
 
-    vector<LuaStackFrame> ret;
+    RemotePtr<LuaObjects::lua_State> luaStatePtr { reinterpret_cast<LuaObjects::lua_State*>(address) };
+    RemotePtr<LuaObjects::CallInfo> callInfoPtr { nullptr };
+    auto readState = [&]() {
+        planner.Add(luaStatePtr.GetField(&LuaObjects::lua_State::l_G), out.Global);
+        planner.Add(luaStatePtr.GetField(&LuaObjects::lua_State::ci), callInfoPtr);
+    };
+
+    // 上次的调用链地址已知，与 lua_State 在同一波中重新读取
+    auto& cached = m_stLastCapture.Frames;
+    if (m_stLastCapture.Address != address)
+        cached.clear();
+    m_stVerifyFrames.resize(cached.size());
+    readState();
+    for (size_t i = 0; i < cached.size(); ++i)
+    {
+        m_stVerifyFrames[i].Address = cached[i].Address;
+        planner.Add(cached[i].Address, m_stVerifyFrames[i].Info);
+        planner.Add(cached[i].Info.func, m_stVerifyFrames[i].Func);
+    }
+    try
+    {
+        planner.Flush();
+    }
+    catch (const ExceptionBase&)
+    {
+        // 上次的帧可能已被释放
+        if (cached.empty())
+            throw;
+        cached.clear();
+        readState();
+        planner.Flush();
+    }
+
+    // 从栈底起内容未变的帧，即 cached[reusable] 及之后的帧，可直接拼接
+    auto reusable = cached.size();
+    while (reusable > 0 && IsSameFrame(cached[reusable - 1], m_stVerifyFrames[reusable - 1]))
+        --reusable;
+    auto findReusable = [&](RemotePtr<LuaObjects::CallInfo> ci) {
+        for (auto i = reusable; i < cached.size(); ++i)
+        {
+            if (cached[i].Address == ci)
+                return i;
+        }
+        return cached.size();
+    };
 
     // 遍历LUA堆栈
-    RemotePtr<LuaObjects::lua_State> luaStatePtr { reinterpret_cast<LuaObjects::lua_State*>(address) };
-    auto luaState(*luaStatePtr);
-    auto callInfoPtr = luaState.ci;
-    while (callInfoPtr && callInfoPtr != address + offsetof(LuaObjects::lua_State, base_ci))
+    // 每一帧依次需要 CallInfo、函数值、闭包三次有依赖的读取，错开到相邻的三波中：
+    // 第 N 波同时读取第 N 层的 CallInfo、第 N-1 层的函数值与第 N-2 层的闭包，每层只需一次往返
+    auto baseCallInfo = address + offsetof(LuaObjects::lua_State, base_ci);
+    if (callInfoPtr == baseCallInfo)
+        callInfoPtr.pointer = nullptr;
+
+    size_t walked = 0;  // 逐层读取的帧数，之后为拼接的帧
+    size_t funcIndex = 0;  // 下一个待读取函数值的帧
+    size_t closureIndex = 0;  // 下一个待读取闭包的帧
+    while (callInfoPtr || closureIndex < walked)
+    {
+        // 先加入本层，之后 Frames 不再增长，加入计划的引用在 Flush 之前保持有效
+        auto newFrame = false;
+        if (callInfoPtr)
+        {
+            auto index = findReusable(callInfoPtr);
+            if (index < cached.size())
+            {
+                out.Frames.insert(out.Frames.end(), cached.begin() + index, cached.end());
+                callInfoPtr.pointer = nullptr;
+            }
+            else
+            {
+                out.Frames.emplace_back();
+                out.Frames.back().Address = callInfoPtr;
+                planner.Add(callInfoPtr, out.Frames.back().Info);
+                newFrame = true;
+                ++walked;
+            }
+        }
+
+        // 函数值已在之前的波中读取
+        if (closureIndex < funcIndex)
+        {
+            auto& frame = out.Frames[closureIndex++];
+            if (frame.Func.IsClosure())
+                planner.Add(frame.Func.value_.gc.CastTo<LuaObjects::Closure>(), frame.FuncClosure);
+            else
+                ::memset(&frame.FuncClosure, 0, sizeof(frame.FuncClosure));
+        }
+
+        // CallInfo 已在之前的波中读取
+        if (funcIndex + (newFrame ? 1 : 0) < walked)
+        {
+            auto& frame = out.Frames[funcIndex++];
+            planner.Add(frame.Info.func, frame.Func);
+        }
+
+        planner.Flush();
+        if (newFrame)
+        {
+            callInfoPtr = out.Frames[walked - 1].Info.previous;
+            if (callInfoPtr == baseCallInfo)
+                callInfoPtr.pointer = nullptr;
+        }
+    }
+
+    MOE_LOG_TRACE("Captured {0} frames, {1} reused", out.Frames.size(), out.Frames.size() - walked);
+    m_stLastCapture.Address = address;
+    cached = out.Frames;
+}
+
+void LuaSampler::Symbolize(const LuaRawStack& stack, std::vector<LuaStackFrame>& out)
+{
+    VmMemoryAccessor accessor(m_pDebugger);
+
+    // 解析时只用到 l_G
+    LuaObjects::lua_State luaState;
+    ::memset(&luaState, 0, sizeof(luaState));
+    luaState.l_G = stack.Global;
+
+    // 最后一帧的调用者为base_ci，它总不是LUA函数（callstatus为0）
+    LuaObjects::RawCallFrame baseFrame;
+    ::memset(&baseFrame, 0, sizeof(baseFrame));
+    baseFrame.Address.pointer = reinterpret_cast<LuaObjects::CallInfo*>(stack.Address +
+        offsetof(LuaObjects::lua_State, base_ci));
+
+    // 与上次解析的堆栈相比，栈底相同的帧的调用者也相同，解析结果可以复用
+    size_t reused = 0;
+    const auto& last = m_stLastSymbolized.Frames;
+    if (m_stLastSymbolized.Address == stack.Address && m_stLastSymbolized.Global == stack.Global)
     {
+        auto count = min(last.size(), stack.Frames.size());
+        while (reused < count &&
+            IsSameFrame(last[last.size() - 1 - reused], stack.Frames[stack.Frames.size() - 1 - reused]))
+        {
+            ++reused;
+        }
+    }
+
+    out.clear();
+    out.reserve(stack.Frames.size());
+    for (size_t i = 0; i + reused < stack.Frames.size(); ++i)
+    {
+        const auto& previous = (i + 1 < stack.Frames.size()) ? stack.Frames[i + 1] : baseFrame;
+
         LuaObjects::lua_Debug debug {};
-        debug.i_ci = callInfoPtr;
-        luaState.GetInfo("nSlt", debug);
+        luaState.GetInfo(accessor, "nSlt", stack.Frames[i], &previous, debug, m_stProtoCache);
 
         LuaStackFrame frame;
         frame.Source = debug.short_src;
         frame.Line = debug.linedefined == -1 ? 0u : static_cast<unsigned>(debug.linedefined);
+        frame.CurrentLine = debug.currentline <= 0 ? 0u : static_cast<unsigned>(debug.currentline);
         frame.Address = debug.address;
         frame.Name = debug.name;
         if (strcmp(debug.what, "C") == 0)
@@ -303,11 +531,18 @@ std::vector<LuaStackFrame> LuaSampler::DumpStack(uintptr_t address)
             }
         }
         else
+        {
             frame.Type = LuaFunctionType::Lua;
+            frame.ProtoAddress = debug.proto;
+            frame.Pc = debug.currentpc;
+        }
 
-        ret.emplace_back(std::move(frame));
-        callInfoPtr = (*callInfoPtr).previous;
+        out.emplace_back(std::move(frame));
     }
+    out.insert(out.end(), m_stLastSymbolizedFrames.end() - reused, m_stLastSymbolizedFrames.end());
 
-    return ret;
+    m_stLastSymbolized.Address = stack.Address;
+    m_stLastSymbolized.Global = stack.Global;
+    m_stLastSymbolized.Frames = stack.Frames;
+    m_stLastSymbolizedFrames = out;
 }
@@ -1,5 +1,23 @@
-#include "LuaSampler.hpp"
+#include "Report.hpp"
+#include "ProfileDiff.hpp"
+#include "ProfileLoader.hpp"
+#include "ProfileQuery.hpp"
+#include "ProfileMerger.hpp"
+#include "LiveTop.hpp"
+#include "MultiSampler.hpp"
+#include "SamplePipeline.hpp"
+#include "Daemon.hpp"
+#include "SegmentStore.hpp"
+#include "PProfWriter.hpp"
+#include "CallgrindWriter.hpp"
+#include "FlameGraph.hpp"
+#include "BinaryProfile.hpp"
 
+#include <ctime>
+#include <mutex>
+#include <csignal>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <Moe.Core/Logging.hpp>
 #include <Moe.Core/CmdParser.hpp>
@@ -11,33 +29,122 @@ using namespace lperf;
 struct Config
 {
     uint64_t Pid = 0;
+    string Pids;
+    string ProcessName;
+    uint32_t Threads = 0;
+    bool Split = false;
     bool Verbose = false;
 
     uint32_t SampleInterval = 0;
     uint32_t SampleCount = 0;
 
     string HookEntry;
+
+    string Report;
+    bool LineMode = false;
+    uint32_t TopCount = 0;
+
+    string Output;
+    uint32_t FlushInterval = 0;
+    bool Cumulative = false;
+
+    uint32_t MemoryCap = 0;
+    uint32_t StringCacheCap = 0;
 };
 
-namespace
+struct DiffConfig
 {
-    string FormatStack(const LuaStackFrame& frame)
-    {
-        switch (frame.Type)
-        {
-            case LuaFunctionType::Native:
-                if (frame.Name.empty())
-                    return StringUtils::Format("[0x{0,16[0]:H}]", frame.Address);
-                return StringUtils::Format("[{0}]", frame.Name);
-            case LuaFunctionType::Lua:
-                return StringUtils::Format("{0} @ {1}:{2}", frame.Name.empty() ? "?" : frame.Name, frame.Source,
-                    frame.Line);
-            case LuaFunctionType::Unknown:
-            default:
-                return "?";
-        }
-    }
+    bool Verbose = false;
+
+    string Base;
+    string Compare;
+
+    string Output;
+    string Graph;
+    uint32_t TopCount = 0;
+};
+
+struct ReportConfig
+{
+    bool Verbose = false;
+
+    string File;
+    uint32_t TopCount = 0;
+    bool SortByTotal = false;
+
+    string Focus;
+    string Ignore;
+    bool Sources = false;
+    string Peers;
 
+    string Export;
+    string Output;
+};
+
+struct TopConfig
+{
+    uint64_t Pid = 0;
+    bool Verbose = false;
+
+    uint32_t SampleInterval = 0;
+    uint32_t RefreshInterval = 0;
+    uint32_t HalfLife = 0;
+    uint32_t TopCount = 0;
+    bool LineMode = false;
+
+    string HookEntry;
+};
+
+struct DaemonConfig
+{
+    bool Verbose = false;
+
+    string Socket;
+    uint32_t HttpPort = 0;
+    uint32_t SampleInterval = 0;
+};
+
+struct MergeConfig
+{
+    bool Verbose = false;
+
+    string Files;
+    string Manifest;
+    string GroupBy;
+    uint32_t Jobs = 0;
+
+    string Output;
+    string Format;
+};
+
+struct RecordConfig
+{
+    uint64_t Pid = 0;
+    bool Verbose = false;
+
+    string Directory;
+    uint32_t SampleInterval = 0;
+    uint32_t SegmentDuration = 0;
+    uint32_t Budget = 0;
+    bool LineMode = false;
+
+    string HookEntry;
+};
+
+struct QueryConfig
+{
+    bool Verbose = false;
+
+    string Directory;
+    string From;
+    string To;
+
+    string Output;
+    string Format;
+};
+
+namespace
+{
     vector<uintptr_t> MakeCustomHookEntries(const std::string& val)
     {
         vector<string> container;
@@ -55,52 +162,318 @@ namespace
         return ret;
     }
 
-    void Process(const Config& cfg)
+    volatile sig_atomic_t s_bStopRequested = 0;
+
+    void OnStopSignal(int)
+    {
+        s_bStopRequested = 1;
+    }
+
+    /**
+     * @brief 在作用域内将终止信号转为停止采样的请求，以便输出已采集的结果
+     */
+    class StopSignalScope
+    {
+    public:
+        StopSignalScope()
+        {
+            m_pOldHandlers[0] = signal(SIGINT, OnStopSignal);
+            m_pOldHandlers[1] = signal(SIGTERM, OnStopSignal);
+            m_pOldHandlers[2] = signal(SIGHUP, OnStopSignal);
+        }
+
+        ~StopSignalScope()
+        {
+            signal(SIGINT, m_pOldHandlers[0]);
+            signal(SIGTERM, m_pOldHandlers[1]);
+            signal(SIGHUP, m_pOldHandlers[2]);
+        }
+
+    private:
+        sighandler_t m_pOldHandlers[3];
+    };
+
+    void WriteSnapshot(ReportBase& report, const string& path)
+    {
+        if (path.empty())
+        {
+            report.Write(cout);
+            return;
+        }
+
+        // 先写入临时文件再替换，保证读者总能看到完整的结果
+        auto tmp = path + ".tmp";
+        {
+            ofstream out(tmp, ios::out | ios::trunc | ios::binary);
+            if (!out)
+                MOE_THROW(ApiException, "Cannot open output file \"{0}\"", tmp);
+            report.Write(out);
+            if (!out)
+                MOE_THROW(ApiException, "Write output file \"{0}\" error", tmp);
+        }
+        if (::rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            MOE_THROW(ApiException, "Rename \"{0}\" to \"{1}\" error, errno={2}({3})", tmp, path, errno,
+                strerror(errno));
+        }
+    }
+
+    bool IsTextReport(const string& name)
+    {
+        // 以行为单位、允许以 # 开头的注释行的文本输出
+        return name == "folded" || name == "opcodes-folded" || name == "lines" || name == "bytecode" ||
+            name == "opcodes" || name == "loops" || name == "topk" || name == "callgrind";
+    }
+
+    void ProcessSingle(const Config& cfg, ProcessId pid)
     {
         auto customEntryPoints = MakeCustomHookEntries(cfg.HookEntry);
 
-        shared_ptr<Debugger> debugger = make_shared<Debugger>(cfg.Pid);
+        shared_ptr<Debugger> debugger = make_shared<Debugger>(pid);
         LuaSampler sampler(*debugger.get());
+        sampler.GetStringCache().SetCapacity(static_cast<size_t>(cfg.StringCacheCap) * 1024);
+
+        ReportOptions reportOptions;
+        reportOptions.LineMode = cfg.LineMode;
+        reportOptions.TopCount = cfg.TopCount;
+        reportOptions.SampleInterval = cfg.SampleInterval;
+        reportOptions.MemoryCap = static_cast<size_t>(cfg.MemoryCap) * 1024 * 1024;
+        if (cfg.Report == "pprof" || cfg.Report == "binary")
+            CollectProcessInfo(*debugger, reportOptions);
+        auto report = CreateReport(cfg.Report, reportOptions, sampler.GetProtoCache());
+
+        // 流式输出
+        auto streaming = cfg.FlushInterval > 0;
+        if (streaming && !cfg.Cumulative && !report->IsIncremental())
+            MOE_THROW(BadArgumentException, "Report {0} cannot be streamed as delta, use cumulative mode", cfg.Report);
+
+        ofstream deltaFile;
+        if (streaming && !cfg.Cumulative && !cfg.Output.empty())
+        {
+            deltaFile.open(cfg.Output, ios::out | ios::trunc | ios::binary);
+            if (!deltaFile)
+                MOE_THROW(ApiException, "Cannot open output file \"{0}\"", cfg.Output);
+        }
+
+        auto flush = [&]() {
+            if (!cfg.Cumulative)
+            {
+                auto& out = deltaFile.is_open() ? static_cast<ostream&>(deltaFile) : cout;
+                out << "# " << chrono::duration_cast<chrono::milliseconds>(
+                    chrono::system_clock::now().time_since_epoch()).count() << " delta\n";
+                report->WriteDelta(out);
+            }
+            else
+            {
+                // 二进制与结构化格式中不能插入注释，分隔行改为输出到 stderr
+                if (cfg.Output.empty())
+                {
+                    auto& out = IsTextReport(cfg.Report) ? cout : cerr;
+                    out << "# " << chrono::duration_cast<chrono::milliseconds>(
+                        chrono::system_clock::now().time_since_epoch()).count() << " cumulative\n";
+                }
+                WriteSnapshot(*report, cfg.Output);
+            }
+        };
 
         // 获取LuaState
         MOE_LOG_DEBUG("Fetching lua_State*");
         auto L = sampler.FetchLuaState(customEntryPoints);
 
-        // 捕捉堆栈
-        map<string, size_t> stackCounter;
-        vector<LuaStackFrame> stacks;
-        string formattedStack;
-        formattedStack.reserve(1024);
-        for (size_t i = 0; i < cfg.SampleCount; ++i)
+        // 捕捉堆栈：本线程只负责暂停目标并复制调用链，解析与聚合在流水线的线程中进行
+        auto lastFlush = chrono::steady_clock::now();
+        SamplePipeline pipeline(sampler, [&](const vector<LuaStackFrame>& stack, const SampleInfo& info) {
+            report->OnSample(stack, info);
+            if (streaming)
+            {
+                auto now = chrono::steady_clock::now();
+                if (now - lastFlush >= chrono::seconds(cfg.FlushInterval))
+                {
+                    flush();
+                    lastFlush = now;
+                }
+            }
+        });
+
+        StopSignalScope stopScope;
+        SampleInfo info;
+        info.Thread = L;
+        for (size_t i = 0; (cfg.SampleCount == 0 || i < cfg.SampleCount) && !s_bStopRequested; ++i)
         {
             this_thread::sleep_for(chrono::milliseconds(cfg.SampleInterval));
+            if (s_bStopRequested)
+                break;
+            if (debugger->GetStatus() == ProcessStatus::Terminated)
+            {
+                MOE_LOG_WARN("Target terminated, stop sampling");
+                break;
+            }
 
             MOE_LOG_DEBUG("Capturing lua stack {0}/{1}", i + 1, cfg.SampleCount);
             try
             {
-                stacks.clear();
-                stacks = sampler.DumpStack(L);
+                info.Time = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now().time_since_epoch()).count());
+                pipeline.Capture(L, info);
             }
             catch (const ExceptionBase& ex)
             {
                 MOE_LOG_ERROR("Capture frame failure: {0}", ex.GetDescription());
-                continue;
             }
-            formattedStack.clear();
-            formattedStack.append("(base);");
-            for (auto it = stacks.rbegin(); it != stacks.rend(); ++it)
+        }
+        pipeline.Stop();
+
+        // 打印结果
+        if (streaming)
+            flush();
+        else
+            WriteSnapshot(*report, cfg.Output);
+    }
+
+    bool IsProcessSpecificReport(const string& name)
+    {
+        // 依赖目标进程的 Proto 缓存
+        return name == "bytecode" || name == "opcodes" || name == "opcodes-folded" || name == "loops";
+    }
+
+    void ProcessMulti(const Config& cfg, const vector<ProcessId>& pids)
+    {
+        if (cfg.FlushInterval > 0)
+            MOE_THROW(BadArgumentException, "Streaming is not supported when sampling multiple processes");
+        if (!cfg.Split && IsProcessSpecificReport(cfg.Report))
+            MOE_THROW(BadArgumentException, "Report {0} cannot merge multiple processes, use --split", cfg.Report);
+
+        MultiSamplerOptions samplerOptions;
+        samplerOptions.SampleInterval = cfg.SampleInterval;
+        samplerOptions.SampleCount = cfg.SampleCount;
+        samplerOptions.CustomEntryPoints = MakeCustomHookEntries(cfg.HookEntry);
+        samplerOptions.Threads = cfg.Threads;
+        samplerOptions.StringCacheCapacity = static_cast<size_t>(cfg.StringCacheCap) * 1024;
+        MultiSampler sampler(pids, samplerOptions);
+
+        ReportOptions reportOptions;
+        reportOptions.LineMode = cfg.LineMode;
+        reportOptions.TopCount = cfg.TopCount;
+        reportOptions.SampleInterval = cfg.SampleInterval;
+        reportOptions.MemoryCap = static_cast<size_t>(cfg.MemoryCap) * 1024 * 1024;
+
+        // 合并输出时所有进程共用一个报告，以进程ID区分时间线上的线程
+        ProtoCache unusedCache;
+        vector<ReportPtr> reports(cfg.Split ? pids.size() : 1);
+        if (!cfg.Split)
+            reports[0] = CreateReport(cfg.Report, reportOptions, unusedCache);
+
+        mutex reportLock;
+        auto onAttach = [&](size_t index, Debugger& debugger, LuaSampler& targetSampler) {
+            if (!cfg.Split)
+                return;
+            auto options = reportOptions;
+            if (cfg.Report == "pprof" || cfg.Report == "binary")
+                CollectProcessInfo(debugger, options);
+            reports[index] = CreateReport(cfg.Report, options, targetSampler.GetProtoCache());
+        };
+        auto onSample = [&](size_t index, const vector<LuaStackFrame>& stack, const SampleInfo& info) {
+            if (cfg.Split)
             {
-                formattedStack.append(FormatStack(*it));
-                formattedStack.push_back(';');
+                reports[index]->OnSample(stack, info);
+                return;
             }
-            MOE_LOG_INFO("Captured stack: {0}", formattedStack);
+            auto merged = info;
+            merged.Thread = pids[index];
+            lock_guard<mutex> guard(reportLock);
+            reports[0]->OnSample(stack, merged);
+        };
 
-            ++stackCounter[formattedStack];
-        }
+        StopSignalScope stopScope;
+        sampler.Run(onAttach, onSample, []() { return s_bStopRequested != 0; });
+
+        size_t attached = 0;
+        for (size_t i = 0; i < pids.size(); ++i)
+            attached += sampler.IsAttached(i) ? 1 : 0;
+        if (attached == 0)
+            MOE_THROW(ApiException, "No process attached");
 
         // 打印结果
-        for (const auto& it : stackCounter)
-            cout << it.first << " " << it.second << endl;
+        if (!cfg.Split)
+        {
+            WriteSnapshot(*reports[0], cfg.Output);
+            return;
+        }
+        for (size_t i = 0; i < pids.size(); ++i)
+        {
+            if (!reports[i])
+                continue;
+            if (cfg.Output.empty())
+            {
+                cout << "# pid " << pids[i] << "\n";
+                reports[i]->Write(cout);
+                continue;
+            }
+
+            auto path = cfg.Output;
+            auto pos = path.find("{pid}");
+            if (pos != string::npos)
+                path.replace(pos, 5, to_string(pids[i]));
+            else
+                path += "." + to_string(pids[i]);
+            WriteSnapshot(*reports[i], path);
+        }
+    }
+
+    void Process(const Config& cfg)
+    {
+        vector<ProcessId> pids;
+        if (cfg.Pid != 0)
+            pids.push_back(cfg.Pid);
+
+        vector<string> list;
+        StringUtils::Split(list, cfg.Pids, ',', StringUtils::SplitFlags::RemoveEmptyEntries);
+        for (const auto& i : list)
+        {
+            size_t processed = 0;
+            auto pid = Convert::ParseUInt(i.c_str(), i.size(), processed);
+            if (processed < i.size() || pid == 0)
+                MOE_THROW(BadFormatException, "Invalid process id: {0}", i);
+            pids.push_back(pid);
+        }
+
+        if (!cfg.ProcessName.empty())
+        {
+            auto found = FindProcesses(cfg.ProcessName);
+            if (found.empty())
+                MOE_THROW(ObjectNotFoundException, "No process named {0}", cfg.ProcessName);
+            pids.insert(pids.end(), found.begin(), found.end());
+        }
+
+        sort(pids.begin(), pids.end());
+        pids.erase(unique(pids.begin(), pids.end()), pids.end());
+        if (pids.empty())
+            MOE_THROW(BadArgumentException, "No process specified, use -p, -P or -N");
+
+        if (pids.size() == 1 && !cfg.Split)
+            ProcessSingle(cfg, pids[0]);
+        else
+            ProcessMulti(cfg, pids);
+    }
+
+    void ParseCommandline(CmdParser& parser, int argc, const char** argv, const string& name, bool& needHelp)
+    {
+        try
+        {
+            parser(argc, argv);
+        }
+        catch (const ExceptionBase& ex)
+        {
+            fprintf(stderr, "%s\n\n", ex.GetDescription().c_str());
+            needHelp = true;
+        }
+
+        if (needHelp)
+        {
+            fprintf(stderr, "%s\n", parser.BuildUsageText(name.c_str()).c_str());
+            fprintf(stderr, "%s\n", parser.BuildOptionsText(2, 10).c_str());
+            exit(1);
+        }
     }
 
     Config GetCommandline(int argc, const char** argv)
@@ -109,74 +482,639 @@ namespace
         bool needHelp = false;
 
         CmdParser parser;
-        parser << CmdParser::Option(cfg.Pid, "pid", 'p', "Specific the process id");
+        parser << CmdParser::Option(cfg.Pid, "pid", 'p', "Specific the process id", static_cast<uint64_t>(0));
+        parser << CmdParser::Option(cfg.Pids, "pids", 'P', "Specific process ids separated by comma", string());
+        parser << CmdParser::Option(cfg.ProcessName, "name", 'N',
+            "Sample all processes with the name (comm or executable file name)", string());
+        parser << CmdParser::Option(cfg.Split, "split", 'S',
+            "Write a report per process (output file may contain {pid}, otherwise .PID is appended)", false);
+        parser << CmdParser::Option(cfg.Threads, "threads", 'j',
+            "Specific sampler thread count when sampling multiple processes (0 for cpu count)", 0u);
         parser << CmdParser::Option(needHelp, "help", 'h', "Show this help", false);
         parser << CmdParser::Option(cfg.Verbose, "verbose", 'v', "Show debug log", false);
         parser << CmdParser::Option(cfg.SampleInterval, "interval", 'i', "Specific sample interval (ms)", 1000u);
-        parser << CmdParser::Option(cfg.SampleCount, "count", 'c', "Specific sample count", 10u);
+        parser << CmdParser::Option(cfg.SampleCount, "count", 'c', "Specific sample count (0 for unlimited)", 10u);
         parser << CmdParser::Option(cfg.HookEntry, "hook", 'k',
             "Specific custom hook entry address (must be a lua api), eg: -k 0x12FFBB0,12345678", string());
+        parser << CmdParser::Option(cfg.Report, "report", 'r',
+            "Specific report type (folded, lines, bytecode, opcodes, opcodes-folded, loops, pprof, speedscope, trace, "
+            "svg, html, callgrind, binary, topk)", string("folded"));
+        parser << CmdParser::Option(cfg.LineMode, "line", 'l', "Attribute lua frames to current line in folded stacks",
+            false);
+        parser << CmdParser::Option(cfg.TopCount, "top", 'n', "Specific function count in detailed reports", 10u);
+        parser << CmdParser::Option(cfg.Output, "output", 'o', "Specific output file (default stdout)", string());
+        parser << CmdParser::Option(cfg.FlushInterval, "stream", 's',
+            "Flush aggregated results every N seconds while sampling (0 to disable)", 0u);
+        parser << CmdParser::Option(cfg.Cumulative, "cumulative", 'a',
+            "Flush cumulative results instead of deltas in streaming mode", false);
+        parser << CmdParser::Option(cfg.MemoryCap, "memory-cap", 'M',
+            "Specific memory cap (MB) of the stack table in topk report", 64u);
+        parser << CmdParser::Option(cfg.StringCacheCap, "string-cache", 'C',
+            "Specific memory cap (KB) of the short string cache per process (0 to disable)", 4096u);
 
-        try
+        auto name = PathUtils::GetFileName(argv[0]);
+        ParseCommandline(parser, argc, argv, string(name.GetBuffer(), name.GetSize()), needHelp);
+        return cfg;
+    }
+
+    void ProcessDiff(const DiffConfig& cfg)
+    {
+        Profile base, compare;
+        LoadProfile(cfg.Base, base);
+        LoadProfile(cfg.Compare, compare);
+
+        ProfileDiff diff(base, compare);
+        if (cfg.Output.empty())
+            diff.WriteText(cout, cfg.TopCount);
+        else
         {
-            parser(argc, argv);
+            ofstream out(cfg.Output, ios::out | ios::trunc);
+            if (!out)
+                MOE_THROW(ApiException, "Cannot open output file \"{0}\"", cfg.Output);
+            diff.WriteText(out, cfg.TopCount);
         }
-        catch (const ExceptionBase& ex)
+
+        if (!cfg.Graph.empty())
         {
-            fprintf(stderr, "%s\n\n", ex.GetDescription().c_str());
-            needHelp = true;
+            FlameGraphOptions options;
+            options.Title = "Differential Flame Graph";
+            options.Html = cfg.Graph.size() < 4 || cfg.Graph.compare(cfg.Graph.size() - 4, 4, ".svg") != 0;
+
+            ofstream out(cfg.Graph, ios::out | ios::trunc | ios::binary);
+            if (!out)
+                MOE_THROW(ApiException, "Cannot open output file \"{0}\"", cfg.Graph);
+            diff.WriteFlameGraph(out, options);
         }
+    }
 
-        if (needHelp)
+    DiffConfig GetDiffCommandline(int argc, const char** argv)
+    {
+        DiffConfig cfg;
+        bool needHelp = false;
+
+        CmdParser parser;
+        parser << CmdParser::Option(cfg.Base, "base", 'b', "Specific the baseline profile (folded or binary)");
+        parser << CmdParser::Option(cfg.Compare, "compare", 'c', "Specific the profile to compare (folded or binary)");
+        parser << CmdParser::Option(needHelp, "help", 'h', "Show this help", false);
+        parser << CmdParser::Option(cfg.Verbose, "verbose", 'v', "Show debug log", false);
+        parser << CmdParser::Option(cfg.Output, "output", 'o', "Specific text report file (default stdout)", string());
+        parser << CmdParser::Option(cfg.Graph, "graph", 'g', "Write differential flame graph (.svg or .html)",
+            string());
+        parser << CmdParser::Option(cfg.TopCount, "top", 'n', "Specific entry count in each section", 20u);
+
+        ParseCommandline(parser, argc, argv, "lperf diff", needHelp);
+        return cfg;
+    }
+
+    void WriteProfile(const Profile& profile, const string& format, const string& path)
+    {
+        if (format != "binary" && format != "folded" && format != "pprof" && format != "callgrind" &&
+            format != "svg" && format != "html")
         {
-            auto name = PathUtils::GetFileName(argv[0]);
-            auto nameStr = string(name.GetBuffer(), name.GetSize());
+            MOE_THROW(BadArgumentException, "Unknown output format {0}", format);
+        }
 
-            fprintf(stderr, "%s\n", parser.BuildUsageText(nameStr.c_str()).c_str());
-            fprintf(stderr, "%s\n", parser.BuildOptionsText(2, 10).c_str());
-            exit(1);
+        ofstream file;
+        if (!path.empty())
+        {
+            file.open(path, ios::out | ios::trunc | ios::binary);
+            if (!file)
+                MOE_THROW(ApiException, "Cannot open output file \"{0}\"", path);
+        }
+        auto& out = path.empty() ? static_cast<ostream&>(cout) : file;
+
+        if (format == "binary")
+            WriteBinaryProfile(profile, nullptr, out);
+        else if (format == "folded")
+            WriteFoldedProfile(profile, out);
+        else if (format == "callgrind")
+            WriteCallgrind(profile, out);
+        else if (format == "svg" || format == "html")
+        {
+            FlameGraphOptions options;
+            options.Html = (format == "html");
+            WriteFlameGraph(profile, out, options);
+        }
+        else
+            WritePProf(profile, out);
+    }
+
+    void RunQuery(ProfileQuery& query, const ReportConfig& cfg)
+    {
+        query.SetFocus(cfg.Focus);
+        query.SetIgnore(cfg.Ignore);
+
+        if (!cfg.Peers.empty())
+            query.WritePeers(cout, cfg.Peers, cfg.TopCount);
+        else if (cfg.Sources)
+            query.WriteSources(cout, cfg.TopCount, cfg.SortByTotal);
+        else
+            query.WriteTop(cout, cfg.TopCount, cfg.SortByTotal);
+    }
+
+    void ProcessReport(const ReportConfig& cfg)
+    {
+        // 导出时经由统一的加载器载入，二进制与折叠文本均可转换为其他格式
+        if (!cfg.Export.empty())
+        {
+            Profile profile;
+            LoadProfile(cfg.File, profile);
+            WriteProfile(profile, cfg.Export, cfg.Output);
+            return;
+        }
+
+        // 二进制文件直接在映射的内存上查询，其他格式先载入内存
+        if (IsBinaryProfile(cfg.File))
+        {
+            BinaryProfile binary(cfg.File);
+            ProfileQuery query(binary);
+            RunQuery(query, cfg);
+        }
+        else
+        {
+            Profile profile;
+            LoadProfile(cfg.File, profile);
+            ProfileQuery query(profile);
+            RunQuery(query, cfg);
         }
+    }
+
+    ReportConfig GetReportCommandline(int argc, const char** argv)
+    {
+        ReportConfig cfg;
+        bool needHelp = false;
+
+        CmdParser parser;
+        parser << CmdParser::Option(cfg.File, "file", 'f', "Specific the profile to query (binary or folded)");
+        parser << CmdParser::Option(needHelp, "help", 'h', "Show this help", false);
+        parser << CmdParser::Option(cfg.Verbose, "verbose", 'v', "Show debug log", false);
+        parser << CmdParser::Option(cfg.TopCount, "top", 'n', "Specific entry count", 20u);
+        parser << CmdParser::Option(cfg.SortByTotal, "total", 't', "Sort by total samples instead of self samples",
+            false);
+        parser << CmdParser::Option(cfg.Focus, "focus", 'F', "Only keep samples containing frames matching the regex",
+            string());
+        parser << CmdParser::Option(cfg.Ignore, "ignore", 'I', "Drop samples containing frames matching the regex",
+            string());
+        parser << CmdParser::Option(cfg.Sources, "sources", 'S', "Aggregate by source file", false);
+        parser << CmdParser::Option(cfg.Peers, "peers", 'P', "Show callers and callees of functions matching the regex",
+            string());
+        parser << CmdParser::Option(cfg.Export, "export", 'e',
+            "Convert the profile instead of querying (binary, folded, pprof, callgrind, svg, html)", string());
+        parser << CmdParser::Option(cfg.Output, "output", 'o', "Specific the export file (default stdout)", string());
+
+        ParseCommandline(parser, argc, argv, "lperf report", needHelp);
+        return cfg;
+    }
+
+    void ProcessTop(const TopConfig& cfg)
+    {
+        auto customEntryPoints = MakeCustomHookEntries(cfg.HookEntry);
+
+        shared_ptr<Debugger> debugger = make_shared<Debugger>(cfg.Pid);
+        LuaSampler sampler(*debugger.get());
+        LiveTop top(cfg.HalfLife, cfg.LineMode);
+
+        MOE_LOG_DEBUG("Fetching lua_State*");
+        auto L = sampler.FetchLuaState(customEntryPoints);
+
+        StopSignalScope stopScope;
+        auto lastRefresh = chrono::steady_clock::now();
+        while (!s_bStopRequested)
+        {
+            this_thread::sleep_for(chrono::milliseconds(cfg.SampleInterval));
+            if (s_bStopRequested)
+                break;
+            if (debugger->GetStatus() == ProcessStatus::Terminated)
+            {
+                MOE_LOG_WARN("Target terminated, stop sampling");
+                break;
+            }
+
+            try
+            {
+                top.OnSample(sampler.DumpStack(L));
+            }
+            catch (const ExceptionBase& ex)
+            {
+                MOE_LOG_ERROR("Capture frame failure: {0}", ex.GetDescription());
+            }
+
+            auto now = chrono::steady_clock::now();
+            auto elapsed = chrono::duration_cast<chrono::duration<double>>(now - lastRefresh).count();
+            if (elapsed >= cfg.RefreshInterval / 1000.)
+            {
+                top.Update(elapsed);
+                lastRefresh = now;
+
+                // 清屏后重绘
+                cout << "\x1b[H\x1b[2J" << "lperf top - pid " << cfg.Pid << ", interval " << cfg.SampleInterval <<
+                    "ms, half-life " << cfg.HalfLife << "s\n";
+                top.Write(cout, cfg.TopCount);
+            }
+        }
+    }
+
+    TopConfig GetTopCommandline(int argc, const char** argv)
+    {
+        TopConfig cfg;
+        bool needHelp = false;
+
+        CmdParser parser;
+        parser << CmdParser::Option(cfg.Pid, "pid", 'p', "Specific the process id");
+        parser << CmdParser::Option(needHelp, "help", 'h', "Show this help", false);
+        parser << CmdParser::Option(cfg.Verbose, "verbose", 'v', "Show debug log", false);
+        parser << CmdParser::Option(cfg.SampleInterval, "interval", 'i', "Specific sample interval (ms)", 10u);
+        parser << CmdParser::Option(cfg.RefreshInterval, "refresh", 'R', "Specific refresh interval (ms)", 1000u);
+        parser << CmdParser::Option(cfg.HalfLife, "decay", 'd', "Specific half-life of the decaying window (s)", 5u);
+        parser << CmdParser::Option(cfg.TopCount, "top", 'n', "Specific function count", 30u);
+        parser << CmdParser::Option(cfg.LineMode, "line", 'l', "Attribute lua frames to current line", false);
+        parser << CmdParser::Option(cfg.HookEntry, "hook", 'k',
+            "Specific custom hook entry address (must be a lua api), eg: -k 0x12FFBB0,12345678", string());
+
+        ParseCommandline(parser, argc, argv, "lperf top", needHelp);
         return cfg;
     }
+
+    void ProcessDaemon(const DaemonConfig& cfg)
+    {
+        if (cfg.HttpPort > 65535)
+            MOE_THROW(BadArgumentException, "Invalid http port {0}", cfg.HttpPort);
+
+        DaemonOptions options;
+        options.SocketPath = cfg.Socket;
+        options.HttpPort = static_cast<uint16_t>(cfg.HttpPort);
+        options.DefaultInterval = cfg.SampleInterval;
+
+        StopSignalScope stopScope;
+        Daemon daemon(options);
+        daemon.Run([]() { return s_bStopRequested != 0; });
+    }
+
+    DaemonConfig GetDaemonCommandline(int argc, const char** argv)
+    {
+        DaemonConfig cfg;
+        bool needHelp = false;
+
+        CmdParser parser;
+        parser << CmdParser::Option(needHelp, "help", 'h', "Show this help", false);
+        parser << CmdParser::Option(cfg.Verbose, "verbose", 'v', "Show debug log", false);
+        parser << CmdParser::Option(cfg.Socket, "socket", 's', "Specific the control socket path",
+            string("/tmp/lperfd.sock"));
+        parser << CmdParser::Option(cfg.HttpPort, "http", 'H', "Serve pprof over http on 127.0.0.1:PORT (0 to disable)",
+            0u);
+        parser << CmdParser::Option(cfg.SampleInterval, "interval", 'i', "Specific default sample interval (ms)", 10u);
+
+        ParseCommandline(parser, argc, argv, "lperfd", needHelp);
+        return cfg;
+    }
+
+    void ProcessMerge(const MergeConfig& cfg)
+    {
+        vector<ProfileMerger::Input> inputs;
+        if (!cfg.Manifest.empty())
+        {
+            ifstream in(cfg.Manifest);
+            if (!in)
+                MOE_THROW(ApiException, "Cannot open manifest \"{0}\"", cfg.Manifest);
+            inputs = ReadMergeManifest(in);
+        }
+        vector<string> files;
+        StringUtils::Split(files, cfg.Files, ',', StringUtils::SplitFlags::RemoveEmptyEntries);
+        for (auto& file : files)
+        {
+            ProfileMerger::Input input;
+            input.Path = std::move(file);
+            inputs.emplace_back(std::move(input));
+        }
+        if (inputs.empty())
+            MOE_THROW(BadArgumentException, "No input profile");
+
+        vector<string> groupKeys;
+        StringUtils::Split(groupKeys, cfg.GroupBy, ',', StringUtils::SplitFlags::RemoveEmptyEntries);
+
+        ProfileMerger merger(groupKeys, cfg.Jobs);
+        merger.Merge(inputs);
+        auto& profile = merger.GetResult();
+        MOE_LOG_INFO("Merged {0} profiles, {1} stacks, {2} samples", merger.GetInputCount(), profile.GetStackCount(),
+            profile.GetTotalSampleCount());
+
+        WriteProfile(profile, cfg.Format, cfg.Output);
+    }
+
+    MergeConfig GetMergeCommandline(int argc, const char** argv)
+    {
+        MergeConfig cfg;
+        bool needHelp = false;
+
+        CmdParser parser;
+        parser << CmdParser::Option(cfg.Output, "output", 'o', "Specific the output file");
+        parser << CmdParser::Option(needHelp, "help", 'h', "Show this help", false);
+        parser << CmdParser::Option(cfg.Verbose, "verbose", 'v', "Show debug log", false);
+        parser << CmdParser::Option(cfg.Files, "files", 'f', "Specific input profiles separated by comma", string());
+        parser << CmdParser::Option(cfg.Manifest, "manifest", 'm',
+            "Specific a manifest file, each line is \"path [key=value ...]\"", string());
+        parser << CmdParser::Option(cfg.GroupBy, "group", 'g',
+            "Group stacks by labels separated by comma, eg: -g host,build-id", string());
+        parser << CmdParser::Option(cfg.Jobs, "jobs", 'j', "Specific how many inputs are loaded concurrently", 4u);
+        parser << CmdParser::Option(cfg.Format, "report", 'r', "Specific output format (binary, folded, pprof, callgrind, svg, html)",
+            string("binary"));
+
+        ParseCommandline(parser, argc, argv, "lperf merge", needHelp);
+        return cfg;
+    }
+
+    uint64_t GetWallClockTime()
+    {
+        return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+            chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    void ProcessRecord(const RecordConfig& cfg)
+    {
+        if (cfg.SegmentDuration == 0)
+            MOE_THROW(BadArgumentException, "Segment duration must be positive");
+
+        auto customEntryPoints = MakeCustomHookEntries(cfg.HookEntry);
+
+        SegmentStore store(cfg.Directory, static_cast<uint64_t>(cfg.Budget) * 1024 * 1024);
+        shared_ptr<Debugger> debugger = make_shared<Debugger>(cfg.Pid);
+        LuaSampler sampler(*debugger.get());
+
+        ReportOptions options;
+        options.SampleInterval = cfg.SampleInterval;
+        CollectProcessInfo(*debugger, options);
+
+        MOE_LOG_DEBUG("Fetching lua_State*");
+        auto L = sampler.FetchLuaState(customEntryPoints);
+
+        // 采样累计到同一个 Profile 中，每个分段只导出增量，因此内存只与不同堆栈的数量相关
+        Profile samples(cfg.LineMode);
+        auto segmentStart = GetWallClockTime();
+        auto lastFlush = chrono::steady_clock::now();
+        auto flush = [&]() {
+            Profile segment(cfg.LineMode);
+            segment.SetPeriod(static_cast<uint64_t>(cfg.SampleInterval) * 1000000u);
+            segment.SetStartTime(segmentStart);
+            segmentStart = GetWallClockTime();
+            segment.SetDuration(segmentStart - segment.GetStartTime());
+            for (const auto& mapping : options.Mappings)
+                segment.AddMapping(mapping.Start, mapping.End, mapping.Offset, mapping.Path);
+            for (const auto& label : options.Labels)
+                segment.SetLabel(label.first, label.second);
+            samples.ExportDelta(segment);
+            samples.ResetDelta();
+
+            if (segment.GetTotalSampleCount() == 0)
+                return;
+            try
+            {
+                store.Write(segment);
+                MOE_LOG_INFO("Wrote segment, {0} samples, {1} stacks", segment.GetTotalSampleCount(),
+                    segment.GetStackCount());
+            }
+            catch (const ExceptionBase& ex)
+            {
+                MOE_LOG_ERROR("Write segment failure: {0}", ex.GetDescription());
+            }
+        };
+
+        StopSignalScope stopScope;
+        while (!s_bStopRequested)
+        {
+            this_thread::sleep_for(chrono::milliseconds(cfg.SampleInterval));
+            if (s_bStopRequested)
+                break;
+            if (debugger->GetStatus() == ProcessStatus::Terminated)
+            {
+                MOE_LOG_WARN("Target terminated, stop sampling");
+                break;
+            }
+
+            try
+            {
+                auto id = samples.InternStack(sampler.DumpStack(L));
+                if (id != INVALID_PROFILE_ID)
+                    samples.AddSample(id);
+            }
+            catch (const ExceptionBase& ex)
+            {
+                MOE_LOG_ERROR("Capture frame failure: {0}", ex.GetDescription());
+            }
+
+            auto now = chrono::steady_clock::now();
+            if (now - lastFlush >= chrono::seconds(cfg.SegmentDuration))
+            {
+                flush();
+                lastFlush = now;
+            }
+        }
+        flush();
+    }
+
+    RecordConfig GetRecordCommandline(int argc, const char** argv)
+    {
+        RecordConfig cfg;
+        bool needHelp = false;
+
+        CmdParser parser;
+        parser << CmdParser::Option(cfg.Pid, "pid", 'p', "Specific the process id");
+        parser << CmdParser::Option(cfg.Directory, "dir", 'd', "Specific the segment directory");
+        parser << CmdParser::Option(needHelp, "help", 'h', "Show this help", false);
+        parser << CmdParser::Option(cfg.Verbose, "verbose", 'v', "Show debug log", false);
+        parser << CmdParser::Option(cfg.SampleInterval, "interval", 'i', "Specific sample interval (ms)", 100u);
+        parser << CmdParser::Option(cfg.SegmentDuration, "segment", 'S', "Specific segment duration (s)", 60u);
+        parser << CmdParser::Option(cfg.Budget, "budget", 'B',
+            "Specific disk budget (MB), the oldest segments are removed when exceeded (0 for unlimited)", 512u);
+        parser << CmdParser::Option(cfg.LineMode, "line", 'l', "Attribute lua frames to current line", false);
+        parser << CmdParser::Option(cfg.HookEntry, "hook", 'k',
+            "Specific custom hook entry address (must be a lua api), eg: -k 0x12FFBB0,12345678", string());
+
+        ParseCommandline(parser, argc, argv, "lperf record", needHelp);
+        return cfg;
+    }
+
+    /**
+     * @brief 解析时间
+     * @param text UNIX时间（秒）、"YYYY-MM-DD HH:MM[:SS]" 或当天的 "HH:MM[:SS]"（本地时间）
+     * @return UNIX时间（纳秒）
+     */
+    uint64_t ParseTime(const string& text)
+    {
+        if (!text.empty() && text.find_first_not_of("0123456789") == string::npos)
+            return static_cast<uint64_t>(stoull(text)) * 1000000000u;
+
+        static const char* const FORMATS[] = { "%Y-%m-%d %H:%M:%S", "%Y-%m-%d %H:%M", "%H:%M:%S", "%H:%M" };
+        for (auto format : FORMATS)
+        {
+            auto now = time(nullptr);
+            struct tm tm;
+            ::localtime_r(&now, &tm);
+            tm.tm_sec = 0;
+
+            auto end = ::strptime(text.c_str(), format, &tm);
+            if (!end || *end != '\0')
+                continue;
+            tm.tm_isdst = -1;
+            auto ret = ::mktime(&tm);
+            if (ret < 0)
+                break;
+            return static_cast<uint64_t>(ret) * 1000000000u;
+        }
+        MOE_THROW(BadFormatException, "Invalid time \"{0}\"", text);
+    }
+
+    void ProcessQuery(const QueryConfig& cfg)
+    {
+        auto from = cfg.From.empty() ? 0 : ParseTime(cfg.From);
+        auto to = cfg.To.empty() ? GetWallClockTime() : ParseTime(cfg.To);
+        if (from > to)
+            MOE_THROW(BadArgumentException, "Invalid time range");
+
+        SegmentStore store(cfg.Directory, 0, true);
+        auto segments = store.Query(from, to);
+        if (segments.empty())
+            MOE_THROW(ObjectNotFoundException, "No segment in the time range");
+
+        vector<ProfileMerger::Input> inputs;
+        for (const auto& segment : segments)
+        {
+            ProfileMerger::Input input;
+            input.Path = store.GetPath(segment);
+            inputs.emplace_back(std::move(input));
+        }
+
+        ProfileMerger merger({});
+        merger.Merge(inputs);
+        auto& profile = merger.GetResult();
+        MOE_LOG_INFO("Merged {0} segments, {1} stacks, {2} samples", merger.GetInputCount(), profile.GetStackCount(),
+            profile.GetTotalSampleCount());
+
+        WriteProfile(profile, cfg.Format, cfg.Output);
+    }
+
+    QueryConfig GetQueryCommandline(int argc, const char** argv)
+    {
+        QueryConfig cfg;
+        bool needHelp = false;
+
+        CmdParser parser;
+        parser << CmdParser::Option(cfg.Directory, "dir", 'd', "Specific the segment directory");
+        parser << CmdParser::Option(needHelp, "help", 'h', "Show this help", false);
+        parser << CmdParser::Option(cfg.Verbose, "verbose", 'v', "Show debug log", false);
+        parser << CmdParser::Option(cfg.From, "from", 'f',
+            "Specific the start time, eg: 1537500000, \"2018-09-28 03:10\", 03:10 (default the earliest)", string());
+        parser << CmdParser::Option(cfg.To, "to", 't', "Specific the end time (default now)", string());
+        parser << CmdParser::Option(cfg.Output, "output", 'o', "Specific the output file (default stdout)", string());
+        parser << CmdParser::Option(cfg.Format, "report", 'r', "Specific output format (binary, folded, pprof, callgrind, svg, html)",
+            string("folded"));
+
+        ParseCommandline(parser, argc, argv, "lperf query", needHelp);
+        return cfg;
+    }
+
+    void InitLogging(bool verbose)
+    {
+        if (verbose)
+        {
+            auto sink = make_shared<Logging::TerminalSink>();
+            auto formatter = make_shared<Logging::AnsiColorFormatter>();
+            sink->SetFormatter(formatter);
+            Logging::GetInstance().AppendSink(sink);
+        }
+        else
+        {
+            auto errSink = make_shared<Logging::TerminalSink>(Logging::TerminalSink::OutputType::StdErr);
+            auto errFormatter = make_shared<Logging::AnsiColorFormatter>();
+            errFormatter->SetFormat("{level}: {msg}");
+            errSink->SetFormatter(errFormatter);
+            errSink->SetMinLevel(Logging::Level::Warn);
+            Logging::GetInstance().AppendSink(errSink);
+        }
+        Logging::GetInstance().Commit();
+    }
+
+    template <typename T>
+    int RunCommand(T&& func)
+    {
+        try
+        {
+            func();
+        }
+        catch (const ExceptionBase& ex)
+        {
+            MOE_LOG_FATAL("{0}", ex.GetDescription());
+            return 1;
+        }
+        catch (const exception& ex)
+        {
+            MOE_LOG_FATAL("{0}", ex.what());
+            return 1;
+        }
+        return 0;
+    }
 }
 
 int main(int argc, const char** argv)
 {
-    // 解析命令行
-    auto config = GetCommandline(argc, argv);
+    // 以 lperfd 为名启动时作为常驻服务
+    auto programName = PathUtils::GetFileName(argv[0]);
+    if (string(programName.GetBuffer(), programName.GetSize()) == "lperfd")
+    {
+        auto config = GetDaemonCommandline(argc, argv);
+        InitLogging(config.Verbose);
+        return RunCommand([&]() { ProcessDaemon(config); });
+    }
 
-    // 初始化日志
-    if (config.Verbose)
+    // 子命令
+    if (argc >= 2 && strcmp(argv[1], "daemon") == 0)
     {
-        auto sink = make_shared<Logging::TerminalSink>();
-        auto formatter = make_shared<Logging::AnsiColorFormatter>();
-        sink->SetFormatter(formatter);
-        Logging::GetInstance().AppendSink(sink);
+        auto config = GetDaemonCommandline(argc - 1, argv + 1);
+        InitLogging(config.Verbose);
+        return RunCommand([&]() { ProcessDaemon(config); });
     }
-    else
+    if (argc >= 2 && strcmp(argv[1], "diff") == 0)
     {
-        auto errSink = make_shared<Logging::TerminalSink>(Logging::TerminalSink::OutputType::StdErr);
-        auto errFormatter = make_shared<Logging::AnsiColorFormatter>();
-        errFormatter->SetFormat("{level}: {msg}");
-        errSink->SetFormatter(errFormatter);
-        errSink->SetMinLevel(Logging::Level::Warn);
-        Logging::GetInstance().AppendSink(errSink);
+        auto config = GetDiffCommandline(argc - 1, argv + 1);
+        InitLogging(config.Verbose);
+        return RunCommand([&]() { ProcessDiff(config); });
     }
-    Logging::GetInstance().Commit();
-
-    try
+    if (argc >= 2 && strcmp(argv[1], "report") == 0)
+    {
+        auto config = GetReportCommandline(argc - 1, argv + 1);
+        InitLogging(config.Verbose);
+        return RunCommand([&]() { ProcessReport(config); });
+    }
+    if (argc >= 2 && strcmp(argv[1], "top") == 0)
     {
-        Process(config);
+        auto config = GetTopCommandline(argc - 1, argv + 1);
+        InitLogging(config.Verbose);
+        return RunCommand([&]() { ProcessTop(config); });
     }
-    catch (const ExceptionBase& ex)
+    if (argc >= 2 && strcmp(argv[1], "merge") == 0)
+    {
+        auto config = GetMergeCommandline(argc - 1, argv + 1);
+        InitLogging(config.Verbose);
+        return RunCommand([&]() { ProcessMerge(config); });
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "record") == 0)
     {
-        MOE_LOG_FATAL("{0}", ex.GetDescription());
-        return 1;
+        auto config = GetRecordCommandline(argc - 1, argv + 1);
+        InitLogging(config.Verbose);
+        return RunCommand([&]() { ProcessRecord(config); });
     }
-    catch (const exception& ex)
+    if (argc >= 2 && strcmp(argv[1], "query") == 0)
     {
-        MOE_LOG_FATAL("{0}", ex.what());
-        return 1;
+        auto config = GetQueryCommandline(argc - 1, argv + 1);
+        InitLogging(config.Verbose);
+        return RunCommand([&]() { ProcessQuery(config); });
     }
-    return 0;
+
+    // 解析命令行
+    auto config = GetCommandline(argc, argv);
+
+    // 初始化日志
+    InitLogging(config.Verbose);
+
+    return RunCommand([&]() { Process(config); });
 }
@@ -0,0 +1,212 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "MultiSampler.hpp"
+
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <Moe.Core/Logging.hpp>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+struct MultiSampler::Target
+{
+    ProcessId Pid = 0;
+    size_t Index = 0;
+
+    unique_ptr<LuaSampler> Sampler;  // 解除挂接后保留，以便访问 Proto 缓存
+    unique_ptr<Debugger> Process;
+    uintptr_t LuaState = 0;
+    bool Attached = false;
+
+    bool Finished = false;
+    uint64_t SampleCount = 0;
+    Clock::time_point NextSample;
+};
+
+namespace
+{
+    std::mutex s_stAttachLock;
+}
+
+MultiSampler::MultiSampler(const std::vector<ProcessId>& pids, const MultiSamplerOptions& options)
+    : m_stOptions(options)
+{
+    if (pids.empty())
+        MOE_THROW(BadArgumentException, "No process to sample");
+    if (m_stOptions.SampleInterval == 0)
+        MOE_THROW(BadArgumentException, "Sample interval must be positive");
+
+    for (size_t i = 0; i < pids.size(); ++i)
+    {
+        unique_ptr<Target> target(new Target());
+        target->Pid = pids[i];
+        target->Index = i;
+        m_stTargets.emplace_back(std::move(target));
+    }
+}
+
+MultiSampler::~MultiSampler()
+{
+}
+
+void MultiSampler::Run(const AttachCallback& onAttach, const SampleCallback& onSample,
+    const std::function<bool()>& stopRequested)
+{
+    size_t workerCount = m_stOptions.Threads;
+    if (workerCount == 0)
+        workerCount = max(thread::hardware_concurrency(), 1u);
+    workerCount = min(workerCount, m_stTargets.size());
+    MOE_LOG_INFO("Sampling {0} processes with {1} threads", m_stTargets.size(), workerCount);
+
+    auto start = Clock::now();
+    vector<thread> workers;
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back([&, i]() {
+            RunWorker(i, workerCount, start, onAttach, onSample, stopRequested);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+}
+
+ProcessId MultiSampler::GetPid(size_t index)const noexcept
+{
+    assert(index < m_stTargets.size());
+    return m_stTargets[index]->Pid;
+}
+
+bool MultiSampler::IsAttached(size_t index)const noexcept
+{
+    assert(index < m_stTargets.size());
+    return m_stTargets[index]->Attached;
+}
+
+const ProtoCache* MultiSampler::GetProtoCache(size_t index)const noexcept
+{
+    assert(index < m_stTargets.size());
+    const auto& target = *m_stTargets[index];
+    return target.Attached ? &target.Sampler->GetProtoCache() : nullptr;
+}
+
+void MultiSampler::RunWorker(size_t worker, size_t workerCount, Clock::time_point start,
+    const AttachCallback& onAttach, const SampleCallback& onSample, const std::function<bool()>& stopRequested)
+{
+    // 进程按序号轮流分配给线程，之后只由该线程访问
+    vector<Target*> targets;
+    for (size_t i = worker; i < m_stTargets.size(); i += workerCount)
+        targets.push_back(m_stTargets[i].get());
+
+    auto finish = [](Target& target) {
+        target.Finished = true;
+        target.Process.reset();  // 在挂接的线程中解除挂接
+    };
+
+    // 挂接
+    for (auto target : targets)
+    {
+        if (stopRequested())
+        {
+            target->Finished = true;
+            continue;
+        }
+
+        try
+        {
+            target->Process.reset(new Debugger(target->Pid));
+            target->Sampler.reset(new LuaSampler(*target->Process));
+            target->Sampler->GetStringCache().SetCapacity(m_stOptions.StringCacheCapacity);
+
+            MOE_LOG_DEBUG("Fetching lua_State* of process {0}", target->Pid);
+            target->LuaState = target->Sampler->FetchLuaState(m_stOptions.CustomEntryPoints);
+
+            lock_guard<mutex> guard(s_stAttachLock);
+            if (onAttach)
+                onAttach(target->Index, *target->Process, *target->Sampler);
+            target->Attached = true;
+        }
+        catch (const ExceptionBase& ex)
+        {
+            MOE_LOG_ERROR("Attach to process {0} failure: {1}", target->Pid, ex.GetDescription());
+            finish(*target);
+        }
+        catch (const std::exception& ex)
+        {
+            MOE_LOG_ERROR("Attach to process {0} failure: {1}", target->Pid, ex.what());
+            finish(*target);
+        }
+    }
+
+    // 按全局序号错开相位
+    auto interval = chrono::duration_cast<Clock::duration>(chrono::milliseconds(m_stOptions.SampleInterval));
+    for (auto target : targets)
+        target->NextSample = start + interval * target->Index / m_stTargets.size();
+
+    while (!stopRequested())
+    {
+        Target* next = nullptr;
+        for (auto target : targets)
+        {
+            if (!target->Finished && (!next || target->NextSample < next->NextSample))
+                next = target;
+        }
+        if (!next)
+            break;
+
+        // 分段休眠，以便及时响应停止请求
+        auto now = Clock::now();
+        if (next->NextSample > now)
+        {
+            this_thread::sleep_for(min<Clock::duration>(next->NextSample - now, chrono::milliseconds(100)));
+            continue;
+        }
+
+        auto& target = *next;
+        if (target.Process->GetStatus() == ProcessStatus::Terminated)
+        {
+            MOE_LOG_WARN("Process {0} terminated, stop sampling", target.Pid);
+            finish(target);
+            continue;
+        }
+
+        try
+        {
+            SampleInfo info;
+            info.Time = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+                Clock::now().time_since_epoch()).count());
+            info.Thread = target.LuaState;
+
+            auto stack = target.Sampler->DumpStack(target.LuaState);
+            onSample(target.Index, stack, info);
+        }
+        catch (const ExceptionBase& ex)
+        {
+            MOE_LOG_ERROR("Capture frame of process {0} failure: {1}", target.Pid, ex.GetDescription());
+        }
+        catch (const std::exception& ex)
+        {
+            MOE_LOG_ERROR("Capture frame of process {0} failure: {1}", target.Pid, ex.what());
+        }
+
+        if (m_stOptions.SampleCount > 0 && ++target.SampleCount >= m_stOptions.SampleCount)
+        {
+            finish(target);
+            continue;
+        }
+
+        // 落后时跳过错过的时刻，保持相位不变
+        target.NextSample += interval;
+        now = Clock::now();
+        if (target.NextSample <= now)
+            target.NextSample += interval * ((now - target.NextSample) / interval + 1);
+    }
+
+    for (auto target : targets)
+        finish(*target);
+}
@@ -0,0 +1,373 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "PProfWriter.hpp"
+#include "GzipStream.hpp"
+
+#include <cstdio>
+#include <cinttypes>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+namespace
+{
+    enum WireType
+    {
+        WIRE_VARINT = 0,
+        WIRE_LENGTH_DELIMITED = 2,
+    };
+
+    // profile.proto 字段编号
+    enum ProfileField
+    {
+        PROFILE_SAMPLE_TYPE = 1,
+        PROFILE_SAMPLE = 2,
+        PROFILE_MAPPING = 3,
+        PROFILE_LOCATION = 4,
+        PROFILE_FUNCTION = 5,
+        PROFILE_STRING_TABLE = 6,
+        PROFILE_TIME_NANOS = 9,
+        PROFILE_DURATION_NANOS = 10,
+        PROFILE_PERIOD_TYPE = 11,
+        PROFILE_PERIOD = 12,
+        PROFILE_COMMENT = 13,
+    };
+
+    void AppendVarint(std::string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    /**
+     * @brief 简单的 protobuf 编码器
+     */
+    class ProtoBuffer
+    {
+    public:
+        const std::string& GetData()const noexcept { return m_stData; }
+
+        void Clear()noexcept { m_stData.clear(); }
+
+        void WriteTag(unsigned field, WireType type)
+        {
+            AppendVarint(m_stData, (static_cast<uint64_t>(field) << 3) | type);
+        }
+
+        void WriteUInt64(unsigned field, uint64_t value)
+        {
+            if (value == 0)  // proto3 默认值无需编码
+                return;
+            WriteTag(field, WIRE_VARINT);
+            AppendVarint(m_stData, value);
+        }
+
+        void WriteBool(unsigned field, bool value)
+        {
+            WriteUInt64(field, value ? 1 : 0);
+        }
+
+        void WriteBytes(unsigned field, const std::string& data)
+        {
+            WriteTag(field, WIRE_LENGTH_DELIMITED);
+            AppendVarint(m_stData, data.size());
+            m_stData.append(data);
+        }
+
+        void WriteMessage(unsigned field, const ProtoBuffer& message)
+        {
+            WriteBytes(field, message.GetData());
+        }
+
+        void WritePacked(unsigned field, const std::vector<uint64_t>& values)
+        {
+            if (values.empty())
+                return;
+
+            m_stPacked.clear();
+            for (auto v : values)
+                AppendVarint(m_stPacked, v);
+            WriteBytes(field, m_stPacked);
+        }
+
+    private:
+        std::string m_stData;
+        std::string m_stPacked;
+    };
+
+    /**
+     * @brief 流式输出顶层字段
+     *
+     * 每个子消息编码完成后立即压缩写出，内存占用与单个条目大小相关。
+     */
+    class ProfileEncoder
+    {
+    public:
+        ProfileEncoder(std::ostream& out)
+            : m_stOutput(out) {}
+
+    public:
+        ProtoBuffer& Begin()noexcept
+        {
+            m_stMessage.Clear();
+            return m_stMessage;
+        }
+
+        void EndMessage(unsigned field)
+        {
+            m_stField.Clear();
+            m_stField.WriteMessage(field, m_stMessage);
+            m_stOutput.Write(m_stField.GetData());
+        }
+
+        void WriteString(const std::string& str)
+        {
+            m_stField.Clear();
+            m_stField.WriteBytes(PROFILE_STRING_TABLE, str);
+            m_stOutput.Write(m_stField.GetData());
+        }
+
+        void WriteUInt64(unsigned field, uint64_t value)
+        {
+            m_stField.Clear();
+            m_stField.WriteUInt64(field, value);
+            m_stOutput.Write(m_stField.GetData());
+        }
+
+        void Finish()
+        {
+            m_stOutput.Finish();
+        }
+
+    private:
+        GzipOutputStream m_stOutput;
+        ProtoBuffer m_stMessage;
+        ProtoBuffer m_stField;
+    };
+
+    /**
+     * @brief 用于区分函数的键
+     */
+    struct FunctionKey
+    {
+        LuaFunctionType Type;
+        ProfileId Name;
+        ProfileId Source;
+        unsigned LineDefined;
+        uintptr_t Address;
+
+        bool operator==(const FunctionKey& rhs)const noexcept
+        {
+            return Type == rhs.Type && Name == rhs.Name && Source == rhs.Source && LineDefined == rhs.LineDefined &&
+                Address == rhs.Address;
+        }
+    };
+
+    struct FunctionKeyHasher
+    {
+        size_t operator()(const FunctionKey& key)const noexcept
+        {
+            size_t seed = static_cast<size_t>(key.Type);
+            seed ^= std::hash<uint64_t>()(key.Name) + 0x9E3779B9u + (seed << 6) + (seed >> 2);
+            seed ^= std::hash<uint64_t>()(key.Source) + 0x9E3779B9u + (seed << 6) + (seed >> 2);
+            seed ^= std::hash<uint64_t>()(key.LineDefined) + 0x9E3779B9u + (seed << 6) + (seed >> 2);
+            seed ^= std::hash<uint64_t>()(key.Address) + 0x9E3779B9u + (seed << 6) + (seed >> 2);
+            return seed;
+        }
+    };
+
+    /**
+     * @brief 追加在 Profile 字符串之后的额外字符串
+     */
+    class ExtraStringTable
+    {
+    public:
+        ExtraStringTable(size_t base)
+            : m_uBase(base) {}
+
+    public:
+        uint64_t Intern(const std::string& str)
+        {
+            auto it = m_stIndex.find(str);
+            if (it != m_stIndex.end())
+                return it->second;
+
+            auto id = static_cast<uint64_t>(m_uBase + m_stStrings.size());
+            m_stStrings.push_back(str);
+            m_stIndex.emplace(str, id);
+            return id;
+        }
+
+        const std::vector<std::string>& GetStrings()const noexcept { return m_stStrings; }
+
+    private:
+        size_t m_uBase = 0;
+        std::vector<std::string> m_stStrings;
+        std::unordered_map<std::string, uint64_t> m_stIndex;
+    };
+}
+
+void lperf::WritePProf(const Profile& profile, std::ostream& out)
+{
+    ProfileEncoder encoder(out);
+    ExtraStringTable extraStrings(profile.GetStringCount());
+
+    auto samplesStr = extraStrings.Intern("samples");
+    auto countStr = extraStrings.Intern("count");
+    auto cpuStr = extraStrings.Intern("cpu");
+    auto nanosecondsStr = extraStrings.Intern("nanoseconds");
+    auto unknownStr = extraStrings.Intern("?");
+
+    // 标签作为注释输出，pprof -comments 可见
+    std::vector<uint64_t> comments;
+    for (const auto& label : profile.GetLabels())
+        comments.push_back(extraStrings.Intern(profile.GetString(label.Key) + "=" + profile.GetString(label.Value)));
+
+    // sample_type: [samples/count, cpu/nanoseconds]，周期未知时没有时间
+    auto period = profile.GetPeriod();
+    {
+        auto& msg = encoder.Begin();
+        msg.WriteUInt64(1, samplesStr);
+        msg.WriteUInt64(2, countStr);
+        encoder.EndMessage(PROFILE_SAMPLE_TYPE);
+    }
+    if (period > 0)
+    {
+        auto& msg = encoder.Begin();
+        msg.WriteUInt64(1, cpuStr);
+        msg.WriteUInt64(2, nanosecondsStr);
+        encoder.EndMessage(PROFILE_SAMPLE_TYPE);
+    }
+
+    // sample
+    std::vector<uint64_t> locations;
+    std::vector<uint64_t> values(period > 0 ? 2 : 1);
+    for (ProfileId i = 0; i < profile.GetStackCount(); ++i)
+    {
+        auto count = profile.GetSampleCount(i);
+        if (count == 0)
+            continue;
+
+        // 栈顶在前
+        locations.clear();
+        for (auto node = i; node != INVALID_PROFILE_ID; node = profile.GetStack(node).Parent)
+            locations.push_back(profile.GetStack(node).Frame + 1);
+
+        values[0] = count;
+        if (period > 0)
+            values[1] = count * period;
+
+        auto& msg = encoder.Begin();
+        msg.WritePacked(1, locations);
+        msg.WritePacked(2, values);
+        encoder.EndMessage(PROFILE_SAMPLE);
+    }
+
+    // mapping
+    const auto& mappings = profile.GetMappings();
+    for (size_t i = 0; i < mappings.size(); ++i)
+    {
+        const auto& mapping = mappings[i];
+
+        auto& msg = encoder.Begin();
+        msg.WriteUInt64(1, i + 1);
+        msg.WriteUInt64(2, mapping.Start);
+        msg.WriteUInt64(3, mapping.Limit);
+        msg.WriteUInt64(4, mapping.Offset);
+        msg.WriteUInt64(5, mapping.File);
+        msg.WriteBool(7, true);  // has_functions
+        encoder.EndMessage(PROFILE_MAPPING);
+    }
+
+    // location & function
+    std::unordered_map<FunctionKey, uint64_t, FunctionKeyHasher> functionIndex;
+    std::vector<FunctionKey> functions;
+    char addressBuffer[32];
+    for (ProfileId i = 0; i < profile.GetFrameCount(); ++i)
+    {
+        const auto& frame = profile.GetFrame(i);
+        bool native = (frame.Type == LuaFunctionType::Native);
+
+        FunctionKey key { frame.Type, frame.Name, frame.Source, frame.LineDefined, native ? frame.Address : 0 };
+        uint64_t functionId = 0;
+        auto it = functionIndex.find(key);
+        if (it != functionIndex.end())
+            functionId = it->second;
+        else
+        {
+            functions.push_back(key);
+            functionId = functions.size();
+            functionIndex.emplace(key, functionId);
+        }
+
+        auto& msg = encoder.Begin();
+        msg.WriteUInt64(1, i + 1);
+        if (native)
+        {
+            auto mapping = profile.FindMapping(frame.Address);
+            if (mapping != INVALID_PROFILE_ID)
+                msg.WriteUInt64(2, mapping + 1);
+            msg.WriteUInt64(3, frame.Address);
+        }
+        {
+            ProtoBuffer line;
+            line.WriteUInt64(1, functionId);
+            line.WriteUInt64(2, profile.IsLineMode() && frame.Line != 0 ? frame.Line : frame.LineDefined);
+            msg.WriteMessage(4, line);
+        }
+        encoder.EndMessage(PROFILE_LOCATION);
+    }
+
+    for (size_t i = 0; i < functions.size(); ++i)
+    {
+        const auto& key = functions[i];
+
+        uint64_t name = key.Name;
+        if (profile.GetString(key.Name).empty())
+        {
+            if (key.Type == LuaFunctionType::Native)
+            {
+                snprintf(addressBuffer, sizeof(addressBuffer), "0x%" PRIxPTR, key.Address);
+                name = extraStrings.Intern(addressBuffer);
+            }
+            else
+                name = unknownStr;
+        }
+
+        auto& msg = encoder.Begin();
+        msg.WriteUInt64(1, i + 1);
+        msg.WriteUInt64(2, name);
+        msg.WriteUInt64(3, name);
+        msg.WriteUInt64(4, key.Source);
+        msg.WriteUInt64(5, key.LineDefined);
+        encoder.EndMessage(PROFILE_FUNCTION);
+    }
+
+    // string_table，第一项必须为空串
+    for (size_t i = 0; i < profile.GetStringCount(); ++i)
+        encoder.WriteString(profile.GetString(static_cast<ProfileId>(i)));
+    for (const auto& str : extraStrings.GetStrings())
+        encoder.WriteString(str);
+
+    encoder.WriteUInt64(PROFILE_TIME_NANOS, profile.GetStartTime());
+    encoder.WriteUInt64(PROFILE_DURATION_NANOS, profile.GetDuration());
+    {
+        auto& msg = encoder.Begin();
+        msg.WriteUInt64(1, period > 0 ? cpuStr : samplesStr);
+        msg.WriteUInt64(2, period > 0 ? nanosecondsStr : countStr);
+        encoder.EndMessage(PROFILE_PERIOD_TYPE);
+    }
+    encoder.WriteUInt64(PROFILE_PERIOD, period > 0 ? period : 1);
+    for (auto comment : comments)
+        encoder.WriteUInt64(PROFILE_COMMENT, comment);
+
+    encoder.Finish();
+}
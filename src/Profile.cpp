@@ -0,0 +1,260 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "Profile.hpp"
+
+#include <algorithm>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+namespace
+{
+    inline void HashCombine(size_t& seed, size_t value)noexcept
+    {
+        seed ^= value + 0x9E3779B9u + (seed << 6) + (seed >> 2);
+    }
+}
+
+size_t Profile::FrameHasher::operator()(const ProfileFrame& frame)const noexcept
+{
+    size_t ret = static_cast<size_t>(frame.Type);
+    HashCombine(ret, frame.Name);
+    HashCombine(ret, frame.Source);
+    HashCombine(ret, frame.LineDefined);
+    HashCombine(ret, frame.Line);
+    HashCombine(ret, frame.Address);
+    return ret;
+}
+
+Profile::Profile(bool lineMode)
+    : m_bLineMode(lineMode)
+{
+    InternString(string());  // ID 0 总是空串
+}
+
+void Profile::AddMapping(uint64_t start, uint64_t limit, uint64_t offset, const std::string& file)
+{
+    ProfileMapping mapping;
+    mapping.Start = start;
+    mapping.Limit = limit;
+    mapping.Offset = offset;
+    mapping.File = InternString(file);
+    m_stMappings.push_back(mapping);
+}
+
+ProfileId Profile::FindMapping(uint64_t address)const noexcept
+{
+    for (size_t i = 0; i < m_stMappings.size(); ++i)
+    {
+        if (m_stMappings[i].Start <= address && address < m_stMappings[i].Limit)
+            return static_cast<ProfileId>(i);
+    }
+    return INVALID_PROFILE_ID;
+}
+
+void Profile::SetLabel(const std::string& key, const std::string& value)
+{
+    ProfileLabel label;
+    label.Key = InternString(key);
+    label.Value = InternString(value);
+    for (auto& i : m_stLabels)
+    {
+        if (i.Key == label.Key)
+        {
+            i.Value = label.Value;
+            return;
+        }
+    }
+    m_stLabels.push_back(label);
+}
+
+const std::string* Profile::FindLabel(const std::string& key)const noexcept
+{
+    for (const auto& i : m_stLabels)
+    {
+        if (m_stStrings[i.Key] == key)
+            return &m_stStrings[i.Value];
+    }
+    return nullptr;
+}
+
+ProfileId Profile::InternString(const std::string& str)
+{
+    auto it = m_stStringIndex.find(str);
+    if (it != m_stStringIndex.end())
+        return it->second;
+
+    auto id = static_cast<ProfileId>(m_stStrings.size());
+    m_stStrings.push_back(str);
+    m_stStringIndex.emplace(str, id);
+    return id;
+}
+
+ProfileId Profile::InternFrame(const ProfileFrame& frame)
+{
+    auto it = m_stFrameIndex.find(frame);
+    if (it != m_stFrameIndex.end())
+        return it->second;
+
+    auto id = static_cast<ProfileId>(m_stFrames.size());
+    m_stFrames.push_back(frame);
+    m_stFrameIndex.emplace(frame, id);
+    return id;
+}
+
+ProfileId Profile::InternFrame(const LuaStackFrame& frame)
+{
+    ProfileFrame f;
+    f.Type = frame.Type;
+    f.Name = InternString(frame.Name);
+    f.Source = InternString(frame.Source);
+    f.LineDefined = frame.Line;
+    f.Line = m_bLineMode ? frame.CurrentLine : 0;
+    f.Address = frame.Address;
+    return InternFrame(f);
+}
+
+ProfileId Profile::InternStack(ProfileId parent, ProfileId frame)
+{
+    auto key = (static_cast<uint64_t>(parent) << 32) | frame;
+    auto it = m_stStackIndex.find(key);
+    if (it != m_stStackIndex.end())
+        return it->second;
+
+    auto id = static_cast<ProfileId>(m_stStacks.size());
+    ProfileStack stack;
+    stack.Parent = parent;
+    stack.Frame = frame;
+    m_stStacks.push_back(stack);
+    m_stSampleCounts.push_back(0);
+    m_stDeltaCounts.push_back(0);
+    m_stStackIndex.emplace(key, id);
+    return id;
+}
+
+ProfileId Profile::InternStack(const std::vector<LuaStackFrame>& stack)
+{
+    if (stack.empty())
+        return InternIdleStack();
+
+    auto ret = INVALID_PROFILE_ID;
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+        ret = InternStack(ret, InternFrame(*it));
+    return ret;
+}
+
+ProfileId Profile::InternIdleStack()
+{
+    ProfileFrame frame;
+    frame.Type = LuaFunctionType::Unknown;
+    frame.Name = InternString(IDLE_FRAME_NAME);
+    return InternStack(INVALID_PROFILE_ID, InternFrame(frame));
+}
+
+bool Profile::IsIdleFrame(ProfileId frame)const noexcept
+{
+    const auto& f = m_stFrames[frame];
+    return f.Type == LuaFunctionType::Unknown && m_stStrings[f.Name] == IDLE_FRAME_NAME;
+}
+
+std::vector<ProfileId> Profile::Import(const Profile& other, ProfileId root)
+{
+    vector<ProfileId> strings(other.GetStringCount(), INVALID_PROFILE_ID);
+    auto importString = [&](ProfileId id) {
+        if (strings[id] == INVALID_PROFILE_ID)
+            strings[id] = InternString(other.GetString(id));
+        return strings[id];
+    };
+
+    vector<ProfileId> frames(other.GetFrameCount());
+    for (ProfileId i = 0; i < other.GetFrameCount(); ++i)
+    {
+        auto frame = other.GetFrame(i);
+        frame.Name = importString(frame.Name);
+        frame.Source = importString(frame.Source);
+        frames[i] = InternFrame(frame);
+    }
+
+    // 父节点的ID总是小于子节点
+    vector<ProfileId> stacks(other.GetStackCount());
+    for (ProfileId i = 0; i < other.GetStackCount(); ++i)
+    {
+        const auto& stack = other.GetStack(i);
+        stacks[i] = InternStack(stack.Parent == INVALID_PROFILE_ID ? root : stacks[stack.Parent], frames[stack.Frame]);
+    }
+    return stacks;
+}
+
+std::vector<ProfileId> Profile::Merge(const Profile& other, ProfileId root)
+{
+    auto stacks = Import(other, root);
+    for (ProfileId i = 0; i < other.GetStackCount(); ++i)
+        AddSample(stacks[i], other.GetSampleCount(i));
+    return stacks;
+}
+
+void Profile::AddSample(ProfileId stack, uint64_t count)
+{
+    assert(stack < m_stStacks.size());
+    if (count == 0)
+        return;
+    if (m_stDeltaCounts[stack] == 0)
+        m_stDirtyStacks.push_back(stack);
+    m_stSampleCounts[stack] += count;
+    m_stDeltaCounts[stack] += count;
+    m_uTotalSampleCount += count;
+}
+
+void Profile::GetStackFrames(ProfileId stack, std::vector<ProfileId>& out)const
+{
+    out.clear();
+    while (stack != INVALID_PROFILE_ID)
+    {
+        const auto& node = m_stStacks[stack];
+        out.push_back(node.Frame);
+        stack = node.Parent;
+    }
+    reverse(out.begin(), out.end());
+}
+
+void Profile::ExportDelta(Profile& out)const
+{
+    unordered_map<ProfileId, ProfileId> stacks;
+    vector<ProfileId> path;
+    for (auto id : m_stDirtyStacks)
+    {
+        // 找到最近的已导出的祖先，再自上而下驻留
+        path.clear();
+        auto parent = INVALID_PROFILE_ID;
+        for (auto node = id; node != INVALID_PROFILE_ID; node = m_stStacks[node].Parent)
+        {
+            auto it = stacks.find(node);
+            if (it != stacks.end())
+            {
+                parent = it->second;
+                break;
+            }
+            path.push_back(node);
+        }
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+        {
+            auto frame = m_stFrames[m_stStacks[*it].Frame];
+            frame.Name = out.InternString(m_stStrings[frame.Name]);
+            frame.Source = out.InternString(m_stStrings[frame.Source]);
+            parent = out.InternStack(parent, out.InternFrame(frame));
+            stacks.emplace(*it, parent);
+        }
+        out.AddSample(parent, m_stDeltaCounts[id]);
+    }
+}
+
+void Profile::ResetDelta()noexcept
+{
+    for (auto id : m_stDirtyStacks)
+        m_stDeltaCounts[id] = 0;
+    m_stDirtyStacks.clear();
+}
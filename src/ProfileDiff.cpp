@@ -0,0 +1,257 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "ProfileDiff.hpp"
+#include "Report.hpp"
+
+#include <cmath>
+#include <ostream>
+#include <algorithm>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+static const double CONFIDENCE_Z = 1.96;  // 95%置信度
+static const double FALSE_DISCOVERY_RATE = 0.05;
+
+namespace
+{
+    string FormatRatio(double ratio)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%7.2f%%", ratio * 100.);
+        return buffer;
+    }
+
+    string FormatDelta(const DiffEntry& entry)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%+8.2f%% +/-%5.2f%%", entry.Delta * 100., entry.Error * 100.);
+        return buffer;
+    }
+
+    /**
+     * @brief 选出超出噪声范围、差异最大的条目
+     */
+    vector<const DiffEntry*> SelectTop(const vector<DiffEntry>& entries, unsigned topCount)
+    {
+        vector<const DiffEntry*> ret;
+        for (const auto& e : entries)
+        {
+            if (e.IsSignificant())
+                ret.push_back(&e);
+        }
+        sort(ret.begin(), ret.end(), [](const DiffEntry* lhs, const DiffEntry* rhs) {
+            return fabs(lhs->Delta) > fabs(rhs->Delta);
+        });
+        if (ret.size() > topCount)
+            ret.resize(topCount);
+        return ret;
+    }
+}
+
+ProfileDiff::ProfileDiff(const Profile& base, const Profile& compare)
+    : m_stProfile(base.IsLineMode()), m_uBaseTotal(base.GetTotalSampleCount()),
+    m_uCompareTotal(compare.GetTotalSampleCount())
+{
+    auto baseStacks = m_stProfile.Import(base);
+    m_stProfile.Merge(compare);
+
+    m_stBaseSelfCounts.resize(m_stProfile.GetStackCount());
+    for (ProfileId i = 0; i < base.GetStackCount(); ++i)
+        m_stBaseSelfCounts[baseStacks[i]] += base.GetSampleCount(i);
+}
+
+std::vector<DiffEntry> ProfileDiff::GetFunctionDiff(bool self)const
+{
+    vector<uint64_t> baseCounts(m_stProfile.GetFrameCount());
+    vector<uint64_t> compareCounts(m_stProfile.GetFrameCount());
+    vector<ProfileId> lastStack(m_stProfile.GetFrameCount(), INVALID_PROFILE_ID);
+    for (ProfileId i = 0; i < m_stProfile.GetStackCount(); ++i)
+    {
+        auto baseCount = m_stBaseSelfCounts[i];
+        auto compareCount = m_stProfile.GetSampleCount(i);
+        if (baseCount == 0 && compareCount == 0)
+            continue;
+
+        if (self)
+        {
+            auto frame = m_stProfile.GetStack(i).Frame;
+            baseCounts[frame] += baseCount;
+            compareCounts[frame] += compareCount;
+            continue;
+        }
+
+        // 递归调用时只计一次
+        for (auto node = i; node != INVALID_PROFILE_ID; node = m_stProfile.GetStack(node).Parent)
+        {
+            auto frame = m_stProfile.GetStack(node).Frame;
+            if (lastStack[frame] == i)
+                continue;
+            lastStack[frame] = i;
+            baseCounts[frame] += baseCount;
+            compareCounts[frame] += compareCount;
+        }
+    }
+
+    vector<DiffEntry> ret(m_stProfile.GetFrameCount());
+    for (ProfileId i = 0; i < m_stProfile.GetFrameCount(); ++i)
+        ret[i] = MakeEntry(i, baseCounts[i], compareCounts[i]);
+    MarkSignificant(ret);
+    return ret;
+}
+
+std::vector<DiffEntry> ProfileDiff::GetPathDiff()const
+{
+    auto count = m_stProfile.GetStackCount();
+    vector<uint64_t> baseTotals(m_stBaseSelfCounts);
+    vector<uint64_t> compareTotals(count);
+    for (ProfileId i = 0; i < count; ++i)
+        compareTotals[i] = m_stProfile.GetSampleCount(i);
+
+    // 父节点的ID总是小于子节点
+    for (auto i = count; i > 0; --i)
+    {
+        auto parent = m_stProfile.GetStack(i - 1).Parent;
+        if (parent != INVALID_PROFILE_ID)
+        {
+            baseTotals[parent] += baseTotals[i - 1];
+            compareTotals[parent] += compareTotals[i - 1];
+        }
+    }
+
+    vector<DiffEntry> ret(count);
+    for (ProfileId i = 0; i < count; ++i)
+        ret[i] = MakeEntry(i, baseTotals[i], compareTotals[i]);
+    MarkSignificant(ret);
+    return ret;
+}
+
+void ProfileDiff::WriteText(std::ostream& out, unsigned topCount)const
+{
+    out << "base: " << m_uBaseTotal << " samples, compare: " << m_uCompareTotal << " samples" << endl << endl;
+
+    vector<string> names(m_stProfile.GetFrameCount());
+    for (ProfileId i = 0; i < m_stProfile.GetFrameCount(); ++i)
+        names[i] = FormatProfileFrame(m_stProfile, m_stProfile.GetFrame(i));
+
+    auto writeFunctions = [&](const char* title, bool self) {
+        auto entries = GetFunctionDiff(self);
+        out << title << endl;
+        out << "    base%  compare%            delta  function" << endl;
+        for (auto e : SelectTop(entries, topCount))
+        {
+            out << " " << FormatRatio(e->BaseRatio) << "  " << FormatRatio(e->CompareRatio) << "  " <<
+                FormatDelta(*e) << "  " << names[e->Id] << endl;
+        }
+        out << endl;
+    };
+    writeFunctions("== functions (self) ==", true);
+    writeFunctions("== functions (total) ==", false);
+
+    out << "== paths ==" << endl;
+    out << "    base%  compare%            delta  path" << endl;
+    vector<ProfileId> frames;
+    auto paths = GetPathDiff();
+    for (auto e : SelectTop(paths, topCount))
+    {
+        out << " " << FormatRatio(e->BaseRatio) << "  " << FormatRatio(e->CompareRatio) << "  " << FormatDelta(*e) <<
+            "  ";
+        m_stProfile.GetStackFrames(e->Id, frames);
+        for (size_t i = 0; i < frames.size(); ++i)
+        {
+            if (i != 0)
+                out << ";";
+            out << names[frames[i]];
+        }
+        out << endl;
+    }
+    out.flush();
+}
+
+void ProfileDiff::WriteFlameGraph(std::ostream& out, FlameGraphOptions options)const
+{
+    auto paths = GetPathDiff();
+    double maxDelta = 0.;
+    for (const auto& e : paths)
+    {
+        if (e.IsSignificant())
+            maxDelta = std::max(maxDelta, fabs(e.Delta));
+    }
+
+    options.Color = [&](ProfileId stack) {
+        const auto& e = paths[stack];
+        if (!e.IsSignificant() || maxDelta <= 0.)
+            return string("rgb(225,225,225)");
+
+        auto t = std::min(1., fabs(e.Delta) / maxDelta);
+        auto c = static_cast<unsigned>(220 - 190 * t);
+        char buffer[32];
+        if (e.Delta > 0)
+            snprintf(buffer, sizeof(buffer), "rgb(255,%u,%u)", c, c);
+        else
+            snprintf(buffer, sizeof(buffer), "rgb(%u,%u,255)", c, c);
+        return string(buffer);
+    };
+    options.Detail = [&](ProfileId stack) {
+        const auto& e = paths[stack];
+        return string(" base ") + FormatRatio(e.BaseRatio) + ", delta " + FormatDelta(e);
+    };
+    lperf::WriteFlameGraph(m_stProfile, out, options);
+}
+
+DiffEntry ProfileDiff::MakeEntry(ProfileId id, uint64_t base, uint64_t compare)const noexcept
+{
+    DiffEntry ret;
+    ret.Id = id;
+    ret.BaseCount = base;
+    ret.CompareCount = compare;
+    ret.BaseRatio = m_uBaseTotal == 0 ? 0. : static_cast<double>(base) / m_uBaseTotal;
+    ret.CompareRatio = m_uCompareTotal == 0 ? 0. : static_cast<double>(compare) / m_uCompareTotal;
+    ret.Delta = ret.CompareRatio - ret.BaseRatio;
+
+    // 两个比例之差的标准误差
+    double variance = 0.;
+    if (m_uBaseTotal > 0)
+        variance += ret.BaseRatio * (1. - ret.BaseRatio) / m_uBaseTotal;
+    if (m_uCompareTotal > 0)
+        variance += ret.CompareRatio * (1. - ret.CompareRatio) / m_uCompareTotal;
+    ret.Error = CONFIDENCE_Z * sqrt(variance);
+
+    // 正态近似下的双侧P值
+    if (ret.Delta == 0.)
+        ret.PValue = 1.;
+    else if (variance <= 0.)
+        ret.PValue = 0.;
+    else
+        ret.PValue = erfc(fabs(ret.Delta) / sqrt(variance) / sqrt(2.));
+    return ret;
+}
+
+void ProfileDiff::MarkSignificant(std::vector<DiffEntry>& entries)
+{
+    // Benjamini-Hochberg：P值升序排列后，找出最大的 k 使 p(k) <= k / m * q，前 k 个条目均视为显著
+    // 两边都没有采样的条目（如只在另一类统计中出现的栈帧）不计入检验的个数
+    vector<DiffEntry*> tested;
+    for (auto& e : entries)
+    {
+        e.Significant = false;
+        if (e.BaseCount > 0 || e.CompareCount > 0)
+            tested.push_back(&e);
+    }
+    sort(tested.begin(), tested.end(), [](const DiffEntry* lhs, const DiffEntry* rhs) {
+        return lhs->PValue < rhs->PValue;
+    });
+
+    size_t accepted = 0;
+    for (size_t k = 1; k <= tested.size(); ++k)
+    {
+        if (tested[k - 1]->PValue <= FALSE_DISCOVERY_RATE * k / tested.size())
+            accepted = k;
+    }
+    for (size_t i = 0; i < accepted; ++i)
+        tested[i]->Significant = true;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "ProfileLoader.hpp"
+#include "BinaryProfile.hpp"
+#include "GzipStream.hpp"
+#include "Report.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+static const char* const FOLDED_ROOT_FRAME = "(base)";
+
+ProfileFrame lperf::ParseFoldedFrame(Profile& profile, const std::string& text)
+{
+    ProfileFrame frame;
+
+    // [name] / [0x...]
+    if (text.size() >= 2 && text.front() == '[' && text.back() == ']')
+    {
+        auto name = text.substr(1, text.size() - 2);
+        if (name.compare(0, 2, "0x") == 0 && name.size() > 2 &&
+            name.find_first_not_of("0123456789abcdefABCDEF", 2) == string::npos)
+        {
+            frame.Type = LuaFunctionType::Native;
+            frame.Address = static_cast<uintptr_t>(strtoull(name.c_str() + 2, nullptr, 16));
+            return frame;
+        }
+
+        // VM内部帧（如操作码叶子帧）与本地函数使用相同的格式，以前缀区分
+        frame.Type = name.compare(0, 3, "OP_") == 0 ? LuaFunctionType::VirtualMachine : LuaFunctionType::Native;
+        frame.Name = profile.InternString(name);
+        return frame;
+    }
+
+    // name @ source:line
+    auto at = text.rfind(" @ ");
+    auto colon = text.rfind(':');
+    if (at != string::npos && colon != string::npos && colon > at && colon + 1 < text.size() &&
+        text.find_first_not_of("0123456789", colon + 1) == string::npos)
+    {
+        auto name = text.substr(0, at);
+        frame.Type = LuaFunctionType::Lua;
+        frame.Name = profile.InternString(name == "?" ? string() : name);
+        frame.Source = profile.InternString(text.substr(at + 3, colon - at - 3));
+        frame.LineDefined = static_cast<unsigned>(strtoul(text.c_str() + colon + 1, nullptr, 10));
+        return frame;
+    }
+
+    frame.Type = LuaFunctionType::Unknown;
+    frame.Name = profile.InternString(text == "?" ? string() : text);
+    return frame;
+}
+
+void lperf::LoadFoldedProfile(std::istream& in, Profile& profile)
+{
+    string line;
+    size_t lineNumber = 0;
+    while (getline(in, line))
+    {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+        if (line[0] == '#')
+        {
+            auto prefixSize = strlen(FOLDED_LABEL_PREFIX);
+            if (line.compare(0, prefixSize, FOLDED_LABEL_PREFIX) == 0)
+            {
+                auto eq = line.find('=', prefixSize);
+                if (eq != string::npos && eq > prefixSize)
+                {
+                    profile.SetLabel(UnescapeFoldedLabel(line.substr(prefixSize, eq - prefixSize)),
+                        UnescapeFoldedLabel(line.substr(eq + 1)));
+                }
+            }
+            continue;
+        }
+
+        auto space = line.rfind(' ');
+        if (space == string::npos || space + 1 >= line.size() ||
+            line.find_first_not_of("0123456789", space + 1) != string::npos)
+        {
+            MOE_THROW(BadFormatException, "Invalid folded stack at line {0}", lineNumber);
+        }
+        auto count = strtoull(line.c_str() + space + 1, nullptr, 10);
+
+        ProfileId stack = INVALID_PROFILE_ID;
+        size_t start = 0;
+        while (start < space)
+        {
+            auto end = line.find(';', start);
+            if (end == string::npos || end > space)
+                end = space;
+
+            if (end > start)
+            {
+                auto text = line.substr(start, end - start);
+                if (!(stack == INVALID_PROFILE_ID && text == FOLDED_ROOT_FRAME))
+                    stack = profile.InternStack(stack, profile.InternFrame(ParseFoldedFrame(profile, text)));
+            }
+            start = end + 1;
+        }
+
+        if (stack == INVALID_PROFILE_ID)  // 只有 "(base)" 的行是空栈的采样
+            stack = profile.InternIdleStack();
+        profile.AddSample(stack, count);
+    }
+}
+
+void lperf::LoadProfile(const std::string& path, Profile& profile)
+{
+    if (IsBinaryProfile(path))
+    {
+        BinaryProfile binary(path);
+        binary.Load(profile);
+        return;
+    }
+
+    if (IsGzipFile(path))
+    {
+        string data;
+        ReadGzipFile(path, data);
+        istringstream in(data);
+        LoadFoldedProfile(in, profile);
+        return;
+    }
+
+    ifstream in(path, ios::in | ios::binary);
+    if (!in)
+        MOE_THROW(ApiException, "Cannot open profile \"{0}\"", path);
+    LoadFoldedProfile(in, profile);
+}
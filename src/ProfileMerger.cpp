@@ -0,0 +1,205 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "ProfileMerger.hpp"
+#include "ProfileLoader.hpp"
+#include "BinaryProfile.hpp"
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <algorithm>
+#include <Moe.Core/Logging.hpp>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+static const char* const UNKNOWN_LABEL_VALUE = "unknown";
+
+namespace
+{
+    void SetLabel(std::vector<std::pair<std::string, std::string>>& labels, const std::string& key,
+        const std::string& value)
+    {
+        for (auto& label : labels)
+        {
+            if (label.first == key)
+            {
+                label.second = value;
+                return;
+            }
+        }
+        labels.emplace_back(key, value);
+    }
+}
+
+struct ProfileMerger::LoadedInput
+{
+    unique_ptr<BinaryProfile> Binary;
+    unique_ptr<Profile> Folded;
+};
+
+ProfileMerger::ProfileMerger(const std::vector<std::string>& groupKeys, unsigned jobs)
+    : m_stGroupKeys(groupKeys), m_uJobs(std::max(jobs, 1u))
+{
+}
+
+void ProfileMerger::Merge(const std::vector<Input>& inputs)
+{
+    auto load = [](const Input& input) {
+        LoadedInput ret;
+        if (IsBinaryProfile(input.Path))
+            ret.Binary.reset(new BinaryProfile(input.Path));
+        else
+        {
+            ret.Folded.reset(new Profile());
+            LoadProfile(input.Path, *ret.Folded);
+        }
+        return ret;
+    };
+
+    // 最多同时读取 m_uJobs 个文件，合并当前文件时后续文件已在读取
+    deque<future<LoadedInput>> pending;
+    size_t next = 0;
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        while (next < inputs.size() && pending.size() < m_uJobs)
+        {
+            pending.push_back(async(launch::async, load, cref(inputs[next])));
+            ++next;
+        }
+
+        auto loaded = pending.front().get();
+        pending.pop_front();
+        MergeInput(inputs[i], loaded);
+        MOE_LOG_DEBUG("Merged \"{0}\", {1} stacks in total", inputs[i].Path, m_stResult.GetStackCount());
+    }
+
+    if (m_stResult.GetStartTime() != 0 && m_uEndTime > m_stResult.GetStartTime())
+        m_stResult.SetDuration(m_uEndTime - m_stResult.GetStartTime());
+    for (const auto& label : m_stCommonLabels)
+        m_stResult.SetLabel(label.first, label.second);
+}
+
+void ProfileMerger::MergeInput(const Input& input, LoadedInput& loaded)
+{
+    // 文件中记录的标签，被清单中指定的同名标签覆盖
+    vector<pair<string, string>> labels;
+    if (loaded.Binary)
+    {
+        const auto& binary = *loaded.Binary;
+        for (size_t i = 0; i < binary.GetLabelCount(); ++i)
+        {
+            auto key = binary.GetLabelKey(i), value = binary.GetLabelValue(i);
+            SetLabel(labels, string(binary.GetString(key), binary.GetStringLength(key)),
+                string(binary.GetString(value), binary.GetStringLength(value)));
+        }
+    }
+    else
+    {
+        const auto& folded = *loaded.Folded;
+        for (const auto& label : folded.GetLabels())
+            SetLabel(labels, folded.GetString(label.Key), folded.GetString(label.Value));
+    }
+    for (const auto& label : input.Labels)
+        SetLabel(labels, label.first, label.second);
+    UpdateCommonLabels(labels);
+
+    // 元数据，折叠文件中没有记录
+    if (loaded.Binary)
+    {
+        const auto& header = loaded.Binary->GetHeader();
+        if (!m_bHasLineMode)
+        {
+            m_stResult.SetLineMode(loaded.Binary->IsLineMode());
+            m_bHasLineMode = true;
+        }
+        else if (m_stResult.IsLineMode() != loaded.Binary->IsLineMode())
+            MOE_LOG_WARN("Profile \"{0}\" has different line mode, frames will not be merged", input.Path);
+
+        if (header.Period != 0)
+        {
+            if (m_stResult.GetPeriod() == 0)
+                m_stResult.SetPeriod(header.Period);
+            else if (m_stResult.GetPeriod() != header.Period)
+                MOE_LOG_WARN("Profile \"{0}\" has different sample period", input.Path);
+        }
+        if (header.StartTime != 0)
+        {
+            if (m_stResult.GetStartTime() == 0 || header.StartTime < m_stResult.GetStartTime())
+                m_stResult.SetStartTime(header.StartTime);
+            m_uEndTime = std::max(m_uEndTime, header.StartTime + header.Duration);
+        }
+    }
+
+    // 分组标签帧
+    auto root = INVALID_PROFILE_ID;
+    for (const auto& key : m_stGroupKeys)
+    {
+        const string* value = nullptr;
+        for (const auto& label : labels)
+        {
+            if (label.first == key)
+            {
+                value = &label.second;
+                break;
+            }
+        }
+
+        ProfileFrame frame;
+        frame.Type = LuaFunctionType::Unknown;
+        frame.Name = m_stResult.InternString(key + "=" + (value ? *value : string(UNKNOWN_LABEL_VALUE)));
+        root = m_stResult.InternStack(root, m_stResult.InternFrame(frame));
+    }
+
+    if (loaded.Binary)
+        loaded.Binary->Merge(m_stResult, root);
+    else
+        m_stResult.Merge(*loaded.Folded, root);
+    ++m_uInputCount;
+}
+
+void ProfileMerger::UpdateCommonLabels(const std::vector<std::pair<std::string, std::string>>& labels)
+{
+    if (m_uInputCount == 0)
+    {
+        m_stCommonLabels = labels;
+        return;
+    }
+
+    auto it = remove_if(m_stCommonLabels.begin(), m_stCommonLabels.end(), [&](const pair<string, string>& common) {
+        return find(labels.begin(), labels.end(), common) == labels.end();
+    });
+    m_stCommonLabels.erase(it, m_stCommonLabels.end());
+}
+
+std::vector<ProfileMerger::Input> lperf::ReadMergeManifest(std::istream& in)
+{
+    vector<ProfileMerger::Input> ret;
+    string line, token;
+    size_t lineNumber = 0;
+    while (getline(in, line))
+    {
+        ++lineNumber;
+        auto start = line.find_first_not_of(" \t\r");
+        if (start == string::npos || line[start] == '#')
+            continue;
+
+        istringstream stream(line);
+        ProfileMerger::Input input;
+        stream >> input.Path;
+        while (stream >> token)
+        {
+            auto eq = token.find('=');
+            if (eq == string::npos || eq == 0)
+                MOE_THROW(BadFormatException, "Invalid label \"{0}\" at line {1}", token, lineNumber);
+            SetLabel(input.Labels, token.substr(0, eq), token.substr(eq + 1));
+        }
+        ret.emplace_back(std::move(input));
+    }
+    return ret;
+}
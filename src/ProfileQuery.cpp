@@ -0,0 +1,390 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "ProfileQuery.hpp"
+#include "Report.hpp"
+
+#include <ostream>
+#include <algorithm>
+#include <unordered_map>
+#include <cinttypes>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+namespace
+{
+    string FormatPercent(uint64_t count, uint64_t total)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%6.2f%%", total == 0 ? 0. : count * 100. / total);
+        return buffer;
+    }
+
+    string GetFrameSource(LuaFunctionType type, const std::string& source)
+    {
+        switch (type)
+        {
+            case LuaFunctionType::Lua:
+                return source;
+            case LuaFunctionType::Native:
+                return "[native]";
+            case LuaFunctionType::VirtualMachine:
+                return "[vm]";
+            case LuaFunctionType::Unknown:
+            default:
+                return "?";
+        }
+    }
+}
+
+ProfileQuery::ProfileQuery(const BinaryProfile& profile)
+    : m_uStackCount(profile.GetStackCount()), m_pParents(profile.GetStackParents()),
+    m_pFrames(profile.GetStackFrames()), m_pCounts(profile.GetSampleCounts())
+{
+    m_stFrameNames.reserve(profile.GetFrameCount());
+    m_stFrameSources.reserve(profile.GetFrameCount());
+    for (ProfileId i = 0; i < profile.GetFrameCount(); ++i)
+    {
+        const auto& frame = profile.GetFrame(i);
+        LuaStackFrame f;
+        f.Type = static_cast<LuaFunctionType>(frame.Type);
+        f.Address = static_cast<uintptr_t>(frame.Address);
+        f.Name.assign(profile.GetString(frame.Name), profile.GetStringLength(frame.Name));
+        f.Source.assign(profile.GetString(frame.Source), profile.GetStringLength(frame.Source));
+        f.Line = frame.LineDefined;
+        f.CurrentLine = frame.Line;
+        m_stFrameNames.push_back(FormatStackFrame(f, profile.IsLineMode()));
+        m_stFrameSources.push_back(GetFrameSource(f.Type, f.Source));
+    }
+
+    Initialize();
+}
+
+ProfileQuery::ProfileQuery(const Profile& profile)
+    : m_uStackCount(profile.GetStackCount())
+{
+    m_stParentStorage.resize(m_uStackCount);
+    m_stFrameStorage.resize(m_uStackCount);
+    m_stCountStorage.resize(m_uStackCount);
+    for (ProfileId i = 0; i < m_uStackCount; ++i)
+    {
+        m_stParentStorage[i] = profile.GetStack(i).Parent;
+        m_stFrameStorage[i] = profile.GetStack(i).Frame;
+        m_stCountStorage[i] = profile.GetSampleCount(i);
+    }
+    m_pParents = m_stParentStorage.data();
+    m_pFrames = m_stFrameStorage.data();
+    m_pCounts = m_stCountStorage.data();
+
+    m_stFrameNames.reserve(profile.GetFrameCount());
+    m_stFrameSources.reserve(profile.GetFrameCount());
+    for (ProfileId i = 0; i < profile.GetFrameCount(); ++i)
+    {
+        const auto& frame = profile.GetFrame(i);
+        m_stFrameNames.push_back(FormatProfileFrame(profile, frame));
+        m_stFrameSources.push_back(GetFrameSource(frame.Type, profile.GetString(frame.Source)));
+    }
+
+    Initialize();
+}
+
+void ProfileQuery::SetFocus(const std::string& pattern)
+{
+    m_stFocus = pattern;
+    ApplyFilter();
+}
+
+void ProfileQuery::SetIgnore(const std::string& pattern)
+{
+    m_stIgnore = pattern;
+    ApplyFilter();
+}
+
+void ProfileQuery::WriteTop(std::ostream& out, unsigned topCount, bool sortByTotal)
+{
+    vector<uint32_t> keys(m_stFrameNames.size());
+
+    // 行模式下同一函数可能对应多个栈帧，按名称归并
+    vector<string> names;
+    unordered_map<string, uint32_t> index;
+    for (size_t i = 0; i < m_stFrameNames.size(); ++i)
+    {
+        auto it = index.find(m_stFrameNames[i]);
+        if (it == index.end())
+        {
+            it = index.emplace(m_stFrameNames[i], static_cast<uint32_t>(names.size())).first;
+            names.push_back(m_stFrameNames[i]);
+        }
+        keys[i] = it->second;
+    }
+
+    vector<uint64_t> self, total;
+    Accumulate(keys, names.size(), self, total);
+    WriteSummary(out, names, self, total, topCount, sortByTotal);
+}
+
+void ProfileQuery::WriteSources(std::ostream& out, unsigned topCount, bool sortByTotal)
+{
+    vector<uint32_t> keys(m_stFrameSources.size());
+    vector<string> names;
+    unordered_map<string, uint32_t> index;
+    for (size_t i = 0; i < m_stFrameSources.size(); ++i)
+    {
+        auto it = index.find(m_stFrameSources[i]);
+        if (it == index.end())
+        {
+            it = index.emplace(m_stFrameSources[i], static_cast<uint32_t>(names.size())).first;
+            names.push_back(m_stFrameSources[i]);
+        }
+        keys[i] = it->second;
+    }
+
+    vector<uint64_t> self, total;
+    Accumulate(keys, names.size(), self, total);
+    WriteSummary(out, names, self, total, topCount, sortByTotal);
+}
+
+void ProfileQuery::WritePeers(std::ostream& out, const std::string& pattern, unsigned topCount)
+{
+    auto match = MatchFrames(pattern);
+    auto frameCount = m_stFrameNames.size();
+    auto rootKey = frameCount;
+
+    // 递归调用时，调用方只统计最外层的匹配帧，被调用方只统计最外层的同名帧
+    vector<uint64_t> callers(frameCount + 1), callees(frameCount);
+    vector<uint32_t> activeFrames(frameCount);
+    uint64_t matchedSelf = 0, matchedTotal = 0;
+    uint32_t activeMatch = 0;
+
+    vector<pair<uint32_t, bool>> pending;
+    for (auto i = m_stChildOffsets[0]; i < m_stChildOffsets[1]; ++i)
+        pending.emplace_back(m_stChildren[i], false);
+    while (!pending.empty())
+    {
+        auto node = pending.back().first;
+        auto exit = pending.back().second;
+        pending.pop_back();
+
+        auto frame = m_pFrames[node];
+        if (exit)
+        {
+            --activeFrames[frame];
+            if (match[frame])
+                --activeMatch;
+            continue;
+        }
+        if (m_stInclusive[node] == 0)
+            continue;
+
+        auto parent = m_pParents[node];
+        if (match[frame])
+        {
+            matchedSelf += m_stWeights[node];
+            if (activeMatch == 0)
+            {
+                callers[parent == INVALID_PROFILE_ID ? rootKey : m_pFrames[parent]] += m_stInclusive[node];
+                matchedTotal += m_stInclusive[node];
+            }
+        }
+        else if (parent != INVALID_PROFILE_ID && match[m_pFrames[parent]] && activeFrames[frame] == 0)
+            callees[frame] += m_stInclusive[node];
+
+        ++activeFrames[frame];
+        if (match[frame])
+            ++activeMatch;
+        pending.emplace_back(node, true);
+        for (auto i = m_stChildOffsets[node + 1]; i < m_stChildOffsets[node + 2]; ++i)
+            pending.emplace_back(m_stChildren[i], false);
+    }
+
+    auto writeList = [&](const vector<uint64_t>& counter) {
+        vector<uint32_t> keys;
+        for (uint32_t i = 0; i < counter.size(); ++i)
+        {
+            if (counter[i] > 0)
+                keys.push_back(i);
+        }
+        sort(keys.begin(), keys.end(), [&](uint32_t lhs, uint32_t rhs) { return counter[lhs] > counter[rhs]; });
+        if (keys.size() > topCount)
+            keys.resize(topCount);
+
+        char buffer[64];
+        for (auto key : keys)
+        {
+            snprintf(buffer, sizeof(buffer), "  %s %10" PRIu64 "  ", FormatPercent(counter[key], matchedTotal).c_str(),
+                counter[key]);
+            out << buffer << (key == rootKey ? "(root)" : m_stFrameNames[key]) << endl;
+        }
+    };
+
+    out << "Functions matching \"" << pattern << "\": total " << matchedTotal << " (" <<
+        FormatPercent(matchedTotal, m_uFilteredTotal) << "), self " << matchedSelf << " (" <<
+        FormatPercent(matchedSelf, m_uFilteredTotal) << ")" << endl << endl;
+    out << "callers (share of total):" << endl;
+    writeList(callers);
+    out << endl << "callees (share of total):" << endl;
+    writeList(callees);
+    out.flush();
+}
+
+void ProfileQuery::Initialize()
+{
+    // 按父节点分组子节点
+    m_stChildOffsets.assign(m_uStackCount + 2, 0);
+    for (size_t i = 0; i < m_uStackCount; ++i)
+    {
+        auto parent = m_pParents[i];
+        ++m_stChildOffsets[(parent == INVALID_PROFILE_ID ? 0 : parent + 1) + 1];
+    }
+    for (size_t i = 1; i < m_stChildOffsets.size(); ++i)
+        m_stChildOffsets[i] += m_stChildOffsets[i - 1];
+    m_stChildren.resize(m_uStackCount);
+    auto cursor = m_stChildOffsets;
+    for (size_t i = 0; i < m_uStackCount; ++i)
+    {
+        auto parent = m_pParents[i];
+        m_stChildren[cursor[parent == INVALID_PROFILE_ID ? 0 : parent + 1]++] = static_cast<uint32_t>(i);
+    }
+
+    m_uTotal = 0;
+    for (size_t i = 0; i < m_uStackCount; ++i)
+        m_uTotal += m_pCounts[i];
+
+    ApplyFilter();
+}
+
+void ProfileQuery::ApplyFilter()
+{
+    auto focus = MatchFrames(m_stFocus);
+    auto ignore = MatchFrames(m_stIgnore);
+
+    // 父节点的下标总是小于子节点，顺序遍历即可得到路径上是否存在匹配帧
+    enum
+    {
+        STATE_FOCUSED = 1,
+        STATE_IGNORED = 2,
+    };
+    vector<uint8_t> states(m_uStackCount);
+    m_stWeights.resize(m_uStackCount);
+    m_uFilteredTotal = 0;
+    for (size_t i = 0; i < m_uStackCount; ++i)
+    {
+        auto parent = m_pParents[i];
+        auto frame = m_pFrames[i];
+        uint8_t state = parent == INVALID_PROFILE_ID ? 0 : states[parent];
+        if (m_stFocus.empty() || focus[frame])
+            state |= STATE_FOCUSED;
+        if (!m_stIgnore.empty() && ignore[frame])
+            state |= STATE_IGNORED;
+        states[i] = state;
+
+        m_stWeights[i] = (state == STATE_FOCUSED) ? m_pCounts[i] : 0;
+        m_uFilteredTotal += m_stWeights[i];
+    }
+
+    m_stInclusive = m_stWeights;
+    for (auto i = m_uStackCount; i > 0; --i)
+    {
+        auto parent = m_pParents[i - 1];
+        if (parent != INVALID_PROFILE_ID)
+            m_stInclusive[parent] += m_stInclusive[i - 1];
+    }
+}
+
+std::vector<bool> ProfileQuery::MatchFrames(const std::string& pattern)const
+{
+    vector<bool> ret(m_stFrameNames.size(), false);
+    if (pattern.empty())
+        return ret;
+
+    try
+    {
+        regex re(pattern);
+        for (size_t i = 0; i < m_stFrameNames.size(); ++i)
+            ret[i] = regex_search(m_stFrameNames[i], re);
+    }
+    catch (const regex_error& ex)
+    {
+        MOE_THROW(BadArgumentException, "Invalid regex \"{0}\": {1}", pattern, ex.what());
+    }
+    return ret;
+}
+
+void ProfileQuery::Accumulate(const std::vector<uint32_t>& keys, size_t keyCount, std::vector<uint64_t>& self,
+    std::vector<uint64_t>& total)const
+{
+    self.assign(keyCount, 0);
+    total.assign(keyCount, 0);
+    for (size_t i = 0; i < m_uStackCount; ++i)
+        self[keys[m_pFrames[i]]] += m_stWeights[i];
+
+    // 深度优先遍历，只在路径上第一次出现某个键时累计其子树的总计数
+    vector<uint32_t> active(keyCount);
+    vector<pair<uint32_t, bool>> pending;
+    for (auto i = m_stChildOffsets[0]; i < m_stChildOffsets[1]; ++i)
+        pending.emplace_back(m_stChildren[i], false);
+    while (!pending.empty())
+    {
+        auto node = pending.back().first;
+        auto exit = pending.back().second;
+        pending.pop_back();
+
+        auto key = keys[m_pFrames[node]];
+        if (exit)
+        {
+            --active[key];
+            continue;
+        }
+        if (m_stInclusive[node] == 0)
+            continue;
+
+        if (active[key] == 0)
+            total[key] += m_stInclusive[node];
+        ++active[key];
+        pending.emplace_back(node, true);
+        for (auto i = m_stChildOffsets[node + 1]; i < m_stChildOffsets[node + 2]; ++i)
+            pending.emplace_back(m_stChildren[i], false);
+    }
+}
+
+void ProfileQuery::WriteSummary(std::ostream& out, const std::vector<std::string>& names,
+    const std::vector<uint64_t>& self, const std::vector<uint64_t>& total, unsigned topCount, bool sortByTotal)const
+{
+    vector<uint32_t> keys;
+    for (uint32_t i = 0; i < names.size(); ++i)
+    {
+        if (total[i] > 0)
+            keys.push_back(i);
+    }
+    const auto& primary = sortByTotal ? total : self;
+    const auto& secondary = sortByTotal ? self : total;
+    sort(keys.begin(), keys.end(), [&](uint32_t lhs, uint32_t rhs) {
+        if (primary[lhs] != primary[rhs])
+            return primary[lhs] > primary[rhs];
+        return secondary[lhs] > secondary[rhs];
+    });
+    if (keys.size() > topCount)
+        keys.resize(topCount);
+
+    out << "Showing " << m_uFilteredTotal << " of " << m_uTotal << " samples";
+    if (!m_stFocus.empty())
+        out << ", focus \"" << m_stFocus << "\"";
+    if (!m_stIgnore.empty())
+        out << ", ignore \"" << m_stIgnore << "\"";
+    out << endl;
+
+    char buffer[96];
+    out << "    self%        self   total%       total  name" << endl;
+    for (auto key : keys)
+    {
+        snprintf(buffer, sizeof(buffer), "  %s %11" PRIu64 "  %s %11" PRIu64 "  ",
+            FormatPercent(self[key], m_uFilteredTotal).c_str(), self[key],
+            FormatPercent(total[key], m_uFilteredTotal).c_str(), total[key]);
+        out << buffer << names[key] << endl;
+    }
+    out.flush();
+}
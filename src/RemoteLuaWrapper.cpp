@@ -5,35 +5,60 @@
  */
 #include "RemoteLuaWrapper.hpp"
 
+#include <algorithm>
+
 #include <Moe.Core/Optional.hpp>
 
 using namespace std;
 using namespace moe;
 using namespace lperf;
 
-static MemoryAccessorPtr g_pAccessor;
-
-MemoryAccessorPtr lperf::GetGlobalMemoryAccessor()noexcept
-{
-    return g_pAccessor;
-}
-
-void lperf::SetGlobalMemoryAccessor(MemoryAccessorPtr ptr)
-{
-    g_pAccessor = ptr;
-}
-
 namespace
 {
     using namespace LuaObjects;
 
-    string getstr(RemotePtr<TString> stringPtr)
+    const size_t MAX_STRING_LENGTH = 1024;
+    const size_t STRING_PREFETCH_SIZE = 64;
+
+    /**
+     * 一次读取头部与内容的开头（不跨页），返回 buffer 中头部之后的字节数
+     */
+    size_t readstrhead(MemoryAccessorBase<>& accessor, uintptr_t address, TString& header,
+        uint8_t (&buffer)[sizeof(UTString) + STRING_PREFETCH_SIZE])
     {
-        auto accessor = GetGlobalMemoryAccessor();
-        assert(accessor);
+        auto pageSize = MemoryAccessorBase<>::GetPageSize();
+        auto pageRest = pageSize - (address & (pageSize - 1));
+        auto size = max(sizeof(UTString), min(pageRest, sizeof(UTString) + STRING_PREFETCH_SIZE));
 
-        auto address = reinterpret_cast<uintptr_t>(stringPtr.pointer) + sizeof(UTString);
-        return accessor->ReadString(address, 1024);
+        accessor.ReadBytes(address, buffer, size);
+        ::memcpy(&header, buffer, sizeof(header));
+        return size - sizeof(UTString);
+    }
+
+    /**
+     * 由 readstrhead 的结果得到完整的内容，必要时读取其余部分
+     */
+    string readstrbody(MemoryAccessorBase<>& accessor, uintptr_t address, const TString& header,
+        const uint8_t* buffer, size_t prefetched)
+    {
+        // 按长度字段读取，不再逐字查找结尾
+        size_t length = 0;
+        if (header.tt == LUA_TSHRSTR)
+            length = header.shrlen;
+        else if (header.tt == LUA_TLNGSTR)
+            length = header.u.lnglen;
+        else
+            return accessor.ReadString(address + sizeof(UTString), MAX_STRING_LENGTH);
+        length = min(length, MAX_STRING_LENGTH);
+
+        prefetched = min(length, prefetched);
+        string ret(reinterpret_cast<const char*>(buffer + sizeof(UTString)), prefetched);
+        if (length > prefetched)
+        {
+            ret.resize(length);
+            accessor.ReadBytes(address + sizeof(UTString) + prefetched, &ret[prefetched], length - prefetched);
+        }
+        return ret;
     }
 
     bool noLuaClosure(Optional<Closure> closure)
@@ -91,7 +116,7 @@ namespace
         }
     }
 
-    void funcinfo(lua_Debug& ar, Optional<Closure> closure)
+    void funcinfo(MemoryAccessorBase<>& accessor, lua_Debug& ar, Optional<Closure> closure, ProtoCache& cache)
     {
         if (noLuaClosure(closure))
         {
@@ -102,101 +127,27 @@ namespace
         }
         else
         {
-            auto protoPtr = closure->l.p;
-            auto proto = *protoPtr;
-            ar.source = proto.source ? getstr(proto.source) : "=?";
-            ar.linedefined = proto.linedefined;
-            ar.lastlinedefined = proto.lastlinedefined;
+            const auto& info = cache.Get(accessor, closure->l.p);
+            ar.proto = reinterpret_cast<uintptr_t>(closure->l.p.pointer);
+            ar.source = info.Source;
+            ar.linedefined = info.Header.linedefined;
+            ar.lastlinedefined = info.Header.lastlinedefined;
             ar.what = (ar.linedefined == 0) ? "main" : "Lua";
         }
         luaO_chunkid(ar.short_src, ar.source.c_str(), LUA_IDSIZE);
     }
 
-    int pcRel(Instruction* pc, Proto& p) { return static_cast<int>(pc - p.code.pointer) - 1; }
+    int pcRel(Instruction* pc, const Proto& p) { return static_cast<int>(pc - p.code.pointer) - 1; }
 
-    int currentline(CallInfo& ci)
+    int currentpc(MemoryAccessorBase<>& accessor, CallInfo& ci, Optional<Closure> closure, ProtoCache& cache)
     {
-        if (!ci.IsLua())
+        if (!ci.IsLua() || noLuaClosure(closure))
             MOE_THROW(BadStateException, "Invalid CallInfo state");
 
-        auto val = *ci.func;
-        auto cl = *(val.value_.gc.CastTo<Closure>());
-        auto protoPtr = cl.l.p;
-        auto proto = *protoPtr;
-        auto pc = pcRel(ci.u.l.savedpc.pointer, proto);
-        if (!proto.lineinfo)
-            return -1;
-        RemotePtr<int> info { proto.lineinfo.pointer + pc };
-        return *info;
+        const auto& info = cache.Get(accessor, closure->l.p);
+        return pcRel(ci.u.l.savedpc.pointer, info.Header);
     }
 
-    enum OpCode
-    {
-        OP_MOVE,/*	A B	R(A) := R(B)					*/
-        OP_LOADK,/*	A Bx	R(A) := Kst(Bx)					*/
-        OP_LOADKX,/*	A 	R(A) := Kst(extra arg)				*/
-        OP_LOADBOOL,/*	A B C	R(A) := (Bool)B; if (C) pc++			*/
-        OP_LOADNIL,/*	A B	R(A), R(A+1), ..., R(A+B) := nil		*/
-        OP_GETUPVAL,/*	A B	R(A) := UpValue[B]				*/
-
-        OP_GETTABUP,/*	A B C	R(A) := UpValue[B][RK(C)]			*/
-        OP_GETTABLE,/*	A B C	R(A) := R(B)[RK(C)]				*/
-
-        OP_SETTABUP,/*	A B C	UpValue[A][RK(B)] := RK(C)			*/
-        OP_SETUPVAL,/*	A B	UpValue[B] := R(A)				*/
-        OP_SETTABLE,/*	A B C	R(A)[RK(B)] := RK(C)				*/
-
-        OP_NEWTABLE,/*	A B C	R(A) := {} (size = B,C)				*/
-
-        OP_SELF,/*	A B C	R(A+1) := R(B); R(A) := R(B)[RK(C)]		*/
-
-        OP_ADD,/*	A B C	R(A) := RK(B) + RK(C)				*/
-        OP_SUB,/*	A B C	R(A) := RK(B) - RK(C)				*/
-        OP_MUL,/*	A B C	R(A) := RK(B) * RK(C)				*/
-        OP_MOD,/*	A B C	R(A) := RK(B) % RK(C)				*/
-        OP_POW,/*	A B C	R(A) := RK(B) ^ RK(C)				*/
-        OP_DIV,/*	A B C	R(A) := RK(B) / RK(C)				*/
-        OP_IDIV,/*	A B C	R(A) := RK(B) // RK(C)				*/
-        OP_BAND,/*	A B C	R(A) := RK(B) & RK(C)				*/
-        OP_BOR,/*	A B C	R(A) := RK(B) | RK(C)				*/
-        OP_BXOR,/*	A B C	R(A) := RK(B) ~ RK(C)				*/
-        OP_SHL,/*	A B C	R(A) := RK(B) << RK(C)				*/
-        OP_SHR,/*	A B C	R(A) := RK(B) >> RK(C)				*/
-        OP_UNM,/*	A B	R(A) := -R(B)					*/
-        OP_BNOT,/*	A B	R(A) := ~R(B)					*/
-        OP_NOT,/*	A B	R(A) := not R(B)				*/
-        OP_LEN,/*	A B	R(A) := length of R(B)				*/
-
-        OP_CONCAT,/*	A B C	R(A) := R(B).. ... ..R(C)			*/
-
-        OP_JMP,/*	A sBx	pc+=sBx; if (A) close all upvalues >= R(A - 1)	*/
-        OP_EQ,/*	A B C	if ((RK(B) == RK(C)) ~= A) then pc++		*/
-        OP_LT,/*	A B C	if ((RK(B) <  RK(C)) ~= A) then pc++		*/
-        OP_LE,/*	A B C	if ((RK(B) <= RK(C)) ~= A) then pc++		*/
-
-        OP_TEST,/*	A C	if not (R(A) <=> C) then pc++			*/
-        OP_TESTSET,/*	A B C	if (R(B) <=> C) then R(A) := R(B) else pc++	*/
-
-        OP_CALL,/*	A B C	R(A), ... ,R(A+C-2) := R(A)(R(A+1), ... ,R(A+B-1)) */
-        OP_TAILCALL,/*	A B C	return R(A)(R(A+1), ... ,R(A+B-1))		*/
-        OP_RETURN,/*	A B	return R(A), ... ,R(A+B-2)	(see note)	*/
-
-        OP_FORLOOP,/*	A sBx	R(A)+=R(A+2);
-                        if R(A) <?= R(A+1) then { pc+=sBx; R(A+3)=R(A) }*/
-        OP_FORPREP,/*	A sBx	R(A)-=R(A+2); pc+=sBx				*/
-
-        OP_TFORCALL,/*	A C	R(A+3), ... ,R(A+2+C) := R(A)(R(A+1), R(A+2));	*/
-        OP_TFORLOOP,/*	A sBx	if R(A+1) ~= nil then { R(A)=R(A+1); pc += sBx }*/
-
-        OP_SETLIST,/*	A B C	R(A)[(C-1)*FPF+i] := R(A+i), 1 <= i <= B	*/
-
-        OP_CLOSURE,/*	A Bx	R(A) := closure(KPROTO[Bx])			*/
-
-        OP_VARARG,/*	A B	R(A), R(A+1), ..., R(A+B-2) = vararg		*/
-
-        OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
-    };
-
     enum OpArgMask {
         OpArgN,  /* argument is not used */
         OpArgU,  /* argument is used */
@@ -291,22 +242,35 @@ namespace
     OpCode GET_OPCODE(int i) { return static_cast<OpCode>((i >> POS_OP) & MASK1(SIZE_OP, 0)); }
     int GETARG_sBx(int i) { return GETARG_Bx(i) - MAXARG_sBx; }
 
+    OpMode getOpMode(OpCode m) { return static_cast<OpMode>(luaP_opmodes[m] & 3); }
+    OpArgMask getBMode(OpCode m) { return static_cast<OpArgMask>((luaP_opmodes[m] >> 4) & 3); }
+    OpArgMask getCMode(OpCode m) { return static_cast<OpArgMask>((luaP_opmodes[m] >> 2) & 3); }
     int testAMode(OpCode m) { return luaP_opmodes[m] & (1 << 6); }
 
     bool ISK(int x) { return (x & BITRK) != 0; }
     int INDEXK(int r) { return r & ~BITRK; }
+    int MYK(int x) { return -1 - x; }
+
+    const char* const luaP_opnames[static_cast<int>(OP_EXTRAARG) + 1] = {
+        "MOVE", "LOADK", "LOADKX", "LOADBOOL", "LOADNIL", "GETUPVAL", "GETTABUP", "GETTABLE", "SETTABUP",
+        "SETUPVAL", "SETTABLE", "NEWTABLE", "SELF", "ADD", "SUB", "MUL", "MOD", "POW", "DIV", "IDIV", "BAND",
+        "BOR", "BXOR", "SHL", "SHR", "UNM", "BNOT", "NOT", "LEN", "CONCAT", "JMP", "EQ", "LT", "LE", "TEST",
+        "TESTSET", "CALL", "TAILCALL", "RETURN", "FORLOOP", "FORPREP", "TFORCALL", "TFORLOOP", "SETLIST",
+        "CLOSURE", "VARARG", "EXTRAARG",
+    };
 
-    string luaF_getlocalname(Proto& f, int local_number, int pc)
+    string luaF_getlocalname(MemoryAccessorBase<>& accessor, StringCache& strings, const Proto& f, int local_number,
+        int pc)
     {
         LocVar loc;
-        for (int i = 0; i < f.sizelocvars && (loc = *(RemotePtr<LocVar> { f.locvars.pointer + i }), loc.startpc) <= pc;
-            ++i)
+        for (int i = 0; i < f.sizelocvars &&
+            (loc = RemotePtr<LocVar> { f.locvars.pointer + i }.Read(accessor), loc.startpc) <= pc; ++i)
         {
             if (pc < loc.endpc)  /* is variable active? */
             {
                 --local_number;
                 if (local_number == 0)
-                    return getstr(loc.varname);
+                    return strings.Get(accessor, loc.varname);
             }
         }
         return string();  /* not found */
@@ -320,13 +284,20 @@ namespace
             return pc;  /* current position sets that register */
     }
 
-    int findsetreg(Proto& p, int lastpc, int reg)
+    Instruction getinstruction(const ProtoInfo& info, int pc)
+    {
+        if (pc < 0 || static_cast<size_t>(pc) >= info.Code.size())
+            MOE_THROW(BadStateException, "Invalid data");
+        return info.Code[pc];
+    }
+
+    int findsetreg(const ProtoInfo& info, int lastpc, int reg)
     {
         int setreg = -1;  /* keep last instruction that changed 'reg' */
         int jmptarget = 0;  /* any code before this address is conditional */
         for (int pc = 0; pc < lastpc; ++pc)
         {
-            Instruction i = *(RemotePtr<Instruction> { p.code.pointer + pc });
+            Instruction i = getinstruction(info, pc);
             OpCode op = GET_OPCODE(i);
             int a = GETARG_A(i);
             switch (op)
@@ -368,37 +339,39 @@ namespace
         return setreg;
     }
 
-    string upvalname(Proto& p, int uv)
+    string upvalname(MemoryAccessorBase<>& accessor, StringCache& strings, const Proto& p, int uv)
     {
         if (uv >= p.sizeupvalues)
             MOE_THROW(BadStateException, "Invalid data");
 
         RemotePtr<Upvaldesc> descPtr { p.upvalues.pointer + uv };
-        auto desc = *descPtr;
-        auto s = desc.name;
+        auto s = descPtr.ReadField(accessor, &Upvaldesc::name);
         if (!s)
             return "?";
         else
-            return getstr(s);
+            return strings.Get(accessor, s);
     }
 
-    const char* getobjname(Proto& p, int lastpc, int reg, string& name);
+    const char* getobjname(MemoryAccessorBase<>& accessor, StringCache& strings, const ProtoInfo& info, int lastpc,
+        int reg, string& name);
 
-    void kname(Proto& p, int pc, int c, string& name)
+    void kname(MemoryAccessorBase<>& accessor, StringCache& strings, const ProtoInfo& info, int pc, int c,
+        string& name)
     {
+        const auto& p = info.Header;
         if (ISK(c))  /* is 'c' a constant? */
         {
-            TValue kvalue = *(RemotePtr<TValue> { p.k.pointer + INDEXK(c) });
+            TValue kvalue = RemotePtr<TValue> { p.k.pointer + INDEXK(c) }.Read(accessor);
             if (kvalue.IsString())  /* literal constant? */
             {
-                name = getstr(kvalue.value_.gc.CastTo<TString>());  /* it is its own name */
+                name = strings.Get(accessor, kvalue.value_.gc.CastTo<TString>());  /* it is its own name */
                 return;
             }
             /* else no reasonable name found */
         }
         else  /* 'c' is a register */
         {
-            const char *what = getobjname(p, pc, c, name); /* search for 'c' */
+            const char *what = getobjname(accessor, strings, info, pc, c, name); /* search for 'c' */
             if (what && *what == 'c')  /* found a constant name? */
                 return;  /* 'name' already filled */
             /* else no reasonable name found */
@@ -406,18 +379,20 @@ namespace
         name = "?";  /* no reasonable name found */
     }
 
-    const char* getobjname(Proto& p, int lastpc, int reg, string& name)
+    const char* getobjname(MemoryAccessorBase<>& accessor, StringCache& strings, const ProtoInfo& info, int lastpc,
+        int reg, string& name)
     {
+        const auto& p = info.Header;
         static const char* LUA_ENV = "_ENV";
 
-        name = luaF_getlocalname(p, reg + 1, lastpc);
+        name = luaF_getlocalname(accessor, strings, p, reg + 1, lastpc);
         if (!name.empty())  /* is a local? */
             return "local";
         /* else try symbolic execution */
-        int pc = findsetreg(p, lastpc, reg);
+        int pc = findsetreg(info, lastpc, reg);
         if (pc != -1)  /* could find instruction? */
         {
-            Instruction i = *(RemotePtr<Instruction> { p.code.pointer + pc });
+            Instruction i = getinstruction(info, pc);
             OpCode op = GET_OPCODE(i);
             switch (op)
             {
@@ -425,7 +400,7 @@ namespace
                     {
                         int b = GETARG_B(i);  /* move from 'b' to 'a' */
                         if (b < GETARG_A(i))
-                            return getobjname(p, pc, b, name);  /* get name for 'b' */
+                            return getobjname(accessor, strings, info, pc, b, name);  /* get name for 'b' */
                     }
                     break;
                 case OP_GETTABUP:
@@ -433,13 +408,14 @@ namespace
                     {
                         int k = GETARG_C(i);  /* key index */
                         int t = GETARG_B(i);  /* table index */
-                        string vn = (op == OP_GETTABLE) ? luaF_getlocalname(p, t + 1, pc) : upvalname(p, t);
-                        kname(p, pc, k, name);
+                        string vn = (op == OP_GETTABLE) ? luaF_getlocalname(accessor, strings, p, t + 1, pc) :
+                            upvalname(accessor, strings, p, t);
+                        kname(accessor, strings, info, pc, k, name);
                         return (!vn.empty() && strcmp(vn.c_str(), LUA_ENV) == 0) ? "global" : "field";
                     }
                 case OP_GETUPVAL:
                     {
-                        name = upvalname(p, GETARG_B(i));
+                        name = upvalname(accessor, strings, p, GETARG_B(i));
                         return "upvalue";
                     }
                 case OP_LOADK:
@@ -450,14 +426,14 @@ namespace
                             b = GETARG_Bx(i);
                         else
                         {
-                            auto i = *(RemotePtr<Instruction> { p.code.pointer + (pc + 1) });
+                            auto i = getinstruction(info, pc + 1);
                             b = GETARG_Ax(i);
                         }
 
-                        TValue kvalue = *(RemotePtr<TValue> { p.k.pointer + b });
+                        TValue kvalue = RemotePtr<TValue> { p.k.pointer + b }.Read(accessor);
                         if (kvalue.IsString())
                         {
-                            name = getstr(kvalue.value_.gc.CastTo<TString>());
+                            name = strings.Get(accessor, kvalue.value_.gc.CastTo<TString>());
                             return "constant";
                         }
                     }
@@ -465,7 +441,7 @@ namespace
                 case OP_SELF:
                     {
                         int k = GETARG_C(i);  /* key index */
-                        kname(p, pc, k, name);
+                        kname(accessor, strings, info, pc, k, name);
                         return "method";
                     }
                 default:
@@ -475,19 +451,16 @@ namespace
         return nullptr;  /* could not find reasonable name */
     }
 
-    const char* funcnamefromcode(lua_State& L, CallInfo& ci, string& name)
+    const char* funcnamefromcode(MemoryAccessorBase<>& accessor, lua_State& L, const RawCallFrame& caller,
+        ProtoCache& cache, string& name)
     {
         TMS tm = static_cast<TMS>(0);  /* (initial value avoids warnings) */
-        auto val = *ci.func;
-        if (!val.IsFunction())
+        if (!caller.Func.IsLClosure())
             MOE_THROW(BadStateException, "Invalid data");
-        auto cl = *(val.value_.gc.CastTo<LuaObjects::Closure>());
-        auto protoPtr = cl.l.p;
-        auto p = *protoPtr;
-        int pc = pcRel(ci.u.l.savedpc.pointer, p);  /* calling instruction index */
-        RemotePtr<Instruction> ip { p.code.pointer + pc };
-        Instruction i = *ip;  /* calling instruction */
-        if (ci.IsHooked())  /* was it called inside a hook? */
+        const auto& info = cache.Get(accessor, caller.FuncClosure.l.p);
+        int pc = pcRel(caller.Info.u.l.savedpc.pointer, info.Header);  /* calling instruction index */
+        Instruction i = getinstruction(info, pc);  /* calling instruction */
+        if (caller.Info.IsHooked())  /* was it called inside a hook? */
         {
             name = "?";
             return "hook";
@@ -496,7 +469,7 @@ namespace
         {
             case OP_CALL:
             case OP_TAILCALL:  /* get function name */
-                return getobjname(p, pc, GETARG_A(i), name);
+                return getobjname(accessor, cache.GetStringCache(), info, pc, GETARG_A(i), name);
             case OP_TFORCALL:  /* for iterator */
                 name = "for iterator";
                 return "for iterator";
@@ -522,11 +495,12 @@ namespace
             default:
                 return nullptr;
         }
-        name = getstr((*L.l_G).tmname[tm]);
+        name = cache.GetStringCache().Get(accessor, L.l_G.ReadField(accessor, &global_State::tmname, tm));
         return "metamethod";
     }
 
-    const char* getfuncname(lua_State& L, Optional<CallInfo> ci, string& name)
+    const char* getfuncname(MemoryAccessorBase<>& accessor, lua_State& L, Optional<CallInfo> ci,
+        const RawCallFrame* previous, ProtoCache& cache, string& name)
     {
         if (!ci)
             return nullptr;
@@ -535,29 +509,45 @@ namespace
             name = "__gc";
             return "metamethod";  /* report it as such */
         }
-        else
+        else if (!ci->IsTailCall())
         {
-            auto previousPtr = ci->previous;
-            auto previous = *previousPtr;
-            if (!ci->IsTailCall() && previous.IsLua())  /* calling function is a known Lua function? */
-                return funcnamefromcode(L, previous, name);
+            RawCallFrame caller;
+            if (!previous)
+            {
+                if (!ci->previous)
+                    return nullptr;
+                lua_State::CaptureFrame(accessor, ci->previous, caller);
+                previous = &caller;
+            }
+            if (previous->Info.IsLua())  /* calling function is a known Lua function? */
+                return funcnamefromcode(accessor, L, *previous, cache, name);
         }
         return nullptr;
     }
 
-    void auxgetinfo(lua_State& L, const char* what, lua_Debug& ar, Optional<Closure> f, Optional<CallInfo> ci)
+    void auxgetinfo(MemoryAccessorBase<>& accessor, lua_State& L, const char* what, lua_Debug& ar, Optional<Closure> f,
+        Optional<CallInfo> ci, const RawCallFrame* previous, ProtoCache& cache)
     {
         for (; *what; ++what)
         {
             switch (*what)
             {
                 case 'S':
-                    funcinfo(ar, f);
+                    funcinfo(accessor, ar, f, cache);
                     if (f && f->c.tt == LUA_TCCL)
                         ar.address = reinterpret_cast<uintptr_t>(f->c.f);
                     break;
                 case 'l':
-                    ar.currentline = (ci && ci->IsLua()) ? currentline(*ci) : -1;
+                    if (ci && ci->IsLua())
+                    {
+                        ar.currentpc = currentpc(accessor, *ci, f, cache);
+                        ar.currentline = cache.Get(accessor, f->l.p).GetLine(ar.currentpc);
+                    }
+                    else
+                    {
+                        ar.currentpc = -1;
+                        ar.currentline = -1;
+                    }
                     break;
                 case 'u':
                     ar.nups = static_cast<uint8_t>((!f) ? 0 : f->c.nupvalues);
@@ -568,8 +558,7 @@ namespace
                     }
                     else
                     {
-                        auto protoPtr = f->l.p;
-                        auto proto = *protoPtr;
+                        const auto& proto = cache.Get(accessor, f->l.p).Header;
                         ar.isvararg = static_cast<bool>(proto.is_vararg);
                         ar.nparams = proto.numparams;
                     }
@@ -578,7 +567,7 @@ namespace
                     ar.istailcall = ci ? ci->IsTailCall() : false;
                     break;
                 case 'n':
-                    ar.namewhat = getfuncname(L, ci, ar.name);
+                    ar.namewhat = getfuncname(accessor, L, ci, previous, cache, ar.name);
                     if (!ar.namewhat)
                     {
                         ar.namewhat = "";  /* not found */
@@ -593,7 +582,112 @@ namespace
     }
 }
 
-LuaObjects::lua_Debug LuaObjects::lua_State::GetStack(uintptr_t address, int level)
+LuaObjects::OpCode LuaObjects::GetOpCode(Instruction i)noexcept
+{
+    return GET_OPCODE(static_cast<int>(i));
+}
+
+const char* LuaObjects::GetOpCodeName(OpCode op)noexcept
+{
+    if (static_cast<unsigned>(op) >= NUM_OPCODES)
+        return "?";
+    return luaP_opnames[op];
+}
+
+std::string LuaObjects::FormatInstruction(Instruction i, int pc)
+{
+    auto op = GET_OPCODE(static_cast<int>(i));
+    if (static_cast<unsigned>(op) >= NUM_OPCODES)
+        return StringUtils::Format("? {0}", i);
+
+    auto a = GETARG_A(static_cast<int>(i));
+    auto b = GETARG_B(static_cast<int>(i));
+    auto c = GETARG_C(static_cast<int>(i));
+    auto ax = GETARG_Ax(static_cast<int>(i));
+    auto bx = GETARG_Bx(static_cast<int>(i));
+    auto sbx = GETARG_sBx(static_cast<int>(i));
+
+    char buffer[64];
+    int len = snprintf(buffer, sizeof(buffer), "%-9s\t", luaP_opnames[op]);
+    auto rest = [&]() { return sizeof(buffer) - static_cast<size_t>(len); };
+    switch (getOpMode(op))
+    {
+        case iABC:
+            len += snprintf(buffer + len, rest(), "%d", a);
+            if (getBMode(op) != OpArgN)
+                len += snprintf(buffer + len, rest(), " %d", ISK(b) ? MYK(INDEXK(b)) : b);
+            if (getCMode(op) != OpArgN)
+                len += snprintf(buffer + len, rest(), " %d", ISK(c) ? MYK(INDEXK(c)) : c);
+            break;
+        case iABx:
+            len += snprintf(buffer + len, rest(), "%d", a);
+            if (getBMode(op) == OpArgK)
+                len += snprintf(buffer + len, rest(), " %d", MYK(bx));
+            if (getBMode(op) == OpArgU)
+                len += snprintf(buffer + len, rest(), " %d", bx);
+            break;
+        case iAsBx:
+            len += snprintf(buffer + len, rest(), "%d %d\t; to %d", a, sbx, pc + sbx + 2);
+            break;
+        case iAx:
+            len += snprintf(buffer + len, rest(), "%d", MYK(ax));
+            break;
+    }
+    return buffer;
+}
+
+std::vector<LoopInfo> LuaObjects::FindLoops(const std::vector<Instruction>& code, const std::vector<int>& lineInfo)
+{
+    vector<LoopInfo> ret;
+    for (size_t pc = 0; pc < code.size(); ++pc)
+    {
+        auto i = static_cast<int>(code[pc]);
+        auto op = GET_OPCODE(i);
+        if (op != OP_FORLOOP && op != OP_TFORLOOP && op != OP_JMP)
+            continue;
+
+        auto dest = static_cast<int>(pc) + 1 + GETARG_sBx(i);
+        if (dest > static_cast<int>(pc) || dest < 0)  /* only backward jumps close a loop */
+            continue;
+
+        LoopInfo loop;
+        loop.Type = (op == OP_FORLOOP) ? LuaLoopType::NumericFor :
+            (op == OP_TFORLOOP) ? LuaLoopType::GenericFor : LuaLoopType::Jump;
+        loop.StartPc = dest;
+        loop.EndPc = static_cast<int>(pc);
+        ret.push_back(loop);
+    }
+
+    sort(ret.begin(), ret.end(), [](const LoopInfo& lhs, const LoopInfo& rhs) {
+        if (lhs.StartPc != rhs.StartPc)
+            return lhs.StartPc < rhs.StartPc;
+        return lhs.EndPc > rhs.EndPc;
+    });
+
+    // 多个跳转回到同一位置时（如 goto continue）合并为一个循环
+    vector<LoopInfo> merged;
+    for (const auto& loop : ret)
+    {
+        if (!merged.empty() && merged.back().StartPc == loop.StartPc)
+            continue;
+        merged.push_back(loop);
+    }
+
+    for (auto& loop : merged)
+    {
+        for (int pc = loop.StartPc; pc <= loop.EndPc && static_cast<size_t>(pc) < lineInfo.size(); ++pc)
+        {
+            auto line = lineInfo[pc];
+            if (loop.StartLine < 0 || line < loop.StartLine)
+                loop.StartLine = line;
+            if (line > loop.EndLine)
+                loop.EndLine = line;
+        }
+    }
+    return merged;
+}
+
+LuaObjects::lua_Debug LuaObjects::lua_State::GetStack(MemoryAccessorBase<>& accessor, uintptr_t address, int level)
 {
     if (level < 0)
         MOE_THROW(BadArgumentException, "Invalid negative level");
@@ -603,7 +697,8 @@ LuaObjects::lua_Debug LuaObjects::lua_State::GetStack(uintptr_t address, int lev
 
     RemotePtr<CallInfo> baseCallInfoPtr { reinterpret_cast<CallInfo*>(address + offsetof(lua_State, base_ci)) };
     RemotePtr<CallInfo> callInfoPtr { nullptr };
-    for (callInfoPtr = ci; level > 0 && callInfoPtr != baseCallInfoPtr; callInfoPtr = (*callInfoPtr).previous)
+    for (callInfoPtr = ci; level > 0 && callInfoPtr != baseCallInfoPtr;
+        callInfoPtr = callInfoPtr.ReadField(accessor, &CallInfo::previous))
         level--;
     if (level == 0 && callInfoPtr != baseCallInfoPtr)
     {
@@ -613,35 +708,159 @@ LuaObjects::lua_Debug LuaObjects::lua_State::GetStack(uintptr_t address, int lev
     MOE_THROW(ObjectNotFoundException, "Stack level {0} not found", level);
 }
 
-void LuaObjects::lua_State::GetInfo(const char* what, lua_Debug& ar)
+void LuaObjects::lua_State::GetInfo(MemoryAccessorBase<>& accessor, const char* what, lua_Debug& ar,
+    ProtoCache& cache)
 {
-    Optional<CallInfo> callInfo;
-    StkId funcPtr { nullptr };
-    lua_TValue func {};
-    if (*what == '>')
+    if (*what != '>')
     {
-        funcPtr.pointer = top.pointer - 1;
-        func = *funcPtr;
-
-        if (!func.IsFunction())
-            MOE_THROW(BadStateException, "Function expected");
-        ++what;
+        RawCallFrame frame;
+        CaptureFrame(accessor, ar.i_ci, frame);
+        GetInfo(accessor, what, frame, nullptr, ar, cache);
+        return;
     }
-    else
-    {
-        auto callInfoPtr = ar.i_ci;
-        callInfo = *callInfoPtr;
-        funcPtr = callInfo->func;
-        func = *funcPtr;
 
-        if (!func.IsFunction())
-            MOE_THROW(BadStateException, "Bad remote data");
-    }
+    StkId funcPtr { top.pointer - 1 };
+    auto func = funcPtr.Read(accessor);
+    if (!func.IsFunction())
+        MOE_THROW(BadStateException, "Function expected");
+    ++what;
 
     Optional<Closure> closure;
     if (func.IsClosure())
-        closure = *(func.value_.gc.CastTo<LuaObjects::Closure>());
+        closure = func.value_.gc.CastTo<LuaObjects::Closure>().Read(accessor);
     else if (func.IsLightCFunction())
         ar.address = reinterpret_cast<uintptr_t>(func.value_.f);
-    auxgetinfo(*this, what, ar, closure, callInfo);
+    auxgetinfo(accessor, *this, what, ar, closure, Optional<CallInfo>(), nullptr, cache);
+}
+
+void LuaObjects::lua_State::GetInfo(MemoryAccessorBase<>& accessor, const char* what, const RawCallFrame& frame,
+    const RawCallFrame* previous, lua_Debug& ar, ProtoCache& cache)
+{
+    assert(*what != '>');
+    if (!frame.Func.IsFunction())
+        MOE_THROW(BadStateException, "Bad remote data");
+
+    Optional<Closure> closure;
+    if (frame.Func.IsClosure())
+        closure = frame.FuncClosure;
+    else if (frame.Func.IsLightCFunction())
+        ar.address = reinterpret_cast<uintptr_t>(frame.Func.value_.f);
+    ar.i_ci = frame.Address;
+    auxgetinfo(accessor, *this, what, ar, closure, frame.Info, previous, cache);
+}
+
+void LuaObjects::lua_State::CaptureFrame(MemoryAccessorBase<>& accessor, RemotePtr<CallInfo> ci, RawCallFrame& out)
+{
+    out.Address = ci;
+    ci.Read(accessor, out.Info);
+    out.Info.func.Read(accessor, out.Func);
+    if (out.Func.IsClosure())
+        out.Func.value_.gc.CastTo<Closure>().Read(accessor, out.FuncClosure);
+    else
+        ::memset(&out.FuncClosure, 0, sizeof(out.FuncClosure));
+}
+
+//////////////////////////////////////////////////////////////////////////////// ProtoCache
+
+const ProtoInfo& ProtoCache::Get(MemoryAccessorBase<>& accessor, RemotePtr<LuaObjects::Proto> proto)
+{
+    auto address = reinterpret_cast<uintptr_t>(proto.pointer);
+    {
+        lock_guard<mutex> guard(m_stLock);
+        auto it = m_stCache.find(address);
+        if (it != m_stCache.end())
+            return it->second;
+    }
+
+    // 读取期间不持有锁，避免阻塞查询
+    ProtoInfo info;
+    info.Header = proto.Read(accessor);
+    info.Source = info.Header.source ? m_stStrings.Get(accessor, info.Header.source) : "=?";
+
+    // 行号表与指令互不依赖，一次读取
+    ReadPlanner planner(accessor);
+    if (info.Header.lineinfo && info.Header.sizelineinfo > 0)
+    {
+        planner.AddArray(info.LineInfo, reinterpret_cast<uintptr_t>(info.Header.lineinfo.pointer),
+            static_cast<size_t>(info.Header.sizelineinfo));
+    }
+    if (info.Header.code && info.Header.sizecode > 0)
+    {
+        planner.AddArray(info.Code, reinterpret_cast<uintptr_t>(info.Header.code.pointer),
+            static_cast<size_t>(info.Header.sizecode));
+    }
+    planner.Flush();
+    info.Loops = FindLoops(info.Code, info.LineInfo);
+
+    lock_guard<mutex> guard(m_stLock);
+    auto ret = m_stCache.emplace(address, std::move(info));
+    return ret.first->second;
+}
+
+const ProtoInfo* ProtoCache::Find(uintptr_t address)const noexcept
+{
+    lock_guard<mutex> guard(m_stLock);
+    auto it = m_stCache.find(address);
+    if (it != m_stCache.end())
+        return &it->second;
+    return nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////////// StringCache
+
+std::string StringCache::Get(MemoryAccessorBase<>& accessor, RemotePtr<LuaObjects::TString> str)
+{
+    auto address = reinterpret_cast<uintptr_t>(str.pointer);
+
+    // 命中时只读取头部：短字符串被驻留且不可变，地址被回收复用时类型、哈希与长度几乎不可能同时一致
+    bool found = false;
+    {
+        lock_guard<mutex> guard(m_stLock);
+        found = (m_stIndex.find(address) != m_stIndex.end());
+    }
+    if (found)
+    {
+        auto header = str.Read(accessor);
+
+        lock_guard<mutex> guard(m_stLock);
+        auto it = m_stIndex.find(address);
+        if (it != m_stIndex.end())
+        {
+            auto& cached = *it->second;
+            if (header.tt == LUA_TSHRSTR && cached.Hash == header.hash && cached.Length == header.shrlen)
+            {
+                m_stEntries.splice(m_stEntries.begin(), m_stEntries, it->second);
+                return cached.Value;
+            }
+
+            m_uUsage -= GetEntrySize(cached);
+            m_stEntries.erase(it->second);
+            m_stIndex.erase(it);
+        }
+    }
+
+    // 未命中时一次取回头部与内容的开头，短字符串由此读完；长字符串不缓存
+    TString header;
+    uint8_t buffer[sizeof(UTString) + STRING_PREFETCH_SIZE];
+    auto prefetched = readstrhead(accessor, address, header, buffer);
+    auto ret = readstrbody(accessor, address, header, buffer, prefetched);
+    if (header.tt != LUA_TSHRSTR)
+        return ret;
+
+    Entry entry;
+    entry.Address = address;
+    entry.Length = header.shrlen;
+    entry.Hash = header.hash;
+    entry.Value = ret;
+    auto size = GetEntrySize(entry);
+
+    lock_guard<mutex> guard(m_stLock);
+    if (size > m_uCapacity || m_stIndex.find(address) != m_stIndex.end())
+        return ret;
+
+    m_stEntries.emplace_front(std::move(entry));
+    m_stIndex.emplace(address, m_stEntries.begin());
+    m_uUsage += size;
+    Shrink();
+    return ret;
 }
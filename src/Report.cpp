@@ -0,0 +1,759 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "Report.hpp"
+#include "PProfWriter.hpp"
+#include "CallgrindWriter.hpp"
+#include "BinaryProfile.hpp"
+
+#include <cctype>
+#include <ostream>
+#include <algorithm>
+#include <cinttypes>
+#include <unistd.h>
+#include <Moe.Core/Logging.hpp>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+namespace
+{
+    string FormatPercent(size_t count, size_t total)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%6.2f%%", total == 0 ? 0. : count * 100. / total);
+        return buffer;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////// FoldedReport
+
+FoldedReport::FoldedReport(bool lineMode, const ProtoCache* opCodeCache)
+    : m_pOpCodeCache(opCodeCache), m_stProfile(lineMode)
+{
+    m_stFormatBuffer.reserve(1024);
+}
+
+void FoldedReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo&)
+{
+    auto id = m_stProfile.InternStack(stack);
+
+    LuaObjects::Instruction i = 0;
+    if (m_pOpCodeCache && !stack.empty() && GetCurrentInstruction(stack.front(), *m_pOpCodeCache, i))
+    {
+        ProfileFrame leaf;
+        leaf.Type = LuaFunctionType::VirtualMachine;
+        leaf.Name = m_stProfile.InternString(string("OP_") + LuaObjects::GetOpCodeName(LuaObjects::GetOpCode(i)));
+        id = m_stProfile.InternStack(id, m_stProfile.InternFrame(leaf));
+    }
+    m_stProfile.AddSample(id);
+}
+
+void FoldedReport::Write(std::ostream& out)
+{
+    WriteFoldedProfile(m_stProfile, out);
+}
+
+void FoldedReport::WriteDelta(std::ostream& out)
+{
+    for (auto id : m_stProfile.GetDirtyStacks())
+        out << FormatStack(id) << " " << m_stProfile.GetDeltaCount(id) << "\n";
+    out.flush();
+    m_stProfile.ResetDelta();
+}
+
+const std::string& FoldedReport::FormatStack(ProfileId stack)
+{
+    m_stProfile.GetStackFrames(stack, m_stFrameBuffer);
+
+    m_stFormatBuffer.clear();
+    m_stFormatBuffer.append("(base);");
+    for (auto frame : m_stFrameBuffer)
+    {
+        if (m_stProfile.IsIdleFrame(frame))  // 空栈与之前一样输出为 "(base);"
+            continue;
+        while (m_stFrameTexts.size() <= frame)
+            m_stFrameTexts.push_back(FormatProfileFrame(m_stProfile, m_stProfile.GetFrame(m_stFrameTexts.size())));
+        m_stFormatBuffer.append(m_stFrameTexts[frame]);
+        m_stFormatBuffer.push_back(';');
+    }
+    return m_stFormatBuffer;
+}
+
+//////////////////////////////////////////////////////////////////////////////// LineReport
+
+void LineReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo&)
+{
+    ++m_uSampleCount;
+
+    // 栈顶不是LUA帧时，时间花在本地函数中，不能算作调用它的LUA行的自身时间
+    bool top = !stack.empty() && stack.front().Type == LuaFunctionType::Lua;
+    if (!stack.empty() && !top)
+        ++m_uNativeSelf;
+
+    for (const auto& frame : stack)
+    {
+        if (frame.Type != LuaFunctionType::Lua)
+            continue;
+
+        auto& counter = m_stLineCounter[LineKey { frame.Source, frame.Line, frame.CurrentLine }];
+        if (counter.Name.empty())
+            counter.Name = frame.Name;
+        if (top)
+        {
+            ++counter.Self;
+            top = false;
+        }
+        if (counter.LastSample != m_uSampleCount)  // 递归调用时只计一次
+        {
+            ++counter.Total;
+            counter.LastSample = m_uSampleCount;
+        }
+    }
+}
+
+void LineReport::Write(std::ostream& out)
+{
+    struct FileSummary
+    {
+        const string* Source = nullptr;
+        size_t Self = 0;
+        vector<pair<const LineKey*, const LineCounter*>> Lines;
+    };
+
+    // 按源文件分组
+    vector<FileSummary> files;
+    for (const auto& it : m_stLineCounter)
+    {
+        if (files.empty() || *files.back().Source != it.first.Source)
+        {
+            files.emplace_back();
+            files.back().Source = &it.first.Source;
+        }
+        files.back().Self += it.second.Self;
+        files.back().Lines.emplace_back(&it.first, &it.second);
+    }
+
+    sort(files.begin(), files.end(), [](const FileSummary& lhs, const FileSummary& rhs) {
+        return lhs.Self > rhs.Self;
+    });
+
+    char buffer[64];
+    for (auto& file : files)
+    {
+        sort(file.Lines.begin(), file.Lines.end(), [](const pair<const LineKey*, const LineCounter*>& lhs,
+            const pair<const LineKey*, const LineCounter*>& rhs) {
+            if (lhs.second->Self != rhs.second->Self)
+                return lhs.second->Self > rhs.second->Self;
+            return lhs.second->Total > rhs.second->Total;
+        });
+
+        out << *file.Source << " (self " << FormatPercent(file.Self, m_uSampleCount) << ")" << endl;
+        out << "      line    self%     self   total%    total  function" << endl;
+        for (const auto& line : file.Lines)
+        {
+            snprintf(buffer, sizeof(buffer), "%10u %s %8zu %s %8zu  ", line.first->CurrentLine,
+                FormatPercent(line.second->Self, m_uSampleCount).c_str(), line.second->Self,
+                FormatPercent(line.second->Total, m_uSampleCount).c_str(), line.second->Total);
+            out << buffer << (line.second->Name.empty() ? "?" : line.second->Name) << ":" << line.first->LineDefined
+                << endl;
+        }
+        out << endl;
+    }
+
+    if (m_uNativeSelf > 0)
+        out << "[native] (self " << FormatPercent(m_uNativeSelf, m_uSampleCount) << ")" << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////// BytecodeReport
+
+BytecodeReport::BytecodeReport(const ProtoCache& cache, unsigned topCount)
+    : m_pProtoCache(cache), m_uTopCount(topCount)
+{
+}
+
+void BytecodeReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo&)
+{
+    ++m_uSampleCount;
+    if (stack.empty() || stack.front().Type != LuaFunctionType::Lua || stack.front().Pc < 0)
+        return;
+
+    // pc 来自远端内存，被撕裂的 savedpc 可能是任意值：只接受落在指令范围内的
+    const auto& top = stack.front();
+    auto proto = m_pProtoCache.Find(top.ProtoAddress);
+    if (!proto || static_cast<size_t>(top.Pc) >= proto->Code.size())
+    {
+        ++m_uInvalidPcCount;
+        return;
+    }
+
+    auto& counter = m_stProtoCounter[top.ProtoAddress];
+    if (counter.Name.empty())
+    {
+        counter.Name = FormatStackFrame(top);
+        counter.PcCounter.resize(proto->Code.size());
+    }
+    ++counter.PcCounter[top.Pc];
+    ++counter.Total;
+}
+
+void BytecodeReport::Write(std::ostream& out)
+{
+    vector<pair<uintptr_t, const ProtoCounter*>> protos;
+    protos.reserve(m_stProtoCounter.size());
+    for (const auto& it : m_stProtoCounter)
+        protos.emplace_back(it.first, &it.second);
+    sort(protos.begin(), protos.end(), [](const pair<uintptr_t, const ProtoCounter*>& lhs,
+        const pair<uintptr_t, const ProtoCounter*>& rhs) {
+        return lhs.second->Total > rhs.second->Total;
+    });
+    if (protos.size() > m_uTopCount)
+        protos.resize(m_uTopCount);
+
+    char buffer[64];
+    for (const auto& it : protos)
+    {
+        const auto& counter = *it.second;
+        out << counter.Name << " (" << FormatPercent(counter.Total, m_uSampleCount) << ", " << counter.Total
+            << " samples)" << endl;
+
+        auto info = m_pProtoCache.Find(it.first);
+        if (!info)
+        {
+            out << "  <bytecode unavailable>" << endl << endl;
+            continue;
+        }
+
+        out << "        pc     line    total%     func%  instruction" << endl;
+        for (size_t pc = 0; pc < info->Code.size(); ++pc)
+        {
+            auto count = pc < counter.PcCounter.size() ? counter.PcCounter[pc] : 0;
+            auto line = info->GetLine(static_cast<int>(pc));
+            if (count == 0)
+                snprintf(buffer, sizeof(buffer), "  %8zu %8d                      ", pc + 1, line);
+            else
+            {
+                snprintf(buffer, sizeof(buffer), "  %8zu %8d  %s  %s  ", pc + 1, line,
+                    FormatPercent(count, m_uSampleCount).c_str(), FormatPercent(count, counter.Total).c_str());
+            }
+            out << buffer << LuaObjects::FormatInstruction(info->Code[pc], static_cast<int>(pc)) << endl;
+        }
+        out << endl;
+    }
+
+    if (m_uInvalidPcCount > 0)
+        out << m_uInvalidPcCount << " sample(s) with an out-of-range pc ignored" << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////// OpCodeReport
+
+OpCodeReport::OpCodeReport(const ProtoCache& cache, unsigned topCount)
+    : m_pProtoCache(cache), m_uTopCount(topCount)
+{
+}
+
+void OpCodeReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo&)
+{
+    ++m_uSampleCount;
+    if (stack.empty())
+        return;
+
+    const auto& top = stack.front();
+    if (top.Type == LuaFunctionType::Native)
+    {
+        ++m_uNativeCount;
+        return;
+    }
+
+    LuaObjects::Instruction i = 0;
+    if (!GetCurrentInstruction(top, m_pProtoCache, i))
+        return;
+    auto op = static_cast<unsigned>(LuaObjects::GetOpCode(i));
+    if (op >= LuaObjects::NUM_OPCODES)
+        return;
+
+    ++m_stOpCodeCounter[op];
+
+    auto& counter = m_stFunctionCounter[top.ProtoAddress];
+    if (counter.Name.empty())
+        counter.Name = FormatStackFrame(top);
+    ++counter.OpCodeCounter[op];
+    ++counter.Total;
+}
+
+void OpCodeReport::Write(std::ostream& out)
+{
+    using LuaObjects::NUM_OPCODES;
+
+    auto sortOpCodes = [](const size_t (&counter)[NUM_OPCODES]) {
+        vector<unsigned> ret;
+        for (unsigned op = 0; op < NUM_OPCODES; ++op)
+        {
+            if (counter[op] > 0)
+                ret.push_back(op);
+        }
+        sort(ret.begin(), ret.end(), [&](unsigned lhs, unsigned rhs) { return counter[lhs] > counter[rhs]; });
+        return ret;
+    };
+
+    char buffer[64];
+    out << "opcode            samples    total%" << endl;
+    for (auto op : sortOpCodes(m_stOpCodeCounter))
+    {
+        snprintf(buffer, sizeof(buffer), "OP_%-12s %10zu  %s", LuaObjects::GetOpCodeName(
+            static_cast<LuaObjects::OpCode>(op)), m_stOpCodeCounter[op],
+            FormatPercent(m_stOpCodeCounter[op], m_uSampleCount).c_str());
+        out << buffer << endl;
+    }
+    snprintf(buffer, sizeof(buffer), "%-15s %10zu  %s", "(native)", m_uNativeCount,
+        FormatPercent(m_uNativeCount, m_uSampleCount).c_str());
+    out << buffer << endl << endl;
+
+    vector<const FunctionCounter*> functions;
+    functions.reserve(m_stFunctionCounter.size());
+    for (const auto& it : m_stFunctionCounter)
+        functions.push_back(&it.second);
+    sort(functions.begin(), functions.end(), [](const FunctionCounter* lhs, const FunctionCounter* rhs) {
+        return lhs->Total > rhs->Total;
+    });
+    if (functions.size() > m_uTopCount)
+        functions.resize(m_uTopCount);
+
+    for (auto function : functions)
+    {
+        out << function->Name << " (" << FormatPercent(function->Total, m_uSampleCount) << ")" << endl << "   ";
+        for (auto op : sortOpCodes(function->OpCodeCounter))
+        {
+            out << " OP_" << LuaObjects::GetOpCodeName(static_cast<LuaObjects::OpCode>(op)) << " "
+                << FormatPercent(function->OpCodeCounter[op], function->Total);
+        }
+        out << endl;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////// PProfReport
+
+PProfReport::PProfReport(const ReportOptions& options)
+    : m_stProfile(options.LineMode), m_stStartTime(chrono::steady_clock::now())
+{
+    m_stProfile.SetPeriod(static_cast<uint64_t>(options.SampleInterval) * 1000000u);
+    m_stProfile.SetStartTime(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch()).count()));
+    for (const auto& mapping : options.Mappings)
+        m_stProfile.AddMapping(mapping.Start, mapping.End, mapping.Offset, mapping.Path);
+    for (const auto& label : options.Labels)
+        m_stProfile.SetLabel(label.first, label.second);
+}
+
+void PProfReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo&)
+{
+    auto id = m_stProfile.InternStack(stack);
+    if (id != INVALID_PROFILE_ID)
+        m_stProfile.AddSample(id);
+}
+
+void PProfReport::Write(std::ostream& out)
+{
+    m_stProfile.SetDuration(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - m_stStartTime).count()));
+    WritePProf(m_stProfile, out);
+}
+
+//////////////////////////////////////////////////////////////////////////////// TimelineReport
+
+TimelineReport::TimelineReport(Format format, const ReportOptions& options)
+    : m_iFormat(format), m_stProfile(options.LineMode)
+{
+    m_stProfile.SetPeriod(static_cast<uint64_t>(options.SampleInterval) * 1000000u);
+}
+
+void TimelineReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)
+{
+    auto id = m_stProfile.InternStack(stack);
+    if (id != INVALID_PROFILE_ID)
+        m_stProfile.AddSample(id);
+    m_stTimeline.Append(info.Time, info.Thread, id);
+}
+
+void TimelineReport::Write(std::ostream& out)
+{
+    switch (m_iFormat)
+    {
+        case Format::Speedscope:
+            WriteSpeedscope(m_stProfile, m_stTimeline, out);
+            break;
+        case Format::ChromeTrace:
+        default:
+            WriteChromeTrace(m_stProfile, m_stTimeline, out);
+            break;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////// FlameGraphReport
+
+FlameGraphReport::FlameGraphReport(const ReportOptions& options, bool html)
+    : m_stProfile(options.LineMode)
+{
+    m_stOptions.Html = html;
+}
+
+void FlameGraphReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo&)
+{
+    auto id = m_stProfile.InternStack(stack);
+    if (id != INVALID_PROFILE_ID)
+        m_stProfile.AddSample(id);
+}
+
+void FlameGraphReport::Write(std::ostream& out)
+{
+    WriteFlameGraph(m_stProfile, out, m_stOptions);
+}
+
+//////////////////////////////////////////////////////////////////////////////// TopKReport
+
+TopKReport::TopKReport(const ReportOptions& options)
+    : m_stProfile(options.LineMode, options.MemoryCap)
+{
+}
+
+void TopKReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo&)
+{
+    m_stProfile.AddSample(stack);
+}
+
+void TopKReport::Write(std::ostream& out)
+{
+    Profile profile;
+    auto tail = m_stProfile.BuildProfile(profile);
+    auto total = m_stProfile.GetTotalSampleCount();
+    auto error = m_stProfile.GetErrorBound();
+
+    out << StringUtils::Format("# {0} samples, {1} stacks tracked in {2} KB, {3} evicted\n", total,
+        m_stProfile.GetTrackedCount(), m_stProfile.GetMemoryUsage() / 1024, m_stProfile.GetEvictionCount());
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "# each stack is undercounted by at most %" PRIu64 " samples (%.2f%%), "
+        "%" PRIu64 " samples (%.2f%%) folded into (tail) buckets\n", error, total == 0 ? 0. : error * 100. / total,
+        tail, total == 0 ? 0. : tail * 100. / total);
+    out << buffer;
+    WriteFoldedProfile(profile, out);
+}
+
+//////////////////////////////////////////////////////////////////////////////// CallgrindReport
+
+CallgrindReport::CallgrindReport()
+    : m_stProfile(true)
+{
+}
+
+void CallgrindReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo&)
+{
+    auto id = m_stProfile.InternStack(stack);
+    if (id != INVALID_PROFILE_ID)
+        m_stProfile.AddSample(id);
+}
+
+void CallgrindReport::Write(std::ostream& out)
+{
+    WriteCallgrind(m_stProfile, out);
+}
+
+//////////////////////////////////////////////////////////////////////////////// BinaryReport
+
+BinaryReport::BinaryReport(const ReportOptions& options)
+    : m_stProfile(options.LineMode), m_stStartTime(chrono::steady_clock::now())
+{
+    m_stProfile.SetPeriod(static_cast<uint64_t>(options.SampleInterval) * 1000000u);
+    m_stProfile.SetStartTime(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch()).count()));
+    for (const auto& mapping : options.Mappings)
+        m_stProfile.AddMapping(mapping.Start, mapping.End, mapping.Offset, mapping.Path);
+    for (const auto& label : options.Labels)
+        m_stProfile.SetLabel(label.first, label.second);
+}
+
+void BinaryReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo& info)
+{
+    auto id = m_stProfile.InternStack(stack);
+    if (id != INVALID_PROFILE_ID)
+        m_stProfile.AddSample(id);
+    m_stTimeline.Append(info.Time, info.Thread, id);
+}
+
+void BinaryReport::Write(std::ostream& out)
+{
+    m_stProfile.SetDuration(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - m_stStartTime).count()));
+    WriteBinaryProfile(m_stProfile, &m_stTimeline, out);
+}
+
+//////////////////////////////////////////////////////////////////////////////// LoopReport
+
+LoopReport::LoopReport(const ProtoCache& cache, unsigned topCount)
+    : m_pProtoCache(cache), m_uTopCount(topCount)
+{
+}
+
+void LoopReport::OnSample(const std::vector<LuaStackFrame>& stack, const SampleInfo&)
+{
+    ++m_uSampleCount;
+
+    // 栈顶为原生函数时，其下的LUA循环不计自身
+    bool top = true;
+    for (const auto& frame : stack)
+    {
+        auto isTop = top;
+        top = false;
+        if (frame.Type != LuaFunctionType::Lua)
+            continue;
+
+        auto protoInfo = m_pProtoCache.Find(frame.ProtoAddress);
+        auto innermost = protoInfo ? protoInfo->GetInnermostLoop(frame.Pc) : -1;
+        if (innermost >= 0)
+        {
+            for (int i = 0; i <= innermost; ++i)
+            {
+                if (!protoInfo->Loops[i].Contains(frame.Pc))
+                    continue;
+
+                auto& counter = m_stLoopCounter[make_pair(frame.ProtoAddress, i)];
+                if (counter.Name.empty())
+                    counter.Name = FormatStackFrame(frame);
+                if (isTop && i == innermost)
+                    ++counter.Self;
+                if (counter.LastSample != m_uSampleCount)  // 递归调用时只计一次
+                {
+                    ++counter.Total;
+                    counter.LastSample = m_uSampleCount;
+                }
+            }
+        }
+    }
+}
+
+void LoopReport::Write(std::ostream& out)
+{
+    static const char* LOOP_TYPE_NAMES[] = { "for", "for-in", "jump" };
+
+    vector<pair<const pair<uintptr_t, int>*, const LoopCounter*>> loops;
+    loops.reserve(m_stLoopCounter.size());
+    for (const auto& it : m_stLoopCounter)
+        loops.emplace_back(&it.first, &it.second);
+    sort(loops.begin(), loops.end(), [](const pair<const pair<uintptr_t, int>*, const LoopCounter*>& lhs,
+        const pair<const pair<uintptr_t, int>*, const LoopCounter*>& rhs) {
+        if (lhs.second->Total != rhs.second->Total)
+            return lhs.second->Total > rhs.second->Total;
+        return lhs.second->Self > rhs.second->Self;
+    });
+    if (loops.size() > m_uTopCount)
+        loops.resize(m_uTopCount);
+
+    char buffer[96];
+    out << "   total%    total    self%     self  type     lines          function" << endl;
+    for (const auto& it : loops)
+    {
+        auto info = m_pProtoCache.Find(it.first->first);
+        assert(info);
+        const auto& loop = info->Loops[it.first->second];
+
+        snprintf(buffer, sizeof(buffer), "  %s %8zu  %s %8zu  %-7s  %6d-%-6d  ",
+            FormatPercent(it.second->Total, m_uSampleCount).c_str(), it.second->Total,
+            FormatPercent(it.second->Self, m_uSampleCount).c_str(), it.second->Self,
+            LOOP_TYPE_NAMES[static_cast<int>(loop.Type)], loop.StartLine, loop.EndLine);
+        out << buffer << it.second->Name << endl;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////// Utils
+
+bool lperf::GetCurrentInstruction(const LuaStackFrame& frame, const ProtoCache& cache, LuaObjects::Instruction& out)
+{
+    if (frame.Type != LuaFunctionType::Lua || frame.Pc < 0)
+        return false;
+
+    auto info = cache.Find(frame.ProtoAddress);
+    if (!info || static_cast<size_t>(frame.Pc) >= info->Code.size())
+        return false;
+    out = info->Code[frame.Pc];
+    return true;
+}
+
+std::string lperf::FormatStackFrame(const LuaStackFrame& frame, bool lineMode)
+{
+    switch (frame.Type)
+    {
+        case LuaFunctionType::Native:
+            if (frame.Name.empty())
+                return StringUtils::Format("[0x{0,16[0]:H}]", frame.Address);
+            return StringUtils::Format("[{0}]", frame.Name);
+        case LuaFunctionType::Lua:
+            return StringUtils::Format("{0} @ {1}:{2}", frame.Name.empty() ? "?" : frame.Name, frame.Source,
+                lineMode ? frame.CurrentLine : frame.Line);
+        case LuaFunctionType::VirtualMachine:
+            return StringUtils::Format("[{0}]", frame.Name);
+        case LuaFunctionType::Unknown:
+        default:
+            return frame.Name.empty() ? "?" : frame.Name;
+    }
+}
+
+std::string lperf::FormatProfileFrame(const Profile& profile, const ProfileFrame& frame)
+{
+    LuaStackFrame f;
+    f.Type = frame.Type;
+    f.Address = frame.Address;
+    f.Source = profile.GetString(frame.Source);
+    f.Name = profile.GetString(frame.Name);
+    f.Line = frame.LineDefined;
+    f.CurrentLine = frame.Line;
+    return FormatStackFrame(f, profile.IsLineMode());
+}
+
+std::string lperf::EscapeFoldedLabel(const std::string& text)
+{
+    static const char HEX[] = "0123456789ABCDEF";
+
+    string ret;
+    ret.reserve(text.size());
+    for (auto ch : text)
+    {
+        auto c = static_cast<unsigned char>(ch);
+        if (c <= ' ' || c == 0x7F || c == '%' || c == '=')
+        {
+            ret.push_back('%');
+            ret.push_back(HEX[c >> 4]);
+            ret.push_back(HEX[c & 0xF]);
+        }
+        else
+            ret.push_back(ch);
+    }
+    return ret;
+}
+
+std::string lperf::UnescapeFoldedLabel(const std::string& text)
+{
+    string ret;
+    ret.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == '%' && i + 2 < text.size() && isxdigit(static_cast<unsigned char>(text[i + 1])) &&
+            isxdigit(static_cast<unsigned char>(text[i + 2])))
+        {
+            ret.push_back(static_cast<char>(strtoul(text.substr(i + 1, 2).c_str(), nullptr, 16)));
+            i += 2;
+        }
+        else
+            ret.push_back(text[i]);
+    }
+    return ret;
+}
+
+void lperf::WriteFoldedProfile(const Profile& profile, std::ostream& out)
+{
+    for (const auto& label : profile.GetLabels())
+    {
+        out << FOLDED_LABEL_PREFIX << EscapeFoldedLabel(profile.GetString(label.Key)) << "=" <<
+            EscapeFoldedLabel(profile.GetString(label.Value)) << "\n";
+    }
+
+    vector<string> frameTexts(profile.GetFrameCount());
+    for (ProfileId i = 0; i < profile.GetFrameCount(); ++i)
+        frameTexts[i] = FormatProfileFrame(profile, profile.GetFrame(i));
+
+    vector<pair<string, uint64_t>> lines;
+    vector<ProfileId> frames;
+    for (ProfileId id = 0; id < profile.GetStackCount(); ++id)
+    {
+        auto count = profile.GetSampleCount(id);
+        if (count == 0)
+            continue;
+
+        profile.GetStackFrames(id, frames);
+        string text("(base);");
+        for (auto frame : frames)
+        {
+            if (profile.IsIdleFrame(frame))
+                continue;
+            text.append(frameTexts[frame]);
+            text.push_back(';');
+        }
+        lines.emplace_back(std::move(text), count);
+    }
+    sort(lines.begin(), lines.end());
+
+    // 不同的栈帧可能格式化为相同的文本（如同名的C函数），需要合并
+    for (size_t i = 0; i < lines.size(); )
+    {
+        auto count = lines[i].second;
+        size_t j = i + 1;
+        for (; j < lines.size() && lines[j].first == lines[i].first; ++j)
+            count += lines[j].second;
+        out << lines[i].first << " " << count << "\n";
+        i = j;
+    }
+    out.flush();
+}
+
+void lperf::CollectProcessInfo(Debugger& debugger, ReportOptions& options)
+{
+    try
+    {
+        options.Mappings = debugger.GetExecutableMappings();
+    }
+    catch (const ExceptionBase& ex)
+    {
+        MOE_LOG_WARN("Read memory mappings failure: {0}", ex.GetDescription());
+    }
+
+    // 用于合并多个进程的结果时分组
+    char host[256] = {};
+    if (::gethostname(host, sizeof(host) - 1) == 0)
+        options.Labels.emplace_back("host", host);
+    options.Labels.emplace_back("pid", to_string(debugger.GetPid()));
+    try
+    {
+        auto buildId = debugger.GetBuildId();
+        if (!buildId.empty())
+            options.Labels.emplace_back("build-id", buildId);
+        options.Labels.emplace_back("cmdline", debugger.GetCommandLine());
+    }
+    catch (const ExceptionBase& ex)
+    {
+        MOE_LOG_WARN("Read process information failure: {0}", ex.GetDescription());
+    }
+}
+
+ReportPtr lperf::CreateReport(const std::string& name, const ReportOptions& options, const ProtoCache& cache)
+{
+    if (name == "folded")
+        return ReportPtr(new FoldedReport(options.LineMode));
+    else if (name == "lines")
+        return ReportPtr(new LineReport());
+    else if (name == "bytecode")
+        return ReportPtr(new BytecodeReport(cache, options.TopCount));
+    else if (name == "opcodes")
+        return ReportPtr(new OpCodeReport(cache, options.TopCount));
+    else if (name == "opcodes-folded")
+        return ReportPtr(new FoldedReport(options.LineMode, &cache));
+    else if (name == "loops")
+        return ReportPtr(new LoopReport(cache, options.TopCount));
+    else if (name == "pprof")
+        return ReportPtr(new PProfReport(options));
+    else if (name == "speedscope")
+        return ReportPtr(new TimelineReport(TimelineReport::Format::Speedscope, options));
+    else if (name == "trace")
+        return ReportPtr(new TimelineReport(TimelineReport::Format::ChromeTrace, options));
+    else if (name == "topk")
+        return ReportPtr(new TopKReport(options));
+    else if (name == "svg")
+        return ReportPtr(new FlameGraphReport(options, false));
+    else if (name == "html")
+        return ReportPtr(new FlameGraphReport(options, true));
+    else if (name == "callgrind")
+        return ReportPtr(new CallgrindReport());
+    else if (name == "binary")
+        return ReportPtr(new BinaryReport(options));
+    MOE_THROW(BadArgumentException, "Unknown report type: {0}", name);
+}
@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "SamplePipeline.hpp"
+
+#include <chrono>
+#include <Moe.Core/Logging.hpp>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+namespace
+{
+    // 队列为空或已满时的等待间隔，不影响捕获，只决定后两级的响应延迟
+    const chrono::milliseconds IDLE_WAIT(1);
+}
+
+SamplePipeline::SamplePipeline(LuaSampler& sampler, const SampleCallback& onSample, size_t queueSize)
+    : m_pSampler(sampler), m_stOnSample(onSample), m_stRawQueue(queueSize), m_stSymbolizedQueue(queueSize)
+{
+    m_stSymbolizer = thread([this]() { RunSymbolizer(); });
+    m_stAggregator = thread([this]() { RunAggregator(); });
+}
+
+SamplePipeline::~SamplePipeline()
+{
+    Stop();
+}
+
+bool SamplePipeline::Capture(uintptr_t address, const SampleInfo& info)
+{
+    assert(!m_bCaptureFinished);
+
+    // 没有空闲槽位时不暂停目标进程
+    auto slot = m_stRawQueue.BeginPush();
+    if (!slot)
+    {
+        ++m_uDroppedCount;
+        return false;
+    }
+
+    m_pSampler.CaptureStack(address, slot->Stack);
+    slot->Info = info;
+    m_stRawQueue.EndPush();
+    return true;
+}
+
+void SamplePipeline::Stop()
+{
+    if (!m_stSymbolizer.joinable())
+        return;
+
+    m_bCaptureFinished.store(true, memory_order_release);
+    m_stSymbolizer.join();
+    m_stAggregator.join();
+
+    if (m_uDroppedCount > 0)
+        MOE_LOG_WARN("{0} sample(s) dropped because symbolization fell behind", m_uDroppedCount);
+}
+
+void SamplePipeline::RunSymbolizer()
+{
+    while (true)
+    {
+        auto raw = m_stRawQueue.BeginPop();
+        if (!raw)
+        {
+            // 先检查结束标志再检查队列，保证结束前提交的采样都被处理
+            if (m_bCaptureFinished.load(memory_order_acquire))
+            {
+                raw = m_stRawQueue.BeginPop();
+                if (!raw)
+                    break;
+            }
+            else
+            {
+                this_thread::sleep_for(IDLE_WAIT);
+                continue;
+            }
+        }
+
+        // 聚合跟不上时在此等待，压力最终反映为捕获时的丢弃
+        SymbolizedSample* out = nullptr;
+        while (!(out = m_stSymbolizedQueue.BeginPush()))
+            this_thread::sleep_for(IDLE_WAIT);
+
+        try
+        {
+            m_pSampler.Symbolize(raw->Stack, out->Stack);
+            out->Info = raw->Info;
+            m_stSymbolizedQueue.EndPush();
+        }
+        catch (const ExceptionBase& ex)
+        {
+            MOE_LOG_ERROR("Symbolize frame failure: {0}", ex.GetDescription());
+        }
+        catch (const std::exception& ex)
+        {
+            MOE_LOG_ERROR("Symbolize frame failure: {0}", ex.what());
+        }
+        m_stRawQueue.EndPop();
+    }
+
+    m_bSymbolizeFinished.store(true, memory_order_release);
+}
+
+void SamplePipeline::RunAggregator()
+{
+    while (true)
+    {
+        auto sample = m_stSymbolizedQueue.BeginPop();
+        if (!sample)
+        {
+            if (m_bSymbolizeFinished.load(memory_order_acquire))
+            {
+                sample = m_stSymbolizedQueue.BeginPop();
+                if (!sample)
+                    break;
+            }
+            else
+            {
+                this_thread::sleep_for(IDLE_WAIT);
+                continue;
+            }
+        }
+
+        try
+        {
+            MOE_LOG_INFO("Captured stack, depth {0}", sample->Stack.size());
+            m_stOnSample(sample->Stack, sample->Info);
+        }
+        catch (const ExceptionBase& ex)
+        {
+            MOE_LOG_ERROR("Aggregate frame failure: {0}", ex.GetDescription());
+        }
+        catch (const std::exception& ex)
+        {
+            MOE_LOG_ERROR("Aggregate frame failure: {0}", ex.what());
+        }
+        m_stSymbolizedQueue.EndPop();
+    }
+}
@@ -0,0 +1,211 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "SegmentStore.hpp"
+#include "BinaryProfile.hpp"
+#include "GzipStream.hpp"
+
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <Moe.Core/Logging.hpp>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+const char* const SegmentStore::INDEX_FILE_NAME = "index";
+
+namespace
+{
+    void WriteIndexLine(std::ostream& out, const SegmentInfo& segment)
+    {
+        out << segment.StartTime << ' ' << segment.EndTime << ' ' << segment.SampleCount << ' ' << segment.Size <<
+            ' ' << segment.File << '\n';
+    }
+}
+
+SegmentStore::SegmentStore(const std::string& dir, uint64_t budget, bool readOnly)
+    : m_stDir(dir), m_uBudget(budget), m_bReadOnly(readOnly)
+{
+    if (m_stDir.empty())
+        MOE_THROW(BadArgumentException, "Segment directory is empty");
+    if (!m_bReadOnly && ::mkdir(m_stDir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        MOE_THROW(ApiException, "Create directory \"{0}\" error, errno={1}({2})", m_stDir, errno,
+            strerror(errno));
+    }
+
+    LoadIndex();
+}
+
+void SegmentStore::Write(const Profile& profile)
+{
+    if (m_bReadOnly)
+        MOE_THROW(InvalidCallException, "Segment store is read only");
+
+    SegmentInfo segment;
+    segment.StartTime = profile.GetStartTime();
+    segment.EndTime = profile.GetStartTime() + profile.GetDuration();
+    segment.SampleCount = profile.GetTotalSampleCount();
+    segment.File = StringUtils::Format("segment-{0}.lprof.gz", segment.StartTime / 1000000u);
+
+    // 先写入临时文件再替换，中途退出时不会留下不完整的分段
+    auto path = GetPath(segment);
+    auto tmp = path + ".tmp";
+    {
+        ostringstream binary;
+        WriteBinaryProfile(profile, nullptr, binary);
+
+        ofstream out(tmp, ios::out | ios::trunc | ios::binary);
+        if (!out)
+            MOE_THROW(ApiException, "Cannot open segment \"{0}\"", tmp);
+        GzipOutputStream gzip(out);
+        gzip.Write(binary.str());
+        gzip.Finish();
+        out.flush();
+        if (!out)
+            MOE_THROW(ApiException, "Write segment \"{0}\" error", tmp);
+        segment.Size = static_cast<uint64_t>(out.tellp());
+    }
+    if (::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        MOE_THROW(ApiException, "Rename \"{0}\" to \"{1}\" error, errno={2}({3})", tmp, path, errno,
+            strerror(errno));
+    }
+
+    // 同一毫秒内的分段会覆盖之前的文件，此时索引中已有该文件的记录，需要整体重写
+    auto it = find_if(m_stSegments.begin(), m_stSegments.end(), [&](const SegmentInfo& s) {
+        return s.File == segment.File;
+    });
+    auto replaced = (it != m_stSegments.end());
+    if (replaced)
+    {
+        m_uTotalSize -= it->Size;
+        m_stSegments.erase(it);
+    }
+    m_stSegments.push_back(segment);
+    m_uTotalSize += segment.Size;
+
+    auto overBudget = (m_uBudget > 0 && m_uTotalSize > m_uBudget);
+    if (overBudget)
+        EnforceBudget();
+    if (overBudget || replaced)
+        SaveIndex();
+    else
+    {
+        ofstream index(m_stDir + "/" + INDEX_FILE_NAME, ios::out | ios::app);
+        if (!index)
+            MOE_THROW(ApiException, "Cannot open index in \"{0}\"", m_stDir);
+        WriteIndexLine(index, segment);
+    }
+}
+
+std::vector<SegmentInfo> SegmentStore::Query(uint64_t from, uint64_t to)const
+{
+    vector<SegmentInfo> ret;
+    for (const auto& segment : m_stSegments)
+    {
+        if (segment.EndTime > from && segment.StartTime < to)
+            ret.push_back(segment);
+    }
+    return ret;
+}
+
+std::string SegmentStore::GetPath(const SegmentInfo& segment)const
+{
+    return m_stDir + "/" + segment.File;
+}
+
+void SegmentStore::LoadIndex()
+{
+    ifstream in(m_stDir + "/" + INDEX_FILE_NAME);
+    if (!in)
+    {
+        if (m_bReadOnly)
+            MOE_THROW(ObjectNotFoundException, "Cannot open index in \"{0}\"", m_stDir);
+        return;
+    }
+
+    bool dirty = false;
+    string line;
+    while (getline(in, line))
+    {
+        if (line.empty())
+            continue;
+
+        SegmentInfo segment;
+        istringstream fields(line);
+        if (!(fields >> segment.StartTime >> segment.EndTime >> segment.SampleCount >> segment.Size >>
+            segment.File) || segment.File.find('/') != string::npos)
+        {
+            MOE_LOG_WARN("Ignore corrupted index line: {0}", line);
+            dirty = true;
+            continue;
+        }
+
+        struct stat st;
+        if (::stat(GetPath(segment).c_str(), &st) != 0)
+        {
+            dirty = true;
+            continue;
+        }
+        m_stSegments.push_back(segment);
+        m_uTotalSize += segment.Size;
+    }
+
+    stable_sort(m_stSegments.begin(), m_stSegments.end(), [](const SegmentInfo& lhs, const SegmentInfo& rhs) {
+        return lhs.StartTime < rhs.StartTime;
+    });
+    if (m_bReadOnly)
+        return;
+    if (m_uBudget > 0 && m_uTotalSize > m_uBudget)
+    {
+        EnforceBudget();
+        dirty = true;
+    }
+    if (dirty)
+        SaveIndex();
+}
+
+void SegmentStore::SaveIndex()const
+{
+    auto path = m_stDir + "/" + INDEX_FILE_NAME;
+    auto tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::out | ios::trunc);
+        if (!out)
+            MOE_THROW(ApiException, "Cannot open index \"{0}\"", tmp);
+        for (const auto& segment : m_stSegments)
+            WriteIndexLine(out, segment);
+        if (!out)
+            MOE_THROW(ApiException, "Write index \"{0}\" error", tmp);
+    }
+    if (::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        MOE_THROW(ApiException, "Rename \"{0}\" to \"{1}\" error, errno={2}({3})", tmp, path, errno,
+            strerror(errno));
+    }
+}
+
+void SegmentStore::EnforceBudget()
+{
+    // 至少保留最新的分段
+    size_t count = 0;
+    while (count + 1 < m_stSegments.size() && m_uTotalSize > m_uBudget)
+    {
+        const auto& segment = m_stSegments[count++];
+        if (::unlink(GetPath(segment).c_str()) != 0 && errno != ENOENT)
+            MOE_LOG_WARN("Remove segment \"{0}\" error, errno={1}({2})", segment.File, errno, strerror(errno));
+        m_uTotalSize -= segment.Size;
+    }
+    if (count > 0)
+        MOE_LOG_INFO("Removed {0} segment(s) to keep within the disk budget", count);
+    m_stSegments.erase(m_stSegments.begin(), m_stSegments.begin() + count);
+}
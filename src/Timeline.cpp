@@ -0,0 +1,345 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#include "Timeline.hpp"
+#include "Report.hpp"
+
+#include <ostream>
+#include <limits>
+#include <cinttypes>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+namespace
+{
+    void AppendVarint(std::vector<uint8_t>& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    bool ReadVarint(const uint8_t* data, size_t size, size_t& offset, uint64_t& out)noexcept
+    {
+        out = 0;
+        for (unsigned shift = 0; offset < size && shift < 64; shift += 7)
+        {
+            auto c = data[offset++];
+            out |= static_cast<uint64_t>(c & 0x7F) << shift;
+            if ((c & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    void WriteJsonString(std::ostream& out, const std::string& str)
+    {
+        out.put('"');
+        for (auto c : str)
+        {
+            switch (c)
+            {
+                case '"':
+                    out << "\\\"";
+                    break;
+                case '\\':
+                    out << "\\\\";
+                    break;
+                case '\n':
+                    out << "\\n";
+                    break;
+                case '\r':
+                    out << "\\r";
+                    break;
+                case '\t':
+                    out << "\\t";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20)
+                    {
+                        char buffer[8];
+                        snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(c));
+                        out << buffer;
+                    }
+                    else
+                        out.put(c);
+                    break;
+            }
+        }
+        out.put('"');
+    }
+
+    string FormatMicroseconds(uint64_t ns)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%" PRIu64 ".%03u", ns / 1000, static_cast<unsigned>(ns % 1000));
+        return buffer;
+    }
+
+    string FormatThreadName(uint64_t thread)
+    {
+        return StringUtils::Format("lua_State 0x{0,16[0]:H}", thread);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////// Timeline
+
+bool Timeline::Reader::Next(TimelineSample& out)noexcept
+{
+    if (m_uOffset >= m_uSize)
+        return false;
+
+    uint64_t delta = 0, thread = 0, stack = 0;
+    if (!ReadVarint(m_pData, m_uSize, m_uOffset, delta) || !ReadVarint(m_pData, m_uSize, m_uOffset, thread) ||
+        !ReadVarint(m_pData, m_uSize, m_uOffset, stack) || thread > numeric_limits<uint32_t>::max() ||
+        stack > numeric_limits<ProfileId>::max())
+    {
+        m_uOffset = m_uSize;
+        m_bCorrupted = true;
+        return false;
+    }
+
+    m_uTime += delta;
+    out.Time = m_uTime;
+    out.Thread = static_cast<uint32_t>(thread);
+    out.Stack = static_cast<ProfileId>(stack - 1);  // 0 -> INVALID_PROFILE_ID
+    return true;
+}
+
+void Timeline::Append(uint64_t time, uint64_t thread, ProfileId stack)
+{
+    // 第一个采样记录绝对时刻，之后记录增量，时间不允许回退
+    uint64_t delta = 0;
+    if (m_uSampleCount == 0)
+    {
+        m_uStartTime = m_uLastTime = time;
+        delta = time;
+    }
+    else if (time > m_uLastTime)
+    {
+        delta = time - m_uLastTime;
+        m_uLastTime = time;
+    }
+
+    uint32_t index = 0;
+    auto it = m_stThreadIndex.find(thread);
+    if (it != m_stThreadIndex.end())
+        index = it->second;
+    else
+    {
+        index = static_cast<uint32_t>(m_stThreads.size());
+        m_stThreads.push_back(thread);
+        m_stThreadIndex.emplace(thread, index);
+    }
+
+    AppendVarint(m_stBuffer, delta);
+    AppendVarint(m_stBuffer, index);
+    AppendVarint(m_stBuffer, static_cast<uint64_t>(stack) + 1);
+    ++m_uSampleCount;
+}
+
+void Timeline::Assign(const uint8_t* data, size_t size, const std::vector<uint64_t>& threads)
+{
+    m_stBuffer.assign(data, data + size);
+    m_stThreads = threads;
+    m_stThreadIndex.clear();
+    for (uint32_t i = 0; i < m_stThreads.size(); ++i)
+        m_stThreadIndex.emplace(m_stThreads[i], i);
+
+    m_uSampleCount = 0;
+    m_uStartTime = m_uLastTime = 0;
+    Reader reader(*this);
+    TimelineSample sample;
+    while (reader.Next(sample))
+    {
+        if (sample.Thread >= m_stThreads.size())
+            MOE_THROW(BadFormatException, "Invalid thread index {0} in timeline", sample.Thread);
+        if (m_uSampleCount == 0)
+            m_uStartTime = sample.Time;
+        m_uLastTime = sample.Time;
+        ++m_uSampleCount;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////// Writers
+
+void lperf::WriteSpeedscope(const Profile& profile, const Timeline& timeline, std::ostream& out)
+{
+    auto start = timeline.GetStartTime();
+
+    out << "{\"$schema\":\"https://www.speedscope.app/file-format-schema.json\",\"exporter\":\"lperf\",";
+    out << "\"shared\":{\"frames\":[";
+    for (ProfileId i = 0; i < profile.GetFrameCount(); ++i)
+    {
+        const auto& frame = profile.GetFrame(i);
+        if (i != 0)
+            out.put(',');
+        out << "{\"name\":";
+        WriteJsonString(out, FormatProfileFrame(profile, frame));
+        if (frame.Type == LuaFunctionType::Lua)
+        {
+            out << ",\"file\":";
+            WriteJsonString(out, profile.GetString(frame.Source));
+            out << ",\"line\":" << (frame.Line != 0 ? frame.Line : frame.LineDefined);
+        }
+        out.put('}');
+    }
+    out << "]},\"profiles\":[";
+
+    // 每个线程一个 profile，样本与权重分两趟输出
+    vector<ProfileId> frames;
+    const auto& threads = timeline.GetThreads();
+    for (uint32_t t = 0; t < threads.size(); ++t)
+    {
+        if (t != 0)
+            out.put(',');
+
+        uint64_t first = 0, last = 0;
+        bool hasSample = false;
+        {
+            Timeline::Reader reader(timeline);
+            TimelineSample sample;
+            while (reader.Next(sample))
+            {
+                if (sample.Thread != t)
+                    continue;
+                if (!hasSample)
+                    first = sample.Time;
+                last = sample.Time;
+                hasSample = true;
+            }
+        }
+
+        out << "{\"type\":\"sampled\",\"name\":";
+        WriteJsonString(out, FormatThreadName(threads[t]));
+        out << ",\"unit\":\"nanoseconds\",\"startValue\":" << (first - start) << ",\"endValue\":" <<
+            (last - start + profile.GetPeriod()) << ",\"samples\":[";
+        {
+            Timeline::Reader reader(timeline);
+            TimelineSample sample;
+            bool firstSample = true;
+            while (reader.Next(sample))
+            {
+                if (sample.Thread != t)
+                    continue;
+                if (!firstSample)
+                    out.put(',');
+                firstSample = false;
+
+                out.put('[');
+                if (sample.Stack != INVALID_PROFILE_ID)
+                {
+                    profile.GetStackFrames(sample.Stack, frames);
+                    for (size_t i = 0; i < frames.size(); ++i)
+                    {
+                        if (i != 0)
+                            out.put(',');
+                        out << frames[i];
+                    }
+                }
+                out.put(']');
+            }
+        }
+        out << "],\"weights\":[";
+        {
+            // 权重为到本线程下一个样本的间隔，最后一个样本取采样周期
+            Timeline::Reader reader(timeline);
+            TimelineSample sample;
+            bool hasPrev = false;
+            uint64_t prev = 0;
+            while (reader.Next(sample))
+            {
+                if (sample.Thread != t)
+                    continue;
+                if (hasPrev)
+                    out << (sample.Time - prev) << ',';
+                prev = sample.Time;
+                hasPrev = true;
+            }
+            if (hasPrev)
+                out << profile.GetPeriod();
+        }
+        out << "]}";
+    }
+    out << "]}\n";
+    out.flush();
+}
+
+void lperf::WriteChromeTrace(const Profile& profile, const Timeline& timeline, std::ostream& out)
+{
+    auto start = timeline.GetStartTime();
+    const auto& threads = timeline.GetThreads();
+
+    // 缓存帧名称
+    vector<string> names(profile.GetFrameCount());
+    for (ProfileId i = 0; i < profile.GetFrameCount(); ++i)
+        names[i] = FormatProfileFrame(profile, profile.GetFrame(i));
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool firstEvent = true;
+    auto writeEvent = [&](const char* ph, ProfileId frame, uint32_t thread, uint64_t time) {
+        if (!firstEvent)
+            out << ",\n";
+        firstEvent = false;
+
+        out << "{\"ph\":\"" << ph << "\",\"pid\":1,\"tid\":" << (thread + 1) << ",\"ts\":" <<
+            FormatMicroseconds(time - start);
+        if (frame != INVALID_PROFILE_ID)
+        {
+            out << ",\"cat\":\"lua\",\"name\":";
+            WriteJsonString(out, names[frame]);
+        }
+        out.put('}');
+    };
+
+    for (uint32_t t = 0; t < threads.size(); ++t)
+    {
+        if (!firstEvent)
+            out << ",\n";
+        firstEvent = false;
+
+        out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << (t + 1) << ",\"args\":{\"name\":";
+        WriteJsonString(out, FormatThreadName(threads[t]));
+        out << "}}";
+    }
+
+    // 比较相邻样本的堆栈，只为变化的部分生成事件
+    vector<vector<ProfileId>> current(threads.size());
+    vector<ProfileId> frames;
+    Timeline::Reader reader(timeline);
+    TimelineSample sample;
+    while (reader.Next(sample))
+    {
+        frames.clear();
+        if (sample.Stack != INVALID_PROFILE_ID)
+            profile.GetStackFrames(sample.Stack, frames);
+
+        auto& active = current[sample.Thread];
+        size_t common = 0;
+        while (common < active.size() && common < frames.size() && active[common] == frames[common])
+            ++common;
+
+        for (size_t i = active.size(); i > common; --i)
+            writeEvent("E", active[i - 1], sample.Thread, sample.Time);
+        for (size_t i = common; i < frames.size(); ++i)
+            writeEvent("B", frames[i], sample.Thread, sample.Time);
+        active.assign(frames.begin(), frames.end());
+    }
+
+    // 结束所有未关闭的帧
+    auto end = timeline.GetEndTime() + profile.GetPeriod();
+    for (uint32_t t = 0; t < current.size(); ++t)
+    {
+        for (size_t i = current[t].size(); i > 0; --i)
+            writeEvent("E", current[t][i - 1], t, end);
+    }
+    out << "]}\n";
+    out.flush();
+}
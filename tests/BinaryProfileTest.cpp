@@ -0,0 +1,184 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ *
+ * 验证二进制剖析文件中的时间线可以经 BinaryProfile::Load 原样读回，
+ * 以及时间线中越界的堆栈ID、线程序号与被截断的数据在打开时即被拒绝。
+ */
+#include "BinaryProfile.hpp"
+#include "Report.hpp"
+#include "TestCheck.hpp"
+
+#include <cstddef>
+#include <fstream>
+#include <unistd.h>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+
+namespace
+{
+    const uint64_t THREAD_A = 0x7F0000001000;
+    const uint64_t THREAD_B = 0x7F0000002000;
+
+    struct TempFile
+    {
+        string Path;
+
+        TempFile()
+        {
+            char path[] = "/tmp/lperf-test-XXXXXX";
+            auto fd = ::mkstemp(path);
+            if (fd >= 0)
+                ::close(fd);
+            Path = path;
+        }
+
+        ~TempFile()
+        {
+            ::unlink(Path.c_str());
+        }
+    };
+
+    LuaStackFrame MakeFrame(const char* name, unsigned line)
+    {
+        LuaStackFrame ret;
+        ret.Type = LuaFunctionType::Lua;
+        ret.Source = "@test.lua";
+        ret.Name = name;
+        ret.Line = line;
+        return ret;
+    }
+
+    void Write(const string& path, const Profile& profile, const Timeline& timeline)
+    {
+        ofstream out(path, ios::binary);
+        WriteBinaryProfile(profile, &timeline, out);
+    }
+
+    bool IsRejected(const string& path)
+    {
+        try
+        {
+            BinaryProfile binary(path);
+        }
+        catch (const BadFormatException&)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * 修改文件中时间线数据的第 offset 个字节
+     */
+    bool PatchTimeline(const string& path, size_t offset, uint8_t value)
+    {
+        fstream file(path, ios::binary | ios::in | ios::out);
+        BinaryProfileFormat::Header header;
+        TEST_CHECK(file.read(reinterpret_cast<char*>(&header), sizeof(header)));
+        TEST_CHECK(offset < header.TimelineSize);
+        file.seekp(static_cast<streamoff>(BinaryProfileFormat::ComputeLayout(header).Timeline + offset));
+        file.put(static_cast<char>(value));
+        return static_cast<bool>(file);
+    }
+
+    bool TestRoundTrip()
+    {
+        Profile profile;
+        Timeline timeline;
+        auto outer = profile.InternStack({ MakeFrame("outer", 1) });
+        auto inner = profile.InternStack({ MakeFrame("inner", 5), MakeFrame("outer", 1) });
+        auto idle = profile.InternStack({});
+        ProfileId stacks[] = { inner, outer, inner, idle, inner };
+        uint64_t threads[] = { THREAD_A, THREAD_B, THREAD_A, THREAD_A, THREAD_B };
+        for (size_t i = 0; i < 5; ++i)
+        {
+            profile.AddSample(stacks[i]);
+            timeline.Append(1000000 + i * 10000, threads[i], stacks[i]);
+        }
+
+        TempFile file;
+        Write(file.Path, profile, timeline);
+
+        BinaryProfile binary(file.Path);
+        Profile loaded;
+        Timeline loadedTimeline;
+        binary.Load(loaded, &loadedTimeline);
+        TEST_CHECK(loaded.GetTotalSampleCount() == 5);
+        TEST_CHECK(loadedTimeline.GetSampleCount() == 5);
+        TEST_CHECK(loadedTimeline.GetStartTime() == timeline.GetStartTime());
+
+        Timeline::Reader expected(timeline), actual(loadedTimeline);
+        TimelineSample lhs, rhs;
+        while (expected.Next(lhs))
+        {
+            TEST_CHECK(actual.Next(rhs));
+            TEST_CHECK(lhs.Time == rhs.Time);
+            TEST_CHECK(timeline.GetThreads()[lhs.Thread] == loadedTimeline.GetThreads()[rhs.Thread]);
+
+            vector<ProfileId> lhsFrames, rhsFrames;
+            profile.GetStackFrames(lhs.Stack, lhsFrames);
+            loaded.GetStackFrames(rhs.Stack, rhsFrames);
+            TEST_CHECK(lhsFrames.size() == rhsFrames.size());
+            for (size_t i = 0; i < lhsFrames.size(); ++i)
+            {
+                TEST_CHECK(FormatProfileFrame(profile, profile.GetFrame(lhsFrames[i])) ==
+                    FormatProfileFrame(loaded, loaded.GetFrame(rhsFrames[i])));
+            }
+        }
+        TEST_CHECK(!actual.Next(rhs));
+        TEST_CHECK(!actual.IsCorrupted());
+        return true;
+    }
+
+    bool TestCorruptedTimeline()
+    {
+        Profile profile;
+        auto stack = profile.InternStack({ MakeFrame("main", 1) });
+        profile.AddSample(stack);
+
+        // 引用不存在的堆栈
+        {
+            Timeline timeline;
+            timeline.Append(10, THREAD_A, stack);
+            timeline.Append(20, THREAD_A, stack + 5);
+            TempFile file;
+            Write(file.Path, profile, timeline);
+            TEST_CHECK(IsRejected(file.Path));
+        }
+
+        // 时刻与线程序号都只占一个字节，第二个字节即为线程序号
+        {
+            Timeline timeline;
+            timeline.Append(10, THREAD_A, stack);
+            TempFile file;
+            Write(file.Path, profile, timeline);
+            TEST_CHECK(!IsRejected(file.Path));
+            TEST_CHECK(PatchTimeline(file.Path, 1, 9));
+            TEST_CHECK(IsRejected(file.Path));
+        }
+
+        // 最后一个变长整数被截断
+        {
+            Timeline timeline;
+            timeline.Append(10, THREAD_A, stack);
+            TempFile file;
+            Write(file.Path, profile, timeline);
+            TEST_CHECK(PatchTimeline(file.Path, 2, 0x80));
+            TEST_CHECK(IsRejected(file.Path));
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    bool ok = true;
+    ok = TestRoundTrip() && ok;
+    ok = TestCorruptedTimeline() && ok;
+    std::printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+#include "LuaSampler.hpp"
+#include "TestCheck.hpp"
+
+namespace lperf
+{
+    namespace test
+    {
+        /**
+         * @brief 持有伪造的LUA调用链的子进程
+         *
+         * 调用链位于 fork 之前映射的共享内存中，父进程可以直接构造与修改，子进程中的地址与之相同，
+         * 因此可以像真实目标一样挂接并读取。最后一页不可访问，用于制造读取失败。
+         */
+        class FakeLuaProcess
+        {
+        public:
+            FakeLuaProcess(size_t pageCount)
+                : m_uPageSize(MemoryAccessorBase<>::GetPageSize()), m_uSize(pageCount * m_uPageSize)
+            {
+                auto data = ::mmap(nullptr, m_uSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+                if (data == MAP_FAILED)
+                    MOE_THROW(moe::ApiException, "mmap error, errno={0}", errno);
+                m_pData = static_cast<uint8_t*>(data);
+                ::mprotect(m_pData + m_uSize - m_uPageSize, m_uPageSize, PROT_NONE);
+
+                m_iPid = ::fork();
+                if (m_iPid < 0)
+                    MOE_THROW(moe::ApiException, "fork error, errno={0}", errno);
+                if (m_iPid == 0)
+                {
+                    ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+                    while (true)
+                        ::sleep(1);
+                }
+            }
+
+            ~FakeLuaProcess()
+            {
+                ::kill(m_iPid, SIGKILL);
+                ::waitpid(m_iPid, nullptr, __WALL);
+                ::munmap(m_pData, m_uSize);
+            }
+
+            FakeLuaProcess(const FakeLuaProcess&) = delete;
+            FakeLuaProcess& operator=(const FakeLuaProcess&) = delete;
+
+        public:
+            ProcessId GetPid()const noexcept { return static_cast<ProcessId>(m_iPid); }
+            size_t GetPageSize()const noexcept { return m_uPageSize; }
+
+            /**
+             * @brief 获取不可访问的最后一页的偏移
+             */
+            size_t GetGuardOffset()const noexcept { return m_uSize - m_uPageSize; }
+
+            /**
+             * @brief 在指定偏移处放置一个清零的对象
+             */
+            template <typename T>
+            T* Place(size_t offset)noexcept
+            {
+                assert(offset + sizeof(T) <= GetGuardOffset());
+                ::memset(m_pData + offset, 0, sizeof(T));
+                return reinterpret_cast<T*>(m_pData + offset);
+            }
+
+            uintptr_t GetAddress(size_t offset)const noexcept { return reinterpret_cast<uintptr_t>(m_pData + offset); }
+
+        private:
+            size_t m_uPageSize = 0;
+            size_t m_uSize = 0;
+            uint8_t* m_pData = nullptr;
+            pid_t m_iPid = -1;
+        };
+
+        /**
+         * @brief 串起调用链
+         * @param L lua_State
+         * @param frames 调用帧，栈顶在前，最后一帧的调用者为 base_ci
+         */
+        inline void LinkCallInfos(LuaObjects::lua_State* L, const std::vector<LuaObjects::CallInfo*>& frames)
+        {
+            L->ci.pointer = frames.empty() ? &L->base_ci : frames.front();
+            for (size_t i = 0; i < frames.size(); ++i)
+                frames[i]->previous.pointer = (i + 1 < frames.size()) ? frames[i + 1] : &L->base_ci;
+        }
+
+        /**
+         * @brief 设置函数值
+         * @param value 函数值
+         * @param tag 类型标记，如 MarkAsCollectableType(LUA_TLCL)
+         * @param object 闭包或轻量C函数的地址
+         */
+        inline void SetFunction(LuaObjects::TValue* value, unsigned tag, const void* object)noexcept
+        {
+            value->tt_ = static_cast<int>(tag);
+            value->value_.gc.pointer = reinterpret_cast<LuaObjects::GCObject*>(const_cast<void*>(object));
+        }
+
+        /**
+         * @brief 逐个字段读取调用链，作为批量读取的参照
+         * @return 是否所有读取都成功
+         *
+         * 每个对象单独调用一次 Debugger::ReadMemory，不经过 ReadPlanner。
+         */
+        inline bool ReadStackByField(const Debugger& dbg, uintptr_t address, LuaRawStack& out)
+        {
+            auto read = [&](uintptr_t remote, void* local, size_t size) {
+                return dbg.ReadMemory(remote, static_cast<uint8_t*>(local), size) == size;
+            };
+
+            out.Address = address;
+            out.Frames.clear();
+
+            RemotePtr<LuaObjects::CallInfo> ci { nullptr };
+            if (!read(address + offsetof(LuaObjects::lua_State, l_G), &out.Global, sizeof(out.Global)) ||
+                !read(address + offsetof(LuaObjects::lua_State, ci), &ci, sizeof(ci)))
+            {
+                return false;
+            }
+
+            auto base = address + offsetof(LuaObjects::lua_State, base_ci);
+            while (ci && ci != base)
+            {
+                LuaObjects::RawCallFrame frame;
+                ::memset(&frame, 0, sizeof(frame));
+                frame.Address = ci;
+                if (!read(reinterpret_cast<uintptr_t>(ci.pointer), &frame.Info, sizeof(frame.Info)) ||
+                    !read(reinterpret_cast<uintptr_t>(frame.Info.func.pointer), &frame.Func, sizeof(frame.Func)))
+                {
+                    return false;
+                }
+                if (frame.Func.IsClosure() && !read(reinterpret_cast<uintptr_t>(frame.Func.value_.gc.pointer),
+                    &frame.FuncClosure, sizeof(frame.FuncClosure)))
+                {
+                    return false;
+                }
+                out.Frames.push_back(frame);
+                ci = frame.Info.previous;
+            }
+            return true;
+        }
+
+        /**
+         * @brief 比较两个复制的调用链是否逐字节相同
+         *
+         * 与 LuaSampler 判断帧是否未变的方式一致，闭包只在函数值为闭包时比较。
+         */
+        inline bool IsSameStack(const LuaRawStack& lhs, const LuaRawStack& rhs)
+        {
+            TEST_CHECK(lhs.Address == rhs.Address);
+            TEST_CHECK(lhs.Global == rhs.Global);
+            TEST_CHECK(lhs.Frames.size() == rhs.Frames.size());
+            for (size_t i = 0; i < lhs.Frames.size(); ++i)
+            {
+                const auto& l = lhs.Frames[i];
+                const auto& r = rhs.Frames[i];
+                TEST_CHECK(l.Address == r.Address);
+                TEST_CHECK(::memcmp(&l.Info, &r.Info, sizeof(l.Info)) == 0);
+                TEST_CHECK(l.Func.tt_ == r.Func.tt_);
+                TEST_CHECK(::memcmp(&l.Func.value_, &r.Func.value_, sizeof(l.Func.value_)) == 0);
+                if (l.Func.IsClosure())
+                    TEST_CHECK(::memcmp(&l.FuncClosure, &r.FuncClosure, sizeof(l.FuncClosure)) == 0);
+            }
+            return true;
+        }
+    }
+}
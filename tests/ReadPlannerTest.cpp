@@ -0,0 +1,220 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ *
+ * 验证 CaptureStack 经 ReadPlanner 批量读取的结果与逐个字段读取的结果逐字节相同，
+ * 覆盖跨页的对象、相互重叠的读取范围、超过 IOV_MAX 的批量以及读取到不可访问页面时的部分读取。
+ */
+#include "FakeLuaProcess.hpp"
+
+#include <climits>
+#include <sys/uio.h>
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+using namespace lperf::test;
+using namespace lperf::LuaObjects;
+
+namespace
+{
+    const size_t PAGE_COUNT = 32;
+    const size_t DEEP_FRAME_COUNT = IOV_MAX;  // 复用缓存时校验波中每帧两个读取，合计超过 IOV_MAX
+    const size_t DEEP_REGION_PAGE = 5;
+
+    void FillCallInfo(CallInfo* ci, size_t index)
+    {
+        ci->u.l.savedpc.pointer = reinterpret_cast<Instruction*>(0x10000 + index * 4);
+        ci->nresults = static_cast<short>(index);
+        ci->callstatus = static_cast<unsigned short>(CIST_LUA | (index & 1 ? CIST_TAIL : 0));
+        ci->extra = static_cast<ptrdiff_t>(index * 16);
+    }
+
+    bool CaptureAndCompare(LuaSampler& sampler, const Debugger& dbg, uintptr_t address, size_t expectFrames)
+    {
+        LuaRawStack batched, reference;
+        sampler.CaptureStack(address, batched);
+        TEST_CHECK(ReadStackByField(dbg, address, reference));
+        TEST_CHECK(reference.Frames.size() == expectFrames);
+        TEST_CHECK(IsSameStack(batched, reference));
+        return true;
+    }
+
+    /**
+     * 对象跨越页边界、多个帧共用同一函数值、函数值与另一个闭包相互重叠、闭包紧贴不可访问的页面
+     */
+    bool TestIrregularLayout(FakeLuaProcess& proc, Debugger& dbg)
+    {
+        auto page = proc.GetPageSize();
+
+        auto L = proc.Place<lua_State>(0);
+        L->l_G.pointer = reinterpret_cast<global_State*>(proc.GetAddress(64));
+
+        vector<CallInfo*> frames = {
+            proc.Place<CallInfo>(page - 24),  // 跨越第0、1页
+            proc.Place<CallInfo>(512),
+            proc.Place<CallInfo>(page + 128),
+            proc.Place<CallInfo>(2 * page - 40),  // 跨越第1、2页
+            proc.Place<CallInfo>(1024),
+            proc.Place<CallInfo>(page + 512),
+        };
+        for (size_t i = 0; i < frames.size(); ++i)
+            FillCallInfo(frames[i], i);
+        LinkCallInfos(L, frames);
+
+        auto lclosure = proc.Place<Closure>(proc.GetGuardOffset() - sizeof(Closure));  // 结束于不可访问的页面之前
+        lclosure->l.tt = MarkAsCollectableType(LUA_TLCL);
+        lclosure->l.p.pointer = reinterpret_cast<Proto*>(0xABCD0);
+        auto cclosure = proc.Place<Closure>(page + 1024);
+        cclosure->c.tt = MarkAsCollectableType(LUA_TCCL);
+        cclosure->c.f = reinterpret_cast<lua_CFunction>(0xC0DE0);
+        auto straddling = proc.Place<Closure>(4 * page - 16);  // 跨越第3、4页
+        straddling->l.tt = MarkAsCollectableType(LUA_TLCL);
+        straddling->l.p.pointer = reinterpret_cast<Proto*>(0xABCE0);
+
+        auto value0 = proc.Place<TValue>(3 * page - 8);  // 跨越第2、3页
+        SetFunction(value0, MarkAsCollectableType(LUA_TLCL), lclosure);
+        auto value1 = proc.Place<TValue>(1536);
+        SetFunction(value1, MarkAsCollectableType(LUA_TCCL), cclosure);
+        // 落在 cclosure 的上值中，与其读取范围重叠
+        auto value3 = reinterpret_cast<TValue*>(reinterpret_cast<uint8_t*>(cclosure) + offsetof(CClosure, upvalue));
+        SetFunction(value3, LUA_TLCF, reinterpret_cast<void*>(0xF00D0));
+        auto value4 = proc.Place<TValue>(2048);
+        SetFunction(value4, MarkAsCollectableType(LUA_TLCL), straddling);
+
+        frames[0]->func.pointer = value0;
+        frames[1]->func.pointer = value1;
+        frames[2]->func.pointer = value1;  // 与上一帧完全相同的范围
+        frames[3]->func.pointer = value3;
+        frames[4]->func.pointer = value4;
+        frames[5]->func.pointer = value0;
+
+        auto address = reinterpret_cast<uintptr_t>(L);
+        LuaSampler sampler(dbg);
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, address, frames.size()));
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, address, frames.size()));  // 复用缓存的路径
+        return true;
+    }
+
+    /**
+     * 调用链足够深时，一波中的请求数超过 IOV_MAX，需要拆分为多次系统调用
+     */
+    bool TestDeepStack(FakeLuaProcess& proc, Debugger& dbg)
+    {
+        auto offset = DEEP_REGION_PAGE * proc.GetPageSize();
+        auto L = proc.Place<lua_State>(offset);
+        offset += sizeof(lua_State);
+
+        auto value = proc.Place<TValue>(offset);
+        offset += sizeof(TValue);
+        auto closure = proc.Place<Closure>(offset);
+        offset += sizeof(Closure);
+        closure->l.tt = MarkAsCollectableType(LUA_TLCL);
+        SetFunction(value, MarkAsCollectableType(LUA_TLCL), closure);
+
+        vector<CallInfo*> frames;
+        for (size_t i = 0; i < DEEP_FRAME_COUNT; ++i)
+        {
+            frames.push_back(proc.Place<CallInfo>(offset));
+            offset += sizeof(CallInfo);
+            FillCallInfo(frames.back(), i);
+            frames.back()->func.pointer = value;
+        }
+        LinkCallInfos(L, frames);
+
+        // 校验波读错时只会放弃复用而不影响结果，因此直接检查拆分后的分散读取
+        vector<RawCallFrame> batched(frames.size());
+        vector<struct iovec> locals, remotes;
+        for (size_t i = 0; i < frames.size(); ++i)
+        {
+            locals.push_back({ &batched[i].Info, sizeof(CallInfo) });
+            remotes.push_back({ frames[i], sizeof(CallInfo) });
+            locals.push_back({ &batched[i].Func, sizeof(TValue) });
+            remotes.push_back({ value, sizeof(TValue) });
+        }
+        TEST_CHECK(dbg.ReadMemory(locals.data(), remotes.data(), locals.size()) ==
+            frames.size() * (sizeof(CallInfo) + sizeof(TValue)));
+        for (size_t i = 0; i < frames.size(); ++i)
+        {
+            TEST_CHECK(::memcmp(&batched[i].Info, frames[i], sizeof(CallInfo)) == 0);
+            TEST_CHECK(::memcmp(&batched[i].Func, value, sizeof(TValue)) == 0);
+        }
+
+        auto address = reinterpret_cast<uintptr_t>(L);
+        LuaSampler sampler(dbg);
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, address, frames.size()));
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, address, frames.size()));
+        return true;
+    }
+
+    /**
+     * 某个对象跨入不可访问的页面时，process_vm_readv 只完成一部分，整个捕获必须失败而非留下半截数据
+     */
+    bool TestPartialRead(FakeLuaProcess& proc, Debugger& dbg)
+    {
+        auto page = proc.GetPageSize();
+        auto L = proc.Place<lua_State>(3 * page + 256);
+        auto value = proc.Place<TValue>(3 * page + 2048);
+        SetFunction(value, LUA_TLCF, reinterpret_cast<void*>(0xF00D0));
+
+        auto top = proc.Place<CallInfo>(3 * page + 1024);
+        top->func.pointer = value;
+        LinkCallInfos(L, { top });
+
+        // 底层的 Debugger::ReadMemory 按顺序返回成功读取的字节数
+        auto brokenAddress = proc.GetAddress(proc.GetGuardOffset() - 16);
+        CallInfo local[3];
+        struct iovec locals[3] = {
+            { &local[0], sizeof(CallInfo) }, { &local[1], sizeof(CallInfo) }, { &local[2], sizeof(CallInfo) } };
+        struct iovec remotes[3] = {
+            { top, sizeof(CallInfo) }, { reinterpret_cast<void*>(brokenAddress), sizeof(CallInfo) },
+            { top, sizeof(CallInfo) } };
+        auto sz = dbg.ReadMemory(locals, remotes, 3);
+        TEST_CHECK(sz >= sizeof(CallInfo) && sz < 2 * sizeof(CallInfo));
+        TEST_CHECK(::memcmp(&local[0], top, sizeof(CallInfo)) == 0);
+
+        auto address = reinterpret_cast<uintptr_t>(L);
+        LuaSampler sampler(dbg);
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, address, 1));
+
+        // 调用者跨入不可访问的页面，无论是否复用缓存都必须抛出异常
+        top->previous.pointer = reinterpret_cast<CallInfo*>(brokenAddress);
+        for (int i = 0; i < 2; ++i)
+        {
+            bool thrown = false;
+            try
+            {
+                LuaRawStack stack;
+                sampler.CaptureStack(address, stack);
+            }
+            catch (const ExceptionBase&)
+            {
+                thrown = true;
+            }
+            TEST_CHECK(thrown);
+
+            LuaRawStack reference;
+            TEST_CHECK(!ReadStackByField(dbg, address, reference));
+        }
+
+        // 修复后恢复正常
+        top->previous.pointer = &L->base_ci;
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, address, 1));
+        return true;
+    }
+}
+
+int main()
+{
+    FakeLuaProcess proc(PAGE_COUNT);
+    bool ok = true;
+    {
+        Debugger dbg(proc.GetPid());
+        ok = TestIrregularLayout(proc, dbg) && ok;
+        ok = TestDeepStack(proc, dbg) && ok;
+        ok = TestPartialRead(proc, dbg) && ok;
+    }
+    std::printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ *
+ * 验证 CaptureStack 复用上次的调用链时，同一 CallInfo 地址上函数或 savedpc 改变的帧及其上方的帧被重新读取，
+ * 而不是沿用缓存中的旧内容。
+ */
+#include "FakeLuaProcess.hpp"
+
+using namespace std;
+using namespace moe;
+using namespace lperf;
+using namespace lperf::test;
+using namespace lperf::LuaObjects;
+
+namespace
+{
+    const size_t PAGE_COUNT = 4;
+    const size_t FRAME_COUNT = 6;
+
+    struct FakeStack
+    {
+        lua_State* L = nullptr;
+        vector<CallInfo*> Frames;
+        vector<TValue*> Values;
+        vector<Closure*> Closures;
+    };
+
+    FakeStack BuildStack(FakeLuaProcess& proc)
+    {
+        FakeStack ret;
+        size_t offset = 0;
+        ret.L = proc.Place<lua_State>(offset);
+        offset += sizeof(lua_State);
+        for (size_t i = 0; i < FRAME_COUNT; ++i)
+        {
+            auto closure = proc.Place<Closure>(offset);
+            offset += sizeof(Closure);
+            closure->l.tt = MarkAsCollectableType(LUA_TLCL);
+            closure->l.p.pointer = reinterpret_cast<Proto*>(0x1000 * (i + 1));
+            ret.Closures.push_back(closure);
+
+            auto value = proc.Place<TValue>(offset);
+            offset += sizeof(TValue);
+            SetFunction(value, MarkAsCollectableType(LUA_TLCL), closure);
+            ret.Values.push_back(value);
+
+            auto ci = proc.Place<CallInfo>(offset);
+            offset += sizeof(CallInfo);
+            ci->func.pointer = value;
+            ci->callstatus = static_cast<unsigned short>(CIST_LUA);
+            ci->u.l.savedpc.pointer = reinterpret_cast<Instruction*>(0x100000 + i * 0x100);
+            ret.Frames.push_back(ci);
+        }
+        LinkCallInfos(ret.L, ret.Frames);
+        return ret;
+    }
+
+    bool CaptureAndCompare(LuaSampler& sampler, const Debugger& dbg, const FakeStack& stack)
+    {
+        auto address = reinterpret_cast<uintptr_t>(stack.L);
+        LuaRawStack captured, reference;
+        sampler.CaptureStack(address, captured);
+        TEST_CHECK(ReadStackByField(dbg, address, reference));
+        TEST_CHECK(reference.Frames.size() == stack.Frames.size());
+        TEST_CHECK(IsSameStack(captured, reference));
+        return true;
+    }
+
+    bool TestChangedFrames(FakeLuaProcess& proc, Debugger& dbg)
+    {
+        auto stack = BuildStack(proc);
+        LuaSampler sampler(dbg);
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, stack));
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, stack));  // 未变时整条复用
+
+        // 栈底一帧执行到了下一条指令，其上方的帧全部不可复用
+        stack.Frames.back()->u.l.savedpc.pointer += 1;
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, stack));
+
+        // 中间一帧的 CallInfo 被复用于另一个函数（func 指向不同的栈槽）
+        stack.Frames[3]->func.pointer = stack.Values[0];
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, stack));
+
+        // func 指向的栈槽不变，但其中的函数值换成了另一个闭包
+        SetFunction(stack.Values[4], MarkAsCollectableType(LUA_TLCL), stack.Closures[1]);
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, stack));
+
+        // 换成不是闭包的轻量C函数
+        SetFunction(stack.Values[4], LUA_TLCF, reinterpret_cast<void*>(0xF00D0));
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, stack));
+
+        // 栈顶的帧返回后，剩余的帧可以整体复用
+        LinkCallInfos(stack.L, vector<CallInfo*>(stack.Frames.begin() + 2, stack.Frames.end()));
+        stack.Frames.erase(stack.Frames.begin(), stack.Frames.begin() + 2);
+        TEST_CHECK(CaptureAndCompare(sampler, dbg, stack));
+        return true;
+    }
+}
+
+int main()
+{
+    FakeLuaProcess proc(PAGE_COUNT);
+    bool ok = true;
+    {
+        Debugger dbg(proc.GetPid());
+        ok = TestChangedFrames(proc, dbg);
+    }
+    std::printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
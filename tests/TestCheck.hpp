@@ -0,0 +1,17 @@
+/**
+ * @file
+ * @author agent
+ * @date 2026/10/18
+ */
+#pragma once
+#include <cstdio>
+
+#define TEST_CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return false; \
+        } \
+    } while (false)